@@ -0,0 +1,628 @@
+#include <algorithm>
+#include <cassert>
+#include <float.h>
+#include <stdio.h>
+
+#include <imgui/imgui.h>
+
+#include "Allocator.hpp"
+#include "Defines.hpp"
+
+namespace
+{
+    constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+    constexpr VkDeviceSize MIN_SPLIT_SIZE = 64ull; // Smaller leftovers stay part of the allocation
+
+    uint32_t msb(uint64_t value)
+    {
+        return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+    }
+
+    uint32_t lsb(uint64_t value)
+    {
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+    }
+
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+    {
+        if (size < (1ull << ALLOCATOR_SMALL_LOG2))
+        {
+            fl = 0u;
+            sl = static_cast<uint32_t>(size >> (ALLOCATOR_SMALL_LOG2 - ALLOCATOR_SL_LOG2));
+        }
+        else
+        {
+            const uint32_t size_log2 = msb(size);
+            fl = size_log2 - ALLOCATOR_SMALL_LOG2 + 1u;
+            sl = static_cast<uint32_t>((size >> (size_log2 - ALLOCATOR_SL_LOG2)) ^ (1ull << ALLOCATOR_SL_LOG2));
+        }
+    }
+
+    // Rounds size up to the next class boundary, so every range in the class found by mapping() is large enough
+    VkDeviceSize round_up_to_class(VkDeviceSize size)
+    {
+        if (size < (1ull << ALLOCATOR_SMALL_LOG2))
+            return align_up(size, 1ull << (ALLOCATOR_SMALL_LOG2 - ALLOCATOR_SL_LOG2));
+
+        return size + (1ull << (msb(size) - ALLOCATOR_SL_LOG2)) - 1;
+    }
+
+    uint32_t create_node(DeviceAllocator& allocator, VkDeviceSize offset, VkDeviceSize size)
+    {
+        const AllocatorNode node{
+            .offset = offset,
+            .size = size,
+            .prev_physical = ALLOCATOR_NODE_NULL,
+            .next_physical = ALLOCATOR_NODE_NULL,
+            .prev_free = ALLOCATOR_NODE_NULL,
+            .next_free = ALLOCATOR_NODE_NULL,
+            .free = false};
+
+        if (!allocator.free_nodes.empty())
+        {
+            const uint32_t node_idx = allocator.free_nodes.back();
+            allocator.free_nodes.pop_back();
+            allocator.nodes[node_idx] = node;
+            return node_idx;
+        }
+
+        allocator.nodes.push_back(node);
+        return static_cast<uint32_t>(allocator.nodes.size() - 1);
+    }
+
+    void destroy_node(DeviceAllocator& allocator, uint32_t node_idx)
+    {
+        allocator.free_nodes.push_back(node_idx);
+    }
+
+    void insert_free(DeviceAllocator& allocator, AllocatorBlock& block, uint32_t node_idx)
+    {
+        AllocatorNode& node = allocator.nodes[node_idx];
+
+        uint32_t fl, sl;
+        mapping(node.size, fl, sl);
+
+        const uint32_t head = block.free_heads[fl][sl];
+        node.free = true;
+        node.prev_free = ALLOCATOR_NODE_NULL;
+        node.next_free = head;
+
+        if (head != ALLOCATOR_NODE_NULL)
+            allocator.nodes[head].prev_free = node_idx;
+
+        block.free_heads[fl][sl] = node_idx;
+        block.fl_bitmap |= 1ull << fl;
+        block.sl_bitmap[fl] |= 1u << sl;
+    }
+
+    void remove_free(DeviceAllocator& allocator, AllocatorBlock& block, uint32_t node_idx)
+    {
+        AllocatorNode& node = allocator.nodes[node_idx];
+
+        uint32_t fl, sl;
+        mapping(node.size, fl, sl);
+
+        if (node.prev_free != ALLOCATOR_NODE_NULL)
+            allocator.nodes[node.prev_free].next_free = node.next_free;
+        if (node.next_free != ALLOCATOR_NODE_NULL)
+            allocator.nodes[node.next_free].prev_free = node.prev_free;
+
+        if (block.free_heads[fl][sl] == node_idx)
+        {
+            block.free_heads[fl][sl] = node.next_free;
+
+            if (node.next_free == ALLOCATOR_NODE_NULL)
+            {
+                block.sl_bitmap[fl] &= ~(1u << sl);
+                if (block.sl_bitmap[fl] == 0u)
+                    block.fl_bitmap &= ~(1ull << fl);
+            }
+        }
+
+        node.free = false;
+        node.prev_free = ALLOCATOR_NODE_NULL;
+        node.next_free = ALLOCATOR_NODE_NULL;
+    }
+
+    uint32_t find_free(const AllocatorBlock& block, VkDeviceSize size)
+    {
+        const VkDeviceSize class_size = round_up_to_class(size);
+
+        uint32_t fl, sl;
+        mapping(class_size, fl, sl);
+
+        if (fl >= ALLOCATOR_FL_COUNT)
+            return ALLOCATOR_NODE_NULL;
+
+        uint32_t sl_bitmap = block.sl_bitmap[fl] & (~0u << sl);
+        if (sl_bitmap == 0u)
+        {
+            const uint64_t fl_bitmap = block.fl_bitmap & (~0ull << (fl + 1u));
+            if (fl_bitmap == 0u)
+                return ALLOCATOR_NODE_NULL;
+
+            fl = lsb(fl_bitmap);
+            sl_bitmap = block.sl_bitmap[fl];
+        }
+
+        return block.free_heads[fl][lsb(sl_bitmap)];
+    }
+
+    // Inserts node_idx into the physical list right after prev_idx
+    void link_physical_after(DeviceAllocator& allocator, uint32_t prev_idx, uint32_t node_idx)
+    {
+        AllocatorNode& prev = allocator.nodes[prev_idx];
+        AllocatorNode& node = allocator.nodes[node_idx];
+
+        node.prev_physical = prev_idx;
+        node.next_physical = prev.next_physical;
+
+        if (prev.next_physical != ALLOCATOR_NODE_NULL)
+            allocator.nodes[prev.next_physical].prev_physical = node_idx;
+
+        prev.next_physical = node_idx;
+    }
+
+    void unlink_physical(DeviceAllocator& allocator, uint32_t node_idx)
+    {
+        const AllocatorNode& node = allocator.nodes[node_idx];
+
+        if (node.prev_physical != ALLOCATOR_NODE_NULL)
+            allocator.nodes[node.prev_physical].next_physical = node.next_physical;
+        if (node.next_physical != ALLOCATOR_NODE_NULL)
+            allocator.nodes[node.next_physical].prev_physical = node.prev_physical;
+    }
+
+    // Returns the node of the allocation, or ALLOCATOR_NODE_NULL if the block has no fitting free range
+    uint32_t allocate_from_block(DeviceAllocator& allocator, uint32_t block_idx, VkDeviceSize size, VkDeviceSize alignment)
+    {
+        AllocatorBlock& block = allocator.blocks[block_idx];
+
+        // Worst case padding, so that any range that is found is guaranteed to fit once aligned
+        uint32_t node_idx = find_free(block, size + alignment - 1);
+        if (node_idx == ALLOCATOR_NODE_NULL)
+            return ALLOCATOR_NODE_NULL;
+
+        remove_free(allocator, block, node_idx);
+
+        // Return the alignment padding in front to the free lists
+        const VkDeviceSize aligned_offset = align_up(allocator.nodes[node_idx].offset, alignment);
+        const VkDeviceSize padding = aligned_offset - allocator.nodes[node_idx].offset;
+        if (padding > 0u)
+        {
+            const uint32_t pad_idx = create_node(allocator, allocator.nodes[node_idx].offset, padding);
+
+            const uint32_t prev_idx = allocator.nodes[node_idx].prev_physical;
+            allocator.nodes[node_idx].offset = aligned_offset;
+            allocator.nodes[node_idx].size -= padding;
+
+            // Padding can always be merged into a free predecessor
+            if (prev_idx != ALLOCATOR_NODE_NULL && allocator.nodes[prev_idx].free)
+            {
+                remove_free(allocator, block, prev_idx);
+                allocator.nodes[prev_idx].size += padding;
+                insert_free(allocator, block, prev_idx);
+                destroy_node(allocator, pad_idx);
+            }
+            else
+            {
+                allocator.nodes[pad_idx].next_physical = node_idx;
+                allocator.nodes[pad_idx].prev_physical = prev_idx;
+                if (prev_idx != ALLOCATOR_NODE_NULL)
+                    allocator.nodes[prev_idx].next_physical = pad_idx;
+                allocator.nodes[node_idx].prev_physical = pad_idx;
+
+                insert_free(allocator, block, pad_idx);
+            }
+        }
+
+        // And the tail
+        const VkDeviceSize remainder = allocator.nodes[node_idx].size - size;
+        if (remainder >= MIN_SPLIT_SIZE)
+        {
+            const uint32_t tail_idx = create_node(allocator, allocator.nodes[node_idx].offset + size, remainder);
+            allocator.nodes[node_idx].size = size;
+
+            link_physical_after(allocator, node_idx, tail_idx);
+            insert_free(allocator, block, tail_idx);
+        }
+
+        block.used += allocator.nodes[node_idx].size;
+        ++block.allocation_count;
+
+        return node_idx;
+    }
+
+    void free_in_block(DeviceAllocator& allocator, uint32_t block_idx, uint32_t node_idx)
+    {
+        AllocatorBlock& block = allocator.blocks[block_idx];
+
+        block.used -= allocator.nodes[node_idx].size;
+        --block.allocation_count;
+
+        // Coalesce with free physical neighbours
+        const uint32_t next_idx = allocator.nodes[node_idx].next_physical;
+        if (next_idx != ALLOCATOR_NODE_NULL && allocator.nodes[next_idx].free)
+        {
+            remove_free(allocator, block, next_idx);
+            allocator.nodes[node_idx].size += allocator.nodes[next_idx].size;
+            unlink_physical(allocator, next_idx);
+            destroy_node(allocator, next_idx);
+        }
+
+        const uint32_t prev_idx = allocator.nodes[node_idx].prev_physical;
+        if (prev_idx != ALLOCATOR_NODE_NULL && allocator.nodes[prev_idx].free)
+        {
+            remove_free(allocator, block, prev_idx);
+            allocator.nodes[prev_idx].size += allocator.nodes[node_idx].size;
+            unlink_physical(allocator, node_idx);
+            destroy_node(allocator, node_idx);
+            node_idx = prev_idx;
+        }
+
+        insert_free(allocator, block, node_idx);
+    }
+
+    uint32_t create_block(DeviceAllocator& allocator, uint32_t memory_type_idx, uint32_t kind, VkDeviceSize size, bool dedicated)
+    {
+        const VkMemoryAllocateInfo allocate_info{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = size,
+            .memoryTypeIndex = memory_type_idx};
+
+        VkDeviceMemory memory;
+        VK_CHECK(vkAllocateMemory(allocator.device, &allocate_info, nullptr, &memory));
+
+        void* mapped = nullptr;
+        if (allocator.memory_properties.memoryTypes[memory_type_idx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            VK_CHECK(vkMapMemory(allocator.device, memory, 0, VK_WHOLE_SIZE, 0x0, &mapped));
+
+        uint32_t block_idx = 0u;
+        while (block_idx < allocator.blocks.size() && allocator.blocks[block_idx].memory != VK_NULL_HANDLE)
+            ++block_idx;
+
+        if (block_idx == allocator.blocks.size())
+            allocator.blocks.emplace_back();
+
+        AllocatorBlock& block = allocator.blocks[block_idx];
+        block = AllocatorBlock{
+            .memory = memory,
+            .size = size,
+            .mapped = mapped,
+            .memory_type_idx = memory_type_idx,
+            .kind = kind,
+            .dedicated = dedicated,
+            .used = 0u,
+            .allocation_count = 0u,
+            .fl_bitmap = 0u,
+            .sl_bitmap = {},
+            .free_heads = {}};
+
+        for (uint32_t fl = 0; fl < ALLOCATOR_FL_COUNT; ++fl)
+            std::fill(block.free_heads[fl], block.free_heads[fl] + ALLOCATOR_SL_COUNT, ALLOCATOR_NODE_NULL);
+
+        if (!dedicated)
+        {
+            insert_free(allocator, block, create_node(allocator, 0u, size));
+            allocator.block_lists[memory_type_idx][kind].push_back(block_idx);
+        }
+
+        return block_idx;
+    }
+
+    void destroy_block(DeviceAllocator& allocator, uint32_t block_idx)
+    {
+        AllocatorBlock& block = allocator.blocks[block_idx];
+
+        if (!block.dedicated)
+        {
+            // An empty block is a single free node
+            const uint32_t node_idx = find_free(block, 1u);
+            remove_free(allocator, block, node_idx);
+            destroy_node(allocator, node_idx);
+
+            std::vector<uint32_t>& block_list = allocator.block_lists[block.memory_type_idx][block.kind];
+            block_list.erase(std::find(block_list.begin(), block_list.end(), block_idx));
+        }
+
+        vkFreeMemory(allocator.device, block.memory, nullptr);
+        block.memory = VK_NULL_HANDLE;
+    }
+}
+
+DeviceAllocator create_allocator(VkDevice device, const VkPhysicalDeviceProperties& physical_device_properties, const VkPhysicalDeviceMemoryProperties& memory_properties)
+{
+    DeviceAllocator allocator{
+        .device = device,
+        .memory_properties = memory_properties,
+        .non_coherent_atom_size = physical_device_properties.limits.nonCoherentAtomSize,
+        .block_size = {},
+        .blocks = {},
+        .block_lists = {},
+        .nodes = {},
+        .free_nodes = {}};
+
+    // Small heaps (e.g. the 256MB host visible device local heap without resizable BAR) get smaller blocks
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+    {
+        const VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[i].heapIndex].size;
+        allocator.block_size[i] = std::min(DEFAULT_BLOCK_SIZE, std::max(heap_size / 8u, (VkDeviceSize)(1u << 20)));
+    }
+
+    return allocator;
+}
+
+void allocator_release(DeviceAllocator& allocator)
+{
+    for (uint32_t i = 0; i < allocator.blocks.size(); ++i)
+    {
+        if (allocator.blocks[i].memory == VK_NULL_HANDLE)
+            continue;
+
+        if (allocator.blocks[i].allocation_count != 0u)
+        {
+            LOG("WARNING - Allocator block %u released with %u live allocations\n", i, allocator.blocks[i].allocation_count);
+        }
+
+        vkFreeMemory(allocator.device, allocator.blocks[i].memory, nullptr);
+    }
+
+    allocator.blocks.clear();
+    allocator.nodes.clear();
+    allocator.free_nodes.clear();
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+        for (uint32_t j = 0; j < ALLOCATION_KIND_COUNT; ++j)
+            allocator.block_lists[i][j].clear();
+}
+
+uint32_t find_memory_type(const VkPhysicalDeviceMemoryProperties& memory_properties, uint32_t memory_type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+    uint32_t best_idx = UINT32_MAX;
+    int best_score = -1;
+
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+    {
+        const VkMemoryPropertyFlags flags = memory_properties.memoryTypes[i].propertyFlags;
+
+        if ((memory_type_bits & (1u << i)) == 0u || (flags & required) != required)
+            continue;
+
+        // Preferred flags dominate, unrequested flags (e.g. HOST_CACHED for device only data) cost a little
+        const int score = __builtin_popcount(flags & preferred) * 16 - __builtin_popcount(flags & ~(required | preferred));
+        if (score > best_score)
+        {
+            best_score = score;
+            best_idx = i;
+        }
+    }
+
+    if (best_idx == UINT32_MAX)
+        EXIT("Could not find suitable memory type!");
+
+    return best_idx;
+}
+
+Allocation allocator_allocate(DeviceAllocator& allocator, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, uint32_t kind)
+{
+    const uint32_t memory_type_idx = find_memory_type(allocator.memory_properties, requirements.memoryTypeBits, required, preferred);
+    const VkDeviceSize block_size = allocator.block_size[memory_type_idx];
+
+    VkDeviceSize alignment = std::max(requirements.alignment, (VkDeviceSize)1u);
+
+    // Keep independently flushed ranges of non coherent memory from sharing an atom
+    const VkMemoryPropertyFlags flags = allocator.memory_properties.memoryTypes[memory_type_idx].propertyFlags;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        alignment = std::max(alignment, allocator.non_coherent_atom_size);
+
+    uint32_t block_idx = UINT32_MAX;
+    uint32_t node_idx = ALLOCATOR_NODE_NULL;
+
+    if (requirements.size > block_size / 2u)
+    {
+        // Large resources get their own VkDeviceMemory instead of fragmenting a shared block
+        block_idx = create_block(allocator, memory_type_idx, kind, requirements.size, true);
+        ++allocator.blocks[block_idx].allocation_count;
+        allocator.blocks[block_idx].used = requirements.size;
+    }
+    else
+    {
+        for (const uint32_t idx : allocator.block_lists[memory_type_idx][kind])
+        {
+            node_idx = allocate_from_block(allocator, idx, requirements.size, alignment);
+            if (node_idx != ALLOCATOR_NODE_NULL)
+            {
+                block_idx = idx;
+                break;
+            }
+        }
+
+        if (node_idx == ALLOCATOR_NODE_NULL)
+        {
+            block_idx = create_block(allocator, memory_type_idx, kind, block_size, false);
+            node_idx = allocate_from_block(allocator, block_idx, requirements.size, alignment);
+            assert(node_idx != ALLOCATOR_NODE_NULL);
+        }
+    }
+
+    const AllocatorBlock& block = allocator.blocks[block_idx];
+    const VkDeviceSize offset = (node_idx == ALLOCATOR_NODE_NULL) ? 0u : allocator.nodes[node_idx].offset;
+
+    return Allocation{
+        .memory = block.memory,
+        .offset = offset,
+        .size = requirements.size,
+        .mapped = (block.mapped != nullptr) ? static_cast<char*>(block.mapped) + offset : nullptr,
+        .memory_type_idx = memory_type_idx,
+        .block_idx = block_idx,
+        .node_idx = node_idx};
+}
+
+Allocation allocator_allocate_buffer(DeviceAllocator& allocator, VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(allocator.device, buffer, &requirements);
+
+    const Allocation allocation = allocator_allocate(allocator, requirements, required, preferred, ALLOCATION_KIND_LINEAR);
+    VK_CHECK(vkBindBufferMemory(allocator.device, buffer, allocation.memory, allocation.offset));
+    return allocation;
+}
+
+Allocation allocator_allocate_image(DeviceAllocator& allocator, VkImage image, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(allocator.device, image, &requirements);
+
+    const Allocation allocation = allocator_allocate(allocator, requirements, required, preferred, ALLOCATION_KIND_OPTIMAL);
+    VK_CHECK(vkBindImageMemory(allocator.device, image, allocation.memory, allocation.offset));
+    return allocation;
+}
+
+void allocator_free(DeviceAllocator& allocator, Allocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    AllocatorBlock& block = allocator.blocks[allocation.block_idx];
+
+    if (allocation.node_idx == ALLOCATOR_NODE_NULL)
+    {
+        --block.allocation_count;
+        destroy_block(allocator, allocation.block_idx);
+    }
+    else
+    {
+        free_in_block(allocator, allocation.block_idx, allocation.node_idx);
+
+        // Keep one empty block per memory type and kind around so allocation patterns that oscillate
+        // around a block boundary do not hit vkAllocateMemory every time
+        if (block.allocation_count == 0u && allocator.block_lists[block.memory_type_idx][block.kind].size() > 1u)
+            destroy_block(allocator, allocation.block_idx);
+    }
+
+    allocation = Allocation{};
+}
+
+void allocator_flush(const DeviceAllocator& allocator, const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (allocator.memory_properties.memoryTypes[allocation.memory_type_idx].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        return;
+
+    const AllocatorBlock& block = allocator.blocks[allocation.block_idx];
+
+    // Flushed ranges must be multiples of nonCoherentAtomSize or end at the end of the memory object
+    const VkDeviceSize atom = allocator.non_coherent_atom_size;
+    const VkDeviceSize begin = (allocation.offset + offset) / atom * atom;
+    const VkDeviceSize end = std::min(align_up(allocation.offset + offset + size, atom), block.size);
+
+    const VkMappedMemoryRange range{
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = allocation.memory,
+        .offset = begin,
+        .size = (end == block.size) ? VK_WHOLE_SIZE : end - begin,
+    };
+
+    VK_CHECK(vkFlushMappedMemoryRanges(allocator.device, 1, &range));
+}
+
+AllocatorStats allocator_get_stats(const DeviceAllocator& allocator)
+{
+    AllocatorStats stats{
+        .block_count = 0u,
+        .allocation_count = 0u,
+        .reserved = 0u,
+        .used = 0u,
+        .fragmentation = 0.0f,
+        .blocks = {}};
+
+    VkDeviceSize total_free = 0u;
+    VkDeviceSize largest_free = 0u;
+
+    for (const AllocatorBlock& block : allocator.blocks)
+    {
+        if (block.memory == VK_NULL_HANDLE)
+            continue;
+
+        AllocatorBlockStats block_stats{
+            .memory_type_idx = block.memory_type_idx,
+            .kind = block.kind,
+            .dedicated = block.dedicated,
+            .size = block.size,
+            .used = block.used,
+            .largest_free_range = 0u,
+            .allocation_count = block.allocation_count,
+            .free_range_count = 0u};
+
+        if (!block.dedicated)
+        {
+            for (uint32_t fl = 0; fl < ALLOCATOR_FL_COUNT; ++fl)
+            {
+                for (uint32_t sl = 0; sl < ALLOCATOR_SL_COUNT; ++sl)
+                {
+                    for (uint32_t node_idx = block.free_heads[fl][sl]; node_idx != ALLOCATOR_NODE_NULL; node_idx = allocator.nodes[node_idx].next_free)
+                    {
+                        block_stats.largest_free_range = std::max(block_stats.largest_free_range, allocator.nodes[node_idx].size);
+                        total_free += allocator.nodes[node_idx].size;
+                        ++block_stats.free_range_count;
+                    }
+                }
+            }
+        }
+
+        largest_free = std::max(largest_free, block_stats.largest_free_range);
+
+        ++stats.block_count;
+        stats.allocation_count += block.allocation_count;
+        stats.reserved += block.size;
+        stats.used += block.used;
+        stats.blocks.push_back(block_stats);
+    }
+
+    stats.fragmentation = (total_free > 0u) ? 1.0f - static_cast<float>(largest_free) / static_cast<float>(total_free) : 0.0f;
+
+    return stats;
+}
+
+void allocator_gui(const DeviceAllocator& allocator)
+{
+    if (!ImGui::CollapsingHeader("Allocator"))
+        return;
+
+    const AllocatorStats stats = allocator_get_stats(allocator);
+    const float mib = 1.0f / (1024.0f * 1024.0f);
+
+    ImGui::Text("%u allocations in %u blocks", stats.allocation_count, stats.block_count);
+    ImGui::Text("%.2f / %.2f MiB used, fragmentation %.2f", stats.used * mib, stats.reserved * mib, stats.fragmentation);
+
+    if (ImGui::BeginTable("##blocks", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+    {
+        ImGui::TableSetupColumn("Type");
+        ImGui::TableSetupColumn("Usage");
+        ImGui::TableSetupColumn("Allocs");
+        ImGui::TableSetupColumn("Largest free MiB");
+        ImGui::TableHeadersRow();
+
+        for (const AllocatorBlockStats& block : stats.blocks)
+        {
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%.2f / %.2f MiB", block.used * mib, block.size * mib);
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%u %s%s", block.memory_type_idx, (block.kind == ALLOCATION_KIND_LINEAR) ? "linear" : "optimal", block.dedicated ? " dedicated" : "");
+            ImGui::TableNextColumn();
+            ImGui::ProgressBar(static_cast<float>(block.used) / static_cast<float>(block.size), ImVec2(-FLT_MIN, 0.0f), overlay);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", block.allocation_count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", block.largest_free_range * mib);
+        }
+
+        ImGui::EndTable();
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Linear and optimally tiled resources are never placed in the same block, so neighbouring allocations can
+// not violate bufferImageGranularity no matter how small it is.
+enum
+{
+    ALLOCATION_KIND_LINEAR  = 0, // Buffers
+    ALLOCATION_KIND_OPTIMAL = 1, // VK_IMAGE_TILING_OPTIMAL images
+    ALLOCATION_KIND_COUNT
+};
+
+struct Allocation
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mapped;            // Points at offset inside the persistently mapped block, null unless HOST_VISIBLE
+    uint32_t memory_type_idx;
+
+    uint32_t block_idx;
+    uint32_t node_idx;       // ALLOCATOR_NODE_NULL for dedicated allocations
+};
+
+// Two level segregated fit (TLSF) bookkeeping. Free ranges are bucketed by size class so finding a fitting
+// range and coalescing on free are O(1).
+constexpr uint32_t ALLOCATOR_SL_LOG2 = 4u;                         // 16 second level classes per power of two
+constexpr uint32_t ALLOCATOR_SL_COUNT = 1u << ALLOCATOR_SL_LOG2;
+constexpr uint32_t ALLOCATOR_SMALL_LOG2 = 8u;                      // Sizes below 256 bytes share the first level
+constexpr uint32_t ALLOCATOR_FL_COUNT = 40u;
+constexpr uint32_t ALLOCATOR_NODE_NULL = UINT32_MAX;
+
+// A contiguous range of a block, either allocated or free
+struct AllocatorNode
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+
+    uint32_t prev_physical;
+    uint32_t next_physical;
+    uint32_t prev_free;
+    uint32_t next_free;
+
+    bool free;
+};
+
+struct AllocatorBlock
+{
+    VkDeviceMemory memory;  // VK_NULL_HANDLE if the slot is unused
+    VkDeviceSize size;
+    void* mapped;
+    uint32_t memory_type_idx;
+    uint32_t kind;
+    bool dedicated;
+
+    VkDeviceSize used;
+    uint32_t allocation_count;
+
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmap[ALLOCATOR_FL_COUNT];
+    uint32_t free_heads[ALLOCATOR_FL_COUNT][ALLOCATOR_SL_COUNT];
+};
+
+struct DeviceAllocator
+{
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize non_coherent_atom_size;
+    VkDeviceSize block_size[VK_MAX_MEMORY_TYPES];
+
+    std::vector<AllocatorBlock> blocks;
+    std::vector<uint32_t> block_lists[VK_MAX_MEMORY_TYPES][ALLOCATION_KIND_COUNT];
+
+    std::vector<AllocatorNode> nodes;
+    std::vector<uint32_t> free_nodes;
+};
+
+struct AllocatorBlockStats
+{
+    uint32_t memory_type_idx;
+    uint32_t kind;
+    bool dedicated;
+
+    VkDeviceSize size;
+    VkDeviceSize used;
+    VkDeviceSize largest_free_range;
+    uint32_t allocation_count;
+    uint32_t free_range_count;
+};
+
+struct AllocatorStats
+{
+    uint32_t block_count;        // == number of live vkAllocateMemory allocations
+    uint32_t allocation_count;
+
+    VkDeviceSize reserved;
+    VkDeviceSize used;
+
+    // 1 - largest free range / total free memory, 0 means all free memory is one contiguous range
+    float fragmentation;
+
+    std::vector<AllocatorBlockStats> blocks;
+};
+
+DeviceAllocator create_allocator(VkDevice device, const VkPhysicalDeviceProperties& physical_device_properties, const VkPhysicalDeviceMemoryProperties& memory_properties);
+
+// Frees every block, all allocations must have been freed before
+void allocator_release(DeviceAllocator& allocator);
+
+// Picks the memory type with all required flags that matches the most preferred flags and has the fewest
+// other flags set, instead of simply the first match.
+uint32_t find_memory_type(const VkPhysicalDeviceMemoryProperties& memory_properties, uint32_t memory_type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+
+Allocation allocator_allocate(DeviceAllocator& allocator, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, uint32_t kind);
+
+// Allocates and binds
+Allocation allocator_allocate_buffer(DeviceAllocator& allocator, VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0x0);
+
+Allocation allocator_allocate_image(DeviceAllocator& allocator, VkImage image, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0x0);
+
+void allocator_free(DeviceAllocator& allocator, Allocation& allocation);
+
+// Makes host writes to [offset, offset + size) of the allocation visible to the device. No-op for coherent memory.
+void allocator_flush(const DeviceAllocator& allocator, const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+
+AllocatorStats allocator_get_stats(const DeviceAllocator& allocator);
+
+void allocator_gui(const DeviceAllocator& allocator);
+
+#endif // ALLOCATOR_HPP
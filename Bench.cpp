@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <math.h>
+
+#include "Bench.hpp"
+
+namespace
+{
+    const char* phase_names[BENCH_PHASE_COUNT] = {"poll", "render", "submit", "present"};
+
+    struct Summary
+    {
+        double mean;
+        double p50;
+        double p95;
+        double p99;
+        double max;
+    };
+
+    // Nearest-rank percentile of an already sorted set of samples
+    double percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        const size_t rank = static_cast<size_t>(ceil(p / 100.0 * sorted.size()));
+        return sorted[std::min(std::max(rank, (size_t)1u), sorted.size()) - 1];
+    }
+
+    Summary summarize(std::vector<double> samples)
+    {
+        std::sort(samples.begin(), samples.end());
+
+        double sum = 0.0;
+        for (const double sample : samples)
+            sum += sample;
+
+        return Summary{
+            .mean = samples.empty() ? 0.0 : sum / samples.size(),
+            .p50 = percentile(samples, 50.0),
+            .p95 = percentile(samples, 95.0),
+            .p99 = percentile(samples, 99.0),
+            .max = samples.empty() ? 0.0 : samples.back()};
+    }
+
+    void write_summary(FILE* file, const Summary& summary)
+    {
+        fprintf(file, "{\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+                summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+    }
+
+    bool measuring(const Bench& bench)
+    {
+        return bench.enabled && bench.frame_idx >= bench.warmup_frames;
+    }
+}
+
+Bench create_bench(bool enabled, uint32_t warmup_frames, uint32_t measured_frames)
+{
+    Bench bench{
+        .enabled = enabled,
+        .warmup_frames = warmup_frames,
+        .measured_frames = measured_frames,
+        .frame_idx = 0u};
+
+    if (enabled)
+    {
+        // Reserve up front so the measured loop never reallocates
+        for (uint32_t i = 0; i < BENCH_PHASE_COUNT; ++i)
+            bench.phase_ms[i].reserve(measured_frames);
+
+        bench.frame_ms.reserve(measured_frames);
+    }
+
+    return bench;
+}
+
+void bench_begin_frame(Bench& bench)
+{
+    if (!bench.enabled)
+        return;
+
+    bench.frame_begin = std::chrono::steady_clock::now();
+    bench.phase_begin = bench.frame_begin;
+}
+
+void bench_end_phase(Bench& bench, uint32_t phase)
+{
+    if (!bench.enabled)
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+
+    if (measuring(bench))
+        bench.phase_ms[phase].push_back(std::chrono::duration<double, std::milli>(now - bench.phase_begin).count());
+
+    bench.phase_begin = now;
+}
+
+void bench_end_frame(Bench& bench)
+{
+    if (!bench.enabled)
+        return;
+
+    if (measuring(bench))
+        bench.frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bench.frame_begin).count());
+
+    ++bench.frame_idx;
+}
+
+std::string bench_json_string(const char* value)
+{
+    std::string json = "\"";
+
+    for (const char* c = value; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            json += '\\';
+            json += *c;
+        }
+        else if (static_cast<unsigned char>(*c) < 0x20u)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*c));
+            json += escaped;
+        }
+        else
+        {
+            json += *c;
+        }
+    }
+
+    return json + "\"";
+}
+
+void bench_write_json(const Bench& bench, FILE* file, const std::vector<std::pair<std::string, std::string>>& context)
+{
+    const Summary frame_summary = summarize(bench.frame_ms);
+
+    double total_ms = 0.0;
+    for (const double ms : bench.frame_ms)
+        total_ms += ms;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"warmup_frames\": %u,\n", bench.warmup_frames);
+    fprintf(file, "  \"measured_frames\": %zu,\n", bench.frame_ms.size());
+
+    fprintf(file, "  \"context\": {");
+    for (size_t i = 0; i < context.size(); ++i)
+        fprintf(file, "%s\"%s\": %s", (i == 0) ? "" : ", ", context[i].first.c_str(), context[i].second.c_str());
+    fprintf(file, "},\n");
+
+    fprintf(file, "  \"fps\": %.2f,\n", (total_ms > 0.0) ? bench.frame_ms.size() * 1000.0 / total_ms : 0.0);
+
+    fprintf(file, "  \"frame_ms\": ");
+    write_summary(file, frame_summary);
+    fprintf(file, ",\n");
+
+    fprintf(file, "  \"phase_ms\": {\n");
+    for (uint32_t i = 0; i < BENCH_PHASE_COUNT; ++i)
+    {
+        fprintf(file, "    \"%s\": ", phase_names[i]);
+        write_summary(file, summarize(bench.phase_ms[i]));
+        fprintf(file, "%s\n", (i + 1 < BENCH_PHASE_COUNT) ? "," : "");
+    }
+    fprintf(file, "  }\n");
+
+    fprintf(file, "}\n");
+    fflush(file);
+}
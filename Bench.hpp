@@ -0,0 +1,51 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// CPU phases of one iteration of the frame loop
+enum
+{
+    BENCH_PHASE_POLL    = 0,
+    BENCH_PHASE_RENDER  = 1,
+    BENCH_PHASE_SUBMIT  = 2,
+    BENCH_PHASE_PRESENT = 3,
+    BENCH_PHASE_COUNT
+};
+
+struct Bench
+{
+    bool enabled;
+
+    uint32_t warmup_frames;
+    uint32_t measured_frames;
+    uint32_t frame_idx; // Includes warm-up frames
+
+    std::vector<double> phase_ms[BENCH_PHASE_COUNT];
+    std::vector<double> frame_ms;
+
+    std::chrono::steady_clock::time_point frame_begin;
+    std::chrono::steady_clock::time_point phase_begin;
+};
+
+// All bench_* calls are no-ops on a Bench created with enabled = false, so the frame loop can call them unconditionally
+Bench create_bench(bool enabled, uint32_t warmup_frames, uint32_t measured_frames);
+
+void bench_begin_frame(Bench& bench);
+
+// Attributes the time since the previous mark (or the beginning of the frame) to phase
+void bench_end_phase(Bench& bench, uint32_t phase);
+
+void bench_end_frame(Bench& bench);
+
+// Quoted JSON string with '"', '\\' and control characters escaped, for context values
+std::string bench_json_string(const char* value);
+
+// Writes p50/p95/p99/max per phase and for whole frames. context entries are emitted as-is, so values must already be valid JSON.
+void bench_write_json(const Bench& bench, FILE* file, const std::vector<std::pair<std::string, std::string>>& context);
+
+#endif // BENCH_HPP
@@ -0,0 +1,88 @@
+#include "CommandRecorder.hpp"
+#include "Defines.hpp"
+#include "Helpers.hpp"
+
+CommandRecorder create_command_recorder(VkDevice device, ThreadPool& thread_pool, uint32_t q_family_idx, uint32_t frame_count)
+{
+    CommandRecorder recorder{
+        .device = device,
+        .thread_pool = &thread_pool,
+        .frames = std::vector<RecorderFrame>(frame_count),
+        .recorded = {}};
+
+    for (RecorderFrame& frame : recorder.frames)
+    {
+        frame.workers.resize(thread_pool_size(thread_pool));
+
+        for (RecorderWorker& worker : frame.workers)
+        {
+            worker.command_pool = create_command_pool(device, q_family_idx);
+            worker.used_count = 0u;
+        }
+    }
+
+    return recorder;
+}
+
+void command_recorder_release(CommandRecorder& recorder)
+{
+    // Destroying a pool frees its command buffers
+    for (RecorderFrame& frame : recorder.frames)
+        for (RecorderWorker& worker : frame.workers)
+            vkDestroyCommandPool(recorder.device, worker.command_pool, nullptr);
+
+    recorder.frames.clear();
+}
+
+void command_recorder_begin_frame(CommandRecorder& recorder, uint32_t frame_idx)
+{
+    for (RecorderWorker& worker : recorder.frames[frame_idx].workers)
+    {
+        if (worker.used_count == 0u)
+            continue;
+
+        VK_CHECK(vkResetCommandPool(recorder.device, worker.command_pool, 0x0));
+        worker.used_count = 0u;
+    }
+}
+
+void command_recorder_record(CommandRecorder& recorder, uint32_t frame_idx, VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance_info, uint32_t task_count, const RecordTask& task)
+{
+    if (task_count == 0u)
+        return;
+
+    RecorderFrame& frame = recorder.frames[frame_idx];
+    recorder.recorded.resize(task_count);
+
+    const VkCommandBufferBeginInfo begin_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance_info};
+
+    std::vector<std::future<void>> pending;
+    pending.reserve(task_count);
+
+    for (uint32_t task_idx = 0; task_idx < task_count; ++task_idx)
+    {
+        // Workers write to disjoint slots of recorded, the frame's worker data is only touched by its owner
+        pending.push_back(thread_pool_submit(*recorder.thread_pool, [&, task_idx](uint32_t worker_idx) {
+            RecorderWorker& worker = frame.workers[worker_idx];
+
+            if (worker.used_count == worker.command_buffers.size())
+                worker.command_buffers.push_back(create_command_buffer(recorder.device, worker.command_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+
+            VkCommandBuffer cmd_buff = worker.command_buffers[worker.used_count++];
+
+            VK_CHECK(vkBeginCommandBuffer(cmd_buff, &begin_info));
+            task(cmd_buff, task_idx);
+            VK_CHECK(vkEndCommandBuffer(cmd_buff));
+
+            recorder.recorded[task_idx] = cmd_buff;
+        }));
+    }
+
+    for (std::future<void>& future : pending)
+        future.get();
+
+    vkCmdExecuteCommands(primary, task_count, recorder.recorded.data());
+}
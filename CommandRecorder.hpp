@@ -0,0 +1,52 @@
+#ifndef COMMAND_RECORDER_HPP
+#define COMMAND_RECORDER_HPP
+
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ThreadPool.hpp"
+
+// Called on a worker with a secondary command buffer that is already begun and inherits the render pass
+typedef std::function<void(VkCommandBuffer cmd_buff, uint32_t task_idx)> RecordTask;
+
+// Secondary command buffers of one worker for one frame in flight. Buffers are allocated on demand and
+// kept, the whole pool is reset once the frame's fence has signaled.
+struct RecorderWorker
+{
+    VkCommandPool command_pool;
+    std::vector<VkCommandBuffer> command_buffers;
+    uint32_t used_count;
+};
+
+struct RecorderFrame
+{
+    std::vector<RecorderWorker> workers;    // Indexed by the thread pool's worker_idx
+};
+
+// Splits recording inside a render pass across the thread pool. Every worker owns one command pool per
+// frame in flight, so no pool is ever touched by two threads and nothing is locked while recording.
+struct CommandRecorder
+{
+    VkDevice device;
+    ThreadPool* thread_pool;
+
+    std::vector<RecorderFrame> frames;
+    std::vector<VkCommandBuffer> recorded;  // Scratch space, one secondary per task in task order
+};
+
+CommandRecorder create_command_recorder(VkDevice device, ThreadPool& thread_pool, uint32_t q_family_idx, uint32_t frame_count);
+
+void command_recorder_release(CommandRecorder& recorder);
+
+// Must be called after the fence of frame_idx has been waited on, before the first command_recorder_record
+void command_recorder_begin_frame(CommandRecorder& recorder, uint32_t frame_idx);
+
+// Runs task(cmd, 0 .. task_count-1) on the workers and waits for all of them. The primary command buffer
+// must be inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, or a dynamic
+// rendering begun with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR whose formats are chained to
+// inheritance_info. The secondaries are executed into it in task order.
+void command_recorder_record(CommandRecorder& recorder, uint32_t frame_idx, VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance_info, uint32_t task_count, const RecordTask& task);
+
+#endif // COMMAND_RECORDER_HPP
@@ -0,0 +1,130 @@
+#include <cassert>
+
+#include "DeletionQueue.hpp"
+
+static void destroy(DeletionQueue& queue, RetiredResource& resource)
+{
+    switch (resource.type)
+    {
+    case RETIRED_BUFFER:
+        vkDestroyBuffer(queue.device, resource.buffer, nullptr);
+        break;
+    case RETIRED_IMAGE:
+        vkDestroyImage(queue.device, resource.image, nullptr);
+        break;
+    case RETIRED_IMAGE_VIEW:
+        vkDestroyImageView(queue.device, resource.image_view, nullptr);
+        break;
+    case RETIRED_PIPELINE:
+        vkDestroyPipeline(queue.device, resource.pipeline, nullptr);
+        break;
+    case RETIRED_FRAMEBUFFER:
+        vkDestroyFramebuffer(queue.device, resource.framebuffer, nullptr);
+        break;
+    case RETIRED_SWAPCHAIN:
+        vkDestroySwapchainKHR(queue.device, resource.swapchain, nullptr);
+        break;
+    case RETIRED_MEMORY:
+        vkFreeMemory(queue.device, resource.memory, nullptr);
+        break;
+    case RETIRED_ALLOCATION:
+        break;
+    default:
+        assert(false);
+    }
+
+    if (resource.allocation.memory != VK_NULL_HANDLE)
+        allocator_free(*queue.allocator, resource.allocation);
+}
+
+static void retire(DeletionQueue& queue, RetiredResource resource)
+{
+    resource.frame = queue.current_frame;
+    queue.resources.push_back(resource);
+}
+
+DeletionQueue create_deletion_queue(VkDevice device, DeviceAllocator& allocator, uint32_t batch_size)
+{
+    assert(batch_size > 0u);
+
+    return DeletionQueue{
+        .device = device,
+        .allocator = &allocator,
+        .resources = {},
+        .current_frame = 1u,
+        .completed_frame = 0u,
+        .batch_size = batch_size,
+        .destroyed_count = 0u};
+}
+
+void deletion_queue_release(DeletionQueue& queue)
+{
+    for (RetiredResource& resource : queue.resources)
+        destroy(queue, resource);
+
+    queue.resources.clear();
+}
+
+void deletion_queue_begin_frame(DeletionQueue& queue, uint64_t frame, uint64_t completed_frame)
+{
+    assert(frame > completed_frame && frame >= queue.current_frame);
+
+    queue.current_frame = frame;
+    queue.completed_frame = completed_frame;
+    queue.destroyed_count = 0u;
+
+    while (!queue.resources.empty() && queue.resources.front().frame <= completed_frame && queue.destroyed_count < queue.batch_size)
+    {
+        destroy(queue, queue.resources.front());
+        queue.resources.pop_front();
+        ++queue.destroyed_count;
+    }
+}
+
+void deletion_queue_retire_buffer(DeletionQueue& queue, VkBuffer buffer, const Allocation& allocation)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_BUFFER, .buffer = buffer, .allocation = allocation};
+    retire(queue, resource);
+}
+
+void deletion_queue_retire_image(DeletionQueue& queue, VkImage image, const Allocation& allocation)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_IMAGE, .image = image, .allocation = allocation};
+    retire(queue, resource);
+}
+
+void deletion_queue_retire_image_view(DeletionQueue& queue, VkImageView image_view)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_IMAGE_VIEW, .image_view = image_view, .allocation = {}};
+    retire(queue, resource);
+}
+
+void deletion_queue_retire_pipeline(DeletionQueue& queue, VkPipeline pipeline)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_PIPELINE, .pipeline = pipeline, .allocation = {}};
+    retire(queue, resource);
+}
+
+void deletion_queue_retire_framebuffer(DeletionQueue& queue, VkFramebuffer framebuffer)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_FRAMEBUFFER, .framebuffer = framebuffer, .allocation = {}};
+    retire(queue, resource);
+}
+
+void deletion_queue_retire_swapchain(DeletionQueue& queue, VkSwapchainKHR swapchain)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_SWAPCHAIN, .swapchain = swapchain, .allocation = {}};
+    retire(queue, resource);
+}
+
+void deletion_queue_retire_memory(DeletionQueue& queue, VkDeviceMemory memory)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_MEMORY, .memory = memory, .allocation = {}};
+    retire(queue, resource);
+}
+
+void deletion_queue_retire_allocation(DeletionQueue& queue, const Allocation& allocation)
+{
+    RetiredResource resource{.frame = 0u, .type = RETIRED_ALLOCATION, .pipeline = VK_NULL_HANDLE, .allocation = allocation};
+    retire(queue, resource);
+}
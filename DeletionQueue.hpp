@@ -0,0 +1,92 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+
+#include <deque>
+
+#include <vulkan/vulkan.h>
+
+#include "Allocator.hpp"
+
+// Resources destroyed per deletion_queue_begin_frame call, so retiring a whole scene does not make one
+// frame take the hit
+constexpr uint32_t DELETION_QUEUE_DEFAULT_BATCH_SIZE = 64u;
+
+enum
+{
+    RETIRED_BUFFER      = 0,
+    RETIRED_IMAGE       = 1,
+    RETIRED_IMAGE_VIEW  = 2,
+    RETIRED_PIPELINE    = 3,
+    RETIRED_FRAMEBUFFER = 4,
+    RETIRED_SWAPCHAIN   = 5,
+    RETIRED_MEMORY      = 6, // Raw vkAllocateMemory memory, not from the DeviceAllocator
+    RETIRED_ALLOCATION  = 7, // Only the allocation is freed, e.g. memory shared by several retired resources
+    RETIRED_COUNT
+};
+
+struct RetiredResource
+{
+    uint64_t frame;                 // Destroyed once this frame has completed on the GPU
+    uint32_t type;                  // RETIRED_*
+
+    union
+    {
+        VkBuffer buffer;
+        VkImage image;
+        VkImageView image_view;
+        VkPipeline pipeline;
+        VkFramebuffer framebuffer;
+        VkSwapchainKHR swapchain;
+        VkDeviceMemory memory;
+    };
+
+    Allocation allocation;          // Freed with buffers, images and RETIRED_ALLOCATION, unless memory is null
+};
+
+// Defers destroying resources that command buffers still in flight may use. Frames are numbered from 1,
+// a resource retired while frame N is recorded may be used by any frame up to N and is destroyed once the
+// caller reports N as completed (by waiting on N's fence). Resources are retired in frame order, so the
+// queue is sorted and only its front is ever checked.
+//
+// Streaming code retires buffers and images instead of idling the device. Not thread safe.
+struct DeletionQueue
+{
+    VkDevice device;
+    DeviceAllocator* allocator;
+
+    std::deque<RetiredResource> resources;
+    uint64_t current_frame;         // Frame being recorded, resources retired now get this number
+    uint64_t completed_frame;
+    uint32_t batch_size;
+
+    uint32_t destroyed_count;       // In the last deletion_queue_begin_frame call
+};
+
+DeletionQueue create_deletion_queue(VkDevice device, DeviceAllocator& allocator, uint32_t batch_size = DELETION_QUEUE_DEFAULT_BATCH_SIZE);
+
+// Destroys every retired resource, the device has to be idle
+void deletion_queue_release(DeletionQueue& queue);
+
+// Starts recording frame, after frame completed_frame has finished on the GPU. Destroys at most batch_size
+// resources retired in completed_frame or earlier, the rest is left for the next frames.
+void deletion_queue_begin_frame(DeletionQueue& queue, uint64_t frame, uint64_t completed_frame);
+
+// The handles must not be used in commands recorded after this call
+void deletion_queue_retire_buffer(DeletionQueue& queue, VkBuffer buffer, const Allocation& allocation);
+
+void deletion_queue_retire_image(DeletionQueue& queue, VkImage image, const Allocation& allocation);
+
+void deletion_queue_retire_image_view(DeletionQueue& queue, VkImageView image_view);
+
+void deletion_queue_retire_pipeline(DeletionQueue& queue, VkPipeline pipeline);
+
+void deletion_queue_retire_framebuffer(DeletionQueue& queue, VkFramebuffer framebuffer);
+
+// Its presentable images may still be in use by frames in flight, they are released with it
+void deletion_queue_retire_swapchain(DeletionQueue& queue, VkSwapchainKHR swapchain);
+
+void deletion_queue_retire_memory(DeletionQueue& queue, VkDeviceMemory memory);
+
+void deletion_queue_retire_allocation(DeletionQueue& queue, const Allocation& allocation);
+
+#endif // DELETION_QUEUE_HPP
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cassert>
+#include <math.h>
+
+#include "DescriptorAllocator.hpp"
+#include "Defines.hpp"
+
+static VkDescriptorPool create_pool(const DescriptorAllocator& allocator)
+{
+    std::vector<VkDescriptorPoolSize> pool_sizes;
+    pool_sizes.reserve(allocator.ratios.size());
+
+    for (const DescriptorPoolRatio& ratio : allocator.ratios)
+    {
+        pool_sizes.push_back(VkDescriptorPoolSize{
+            .type = ratio.type,
+            .descriptorCount = std::max(static_cast<uint32_t>(ceilf(ratio.ratio * allocator.sets_per_pool)), 1u)});
+    }
+
+    const VkDescriptorPoolCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .maxSets = allocator.sets_per_pool,
+        .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+        .pPoolSizes = pool_sizes.data()};
+
+    VkDescriptorPool pool;
+    VK_CHECK(vkCreateDescriptorPool(allocator.device, &create_info, nullptr, &pool));
+    return pool;
+}
+
+// The last ready pool, a new one if all of them are full
+static VkDescriptorPool get_pool(DescriptorAllocator& allocator)
+{
+    if (allocator.ready_pools.empty())
+    {
+        allocator.ready_pools.push_back(create_pool(allocator));
+        allocator.sets_per_pool = std::min(allocator.sets_per_pool * 2u, DESCRIPTOR_ALLOCATOR_MAX_SETS_PER_POOL);
+    }
+
+    return allocator.ready_pools.back();
+}
+
+DescriptorAllocator create_descriptor_allocator(VkDevice device, uint32_t initial_sets_per_pool, const std::vector<DescriptorPoolRatio>& ratios)
+{
+    assert(initial_sets_per_pool > 0u && !ratios.empty());
+
+    return DescriptorAllocator{
+        .device = device,
+        .ratios = ratios,
+        .sets_per_pool = std::min(initial_sets_per_pool, DESCRIPTOR_ALLOCATOR_MAX_SETS_PER_POOL),
+        .ready_pools = {},
+        .full_pools = {},
+        .live_set_count = 0u};
+}
+
+void descriptor_allocator_release(DescriptorAllocator& allocator)
+{
+    for (VkDescriptorPool pool : allocator.ready_pools)
+        vkDestroyDescriptorPool(allocator.device, pool, nullptr);
+
+    for (VkDescriptorPool pool : allocator.full_pools)
+        vkDestroyDescriptorPool(allocator.device, pool, nullptr);
+
+    allocator.ready_pools.clear();
+    allocator.full_pools.clear();
+    allocator.live_set_count = 0u;
+}
+
+VkDescriptorSet descriptor_allocator_allocate(DescriptorAllocator& allocator, VkDescriptorSetLayout layout)
+{
+    for (;;)
+    {
+        const bool new_pool = allocator.ready_pools.empty();
+
+        const VkDescriptorSetAllocateInfo allocate_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = get_pool(allocator),
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout};
+
+        VkDescriptorSet set;
+        const VkResult result = vkAllocateDescriptorSets(allocator.device, &allocate_info, &set);
+
+        if (result == VK_SUCCESS)
+        {
+            ++allocator.live_set_count;
+            return set;
+        }
+
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+            VK_CHECK(result);
+
+        // Only happens if the layout needs more descriptors of a type than the ratios give a whole pool
+        if (new_pool)
+            EXIT("Descriptor set layout does not fit into an empty descriptor pool");
+
+        allocator.full_pools.push_back(allocator.ready_pools.back());
+        allocator.ready_pools.pop_back();
+    }
+}
+
+void descriptor_allocator_reset(DescriptorAllocator& allocator)
+{
+    for (VkDescriptorPool pool : allocator.ready_pools)
+        VK_CHECK(vkResetDescriptorPool(allocator.device, pool, 0x0));
+
+    for (VkDescriptorPool pool : allocator.full_pools)
+    {
+        VK_CHECK(vkResetDescriptorPool(allocator.device, pool, 0x0));
+        allocator.ready_pools.push_back(pool);
+    }
+
+    allocator.full_pools.clear();
+    allocator.live_set_count = 0u;
+}
+
+uint32_t descriptor_allocator_pool_count(const DescriptorAllocator& allocator)
+{
+    return static_cast<uint32_t>(allocator.ready_pools.size() + allocator.full_pools.size());
+}
+
+size_t DescriptorLayoutKeyHash::operator()(const std::vector<VkDescriptorSetLayoutBinding>& bindings) const
+{
+    size_t hash = bindings.size();
+
+    for (const VkDescriptorSetLayoutBinding& binding : bindings)
+    {
+        const uint64_t packed = static_cast<uint64_t>(binding.binding) | (static_cast<uint64_t>(binding.descriptorType) << 16) |
+                                (static_cast<uint64_t>(binding.descriptorCount) << 24) | (static_cast<uint64_t>(binding.stageFlags) << 40);
+        hash ^= std::hash<uint64_t>()(packed) + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+    }
+
+    return hash;
+}
+
+bool DescriptorLayoutKeyEqual::operator()(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b) const
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const VkDescriptorSetLayoutBinding& x, const VkDescriptorSetLayoutBinding& y) {
+        return x.binding == y.binding && x.descriptorType == y.descriptorType && x.descriptorCount == y.descriptorCount && x.stageFlags == y.stageFlags;
+    });
+}
+
+DescriptorLayoutCache create_descriptor_layout_cache(VkDevice device)
+{
+    return DescriptorLayoutCache{
+        .device = device,
+        .layouts = {}};
+}
+
+void descriptor_layout_cache_release(DescriptorLayoutCache& cache)
+{
+    for (const auto& [bindings, layout] : cache.layouts)
+        vkDestroyDescriptorSetLayout(cache.device, layout, nullptr);
+
+    cache.layouts.clear();
+}
+
+VkDescriptorSetLayout descriptor_layout_cache_get(DescriptorLayoutCache& cache, const VkDescriptorSetLayoutBinding* bindings, uint32_t binding_count)
+{
+    std::vector<VkDescriptorSetLayoutBinding> key(bindings, bindings + binding_count);
+    std::sort(key.begin(), key.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+    for (const VkDescriptorSetLayoutBinding& binding : key)
+        assert(binding.pImmutableSamplers == nullptr);
+
+    const auto it = cache.layouts.find(key);
+    if (it != cache.layouts.end())
+        return it->second;
+
+    const VkDescriptorSetLayoutCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .bindingCount = binding_count,
+        .pBindings = key.data()};
+
+    VkDescriptorSetLayout layout;
+    VK_CHECK(vkCreateDescriptorSetLayout(cache.device, &create_info, nullptr, &layout));
+
+    cache.layouts.emplace(std::move(key), layout);
+    return layout;
+}
@@ -0,0 +1,74 @@
+#ifndef DESCRIPTOR_ALLOCATOR_HPP
+#define DESCRIPTOR_ALLOCATOR_HPP
+
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+constexpr uint32_t DESCRIPTOR_ALLOCATOR_MAX_SETS_PER_POOL = 4096u;
+
+// Descriptors of type per set, a pool for n sets holds ceil(ratio * n) of them
+struct DescriptorPoolRatio
+{
+    VkDescriptorType type;
+    float ratio;
+};
+
+// Hands out descriptor sets from a growing list of pools. Pools are created on demand, sized for
+// sets_per_pool sets with the descriptor counts given by the ratios, and every new pool is twice as large
+// as the previous one (up to DESCRIPTOR_ALLOCATOR_MAX_SETS_PER_POOL). An allocation that fails with
+// VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL retires the pool and is retried in the next one.
+//
+// Sets are never freed one by one, descriptor_allocator_reset recycles all of them at once, so the pools
+// are created without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT. Not thread safe.
+struct DescriptorAllocator
+{
+    VkDevice device;
+    std::vector<DescriptorPoolRatio> ratios;
+    uint32_t sets_per_pool;                   // Of the next pool that is created
+
+    std::vector<VkDescriptorPool> ready_pools;  // May have room left, allocations go to the last one
+    std::vector<VkDescriptorPool> full_pools;
+
+    uint32_t live_set_count;                  // Allocated since the last reset
+};
+
+DescriptorAllocator create_descriptor_allocator(VkDevice device, uint32_t initial_sets_per_pool, const std::vector<DescriptorPoolRatio>& ratios);
+
+void descriptor_allocator_release(DescriptorAllocator& allocator);
+
+VkDescriptorSet descriptor_allocator_allocate(DescriptorAllocator& allocator, VkDescriptorSetLayout layout);
+
+// Every set allocated so far becomes invalid. The pools are kept, a per-frame allocator stops creating new
+// ones once they fit the frame's sets.
+void descriptor_allocator_reset(DescriptorAllocator& allocator);
+
+uint32_t descriptor_allocator_pool_count(const DescriptorAllocator& allocator);
+
+struct DescriptorLayoutKeyHash
+{
+    size_t operator()(const std::vector<VkDescriptorSetLayoutBinding>& bindings) const;
+};
+
+struct DescriptorLayoutKeyEqual
+{
+    bool operator()(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b) const;
+};
+
+// Owns one VkDescriptorSetLayout per distinct set of bindings, so identical layouts requested by different
+// pipelines are the same handle
+struct DescriptorLayoutCache
+{
+    VkDevice device;
+    std::unordered_map<std::vector<VkDescriptorSetLayoutBinding>, VkDescriptorSetLayout, DescriptorLayoutKeyHash, DescriptorLayoutKeyEqual> layouts;
+};
+
+DescriptorLayoutCache create_descriptor_layout_cache(VkDevice device);
+
+void descriptor_layout_cache_release(DescriptorLayoutCache& cache);
+
+// Bindings may be in any order, immutable samplers are not supported. The layout is owned by the cache.
+VkDescriptorSetLayout descriptor_layout_cache_get(DescriptorLayoutCache& cache, const VkDescriptorSetLayoutBinding* bindings, uint32_t binding_count);
+
+#endif // DESCRIPTOR_ALLOCATOR_HPP
@@ -1,7 +1,13 @@
+#include <algorithm>
 #include <array>
+#include <string>
+#include <utility>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "Helpers.hpp"
+#include "Allocator.hpp"
 #include "Defines.hpp"
 
 namespace
@@ -9,6 +15,15 @@ namespace
     VkPhysicalDeviceSynchronization2FeaturesKHR sync_2_features{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
         .synchronization2 = VK_TRUE};
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+        .dynamicRendering = VK_TRUE};
+
+    // Every 1.2 feature is enabled through this one struct, it must not be chained together with the
+    // individual feature structs it replaces
+    VkPhysicalDeviceVulkan12Features vulkan_12_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
 }
 
 static VkInstance create_instance(const std::vector<const char *> &extensions, const std::vector<const char *> &layers)
@@ -39,25 +54,263 @@ static VkSurfaceKHR create_surface(VkInstance instance, GLFWwindow *window)
     return surface;
 }
 
-static VkPhysicalDevice select_physical_device(VkInstance instance)
+// Why a device can not enable the extensions, nullptr if it can
+static const char* check_device_extensions(VkPhysicalDevice physical_device, const std::vector<uint32_t>& device_extension_ids)
+{
+    uint32_t num_extensions = 0;
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &num_extensions, nullptr));
+    std::vector<VkExtensionProperties> extensions(num_extensions);
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &num_extensions, extensions.data()));
+
+    auto has_extension = [&](const char* name)
+    {
+        return std::any_of(extensions.begin(), extensions.end(), [&](const VkExtensionProperties& ext) { return strcmp(ext.extensionName, name) == 0; });
+    };
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync_2{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR};
+    VkPhysicalDeviceVulkan12Features vulkan_12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan_12};
+
+    // Extension feature structs may only be chained if the device has the extension
+    const bool has_sync_2 = has_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    const bool has_dynamic_rendering = has_extension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    void** next_p_next = &vulkan_12.pNext;
+    if (has_sync_2)
+    {
+        *next_p_next = &sync_2;
+        next_p_next = &sync_2.pNext;
+    }
+    if (has_dynamic_rendering)
+        *next_p_next = &dynamic_rendering;
+
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+
+    for (const uint32_t ext_id : device_extension_ids)
+    {
+        switch (ext_id)
+        {
+        case DEVICE_EXT_SWAPCHAIN:
+            if (!has_extension(VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+                return "VK_KHR_swapchain not supported";
+            break;
+        case DEVICE_EXT_SYNC_2:
+            if (!has_sync_2 || !sync_2.synchronization2)
+                return "synchronization2 not supported";
+            break;
+        case DEVICE_EXT_DYNAMIC_RENDERING:
+            if (!has_dynamic_rendering || !dynamic_rendering.dynamicRendering)
+                return "dynamicRendering not supported";
+            break;
+        case DEVICE_EXT_TIMELINE_SEMAPHORE:
+            if (!vulkan_12.timelineSemaphore)
+                return "timelineSemaphore not supported";
+            break;
+        case DEVICE_EXT_MULTI_DRAW_INDIRECT:
+            if (!features.features.multiDrawIndirect || !features.features.drawIndirectFirstInstance)
+                return "multi draw indirect not supported";
+            break;
+        default:
+            break;
+        }
+    }
+
+    return nullptr;
+}
+
+// Why a device can not run the app, nullptr if it can. Only checks what create_device and the renderer rely on.
+static const char* check_physical_device(VkPhysicalDevice physical_device, VkSurfaceKHR surface, const std::vector<uint32_t>& device_extension_ids)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+
+    if (props.apiVersion < VK_API_VERSION_1_2)
+        return "Vulkan 1.2 not supported";
+
+    const char* extension_rejection = check_device_extensions(physical_device, device_extension_ids);
+    if (extension_rejection != nullptr)
+        return extension_rejection;
+
+    // Every allocator block and dedicated allocation is one vkAllocateMemory
+    if (props.limits.maxMemoryAllocationCount < DEVICE_MIN_MEMORY_ALLOCATION_COUNT)
+        return "maxMemoryAllocationCount too low";
+
+    uint32_t num_q_family_props = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_q_family_props, nullptr);
+    std::vector<VkQueueFamilyProperties> q_family_props(num_q_family_props);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_q_family_props, q_family_props.data());
+
+    for (uint32_t i = 0; i < num_q_family_props; ++i)
+    {
+        if ((q_family_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0)
+            continue;
+
+        if (surface == VK_NULL_HANDLE)
+            return nullptr;
+
+        VkBool32 q_fam_supports_present = false;
+        vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &q_fam_supports_present);
+        if (q_fam_supports_present)
+            return nullptr;
+    }
+
+    return (surface == VK_NULL_HANDLE) ? "no graphics queue" : "no graphics queue that can present to the surface";
+}
+
+// Device type dominates, so a discrete GPU always beats an integrated one and software rasterizers are only
+// picked when nothing else qualifies. Within a type, every MiB of device local memory counts 1, a dedicated
+// transfer queue (see Uploader) is worth a GiB.
+static int64_t score_physical_device(VkPhysicalDevice physical_device)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+
+    int64_t score = 0;
+    switch (props.deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        score += 4000000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        score += 3000000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        score += 2000000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        break;
+    default:
+        score += 1000000;
+        break;
+    }
+
+    // MiB of the largest device local heap, capped below the next type's bonus
+    VkPhysicalDeviceMemoryProperties memory_props;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_props);
+
+    VkDeviceSize device_local_size = 0u;
+    for (uint32_t i = 0; i < memory_props.memoryHeapCount; ++i)
+    {
+        if (memory_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            device_local_size = std::max(device_local_size, memory_props.memoryHeaps[i].size);
+    }
+    score += std::min<int64_t>(static_cast<int64_t>(device_local_size >> 20), 900000);
+
+    uint32_t num_q_family_props = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_q_family_props, nullptr);
+    std::vector<VkQueueFamilyProperties> q_family_props(num_q_family_props);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_q_family_props, q_family_props.data());
+
+    for (const VkQueueFamilyProperties& q_family : q_family_props)
+    {
+        if ((q_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(q_family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            score += 1024;
+            break;
+        }
+    }
+
+    // The profiler needs timestamps on the graphics queue
+    if (props.limits.timestampComputeAndGraphics)
+        score += 256;
+
+    return score;
+}
+
+static const char* physical_device_type_name(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+// The highest scoring device that qualifies, unless the override names one. The override is a device index
+// or a case sensitive part of the device name.
+static VkPhysicalDevice select_physical_device(VkInstance instance, VkSurfaceKHR surface, const std::vector<uint32_t>& device_extension_ids, const char* device_override)
 {
     uint32_t num_physical_devices = 0;
     vkEnumeratePhysicalDevices(instance, &num_physical_devices, nullptr);
     std::vector<VkPhysicalDevice> physical_devices(num_physical_devices);
     vkEnumeratePhysicalDevices(instance, &num_physical_devices, physical_devices.data());
 
+    if (device_override == nullptr)
+        device_override = getenv(DEVICE_OVERRIDE_ENV);
+
+    uint32_t best_idx = UINT32_MAX;
+    int64_t best_score = -1;
+    uint32_t override_idx = UINT32_MAX;
+    const char* override_rejection = nullptr;
+
     LOG("# Physical Devices: %u\n", num_physical_devices);
     for (uint32_t i = 0; i < num_physical_devices; ++i)
     {
         VkPhysicalDeviceProperties props;
         vkGetPhysicalDeviceProperties(physical_devices[i], &props);
-        LOG("%i : %s\n", i, props.deviceName);
+
+        const char* rejection = check_physical_device(physical_devices[i], surface, device_extension_ids);
+        const int64_t score = (rejection == nullptr) ? score_physical_device(physical_devices[i]) : -1;
+
+        if (rejection != nullptr)
+        {
+            LOG("%u : %s (%s) rejected: %s\n", i, props.deviceName, physical_device_type_name(props.deviceType), rejection);
+        }
+        else
+        {
+            LOG("%u : %s (%s) score %lld\n", i, props.deviceName, physical_device_type_name(props.deviceType), static_cast<long long>(score));
+        }
+
+        if (score > best_score)
+        {
+            best_score = score;
+            best_idx = i;
+        }
+
+        if (device_override != nullptr && override_idx == UINT32_MAX)
+        {
+            char* end = nullptr;
+            const unsigned long idx = strtoul(device_override, &end, 10);
+            const bool matches = (end != device_override && *end == '\0') ? (idx == i) : (strstr(props.deviceName, device_override) != nullptr);
+
+            if (matches)
+            {
+                override_idx = i;
+                override_rejection = rejection;
+            }
+        }
     }
 
-    const uint32_t physical_device_index = 2u;
-    LOG("Using Physical Device %u\n\n", physical_device_index);
+    if (device_override != nullptr)
+    {
+        if (override_idx == UINT32_MAX)
+        {
+            LOG("No physical device matches %s, ignoring it\n", device_override);
+        }
+        else if (override_rejection != nullptr)
+        {
+            EXIT("Physical device " << override_idx << " matching " << device_override << " can not be used: " << override_rejection);
+        }
+        else
+        {
+            LOG("Using Physical Device %u (override %s)\n\n", override_idx, device_override);
+            return physical_devices[override_idx];
+        }
+    }
 
-    return physical_devices[physical_device_index];
+    if (best_idx == UINT32_MAX)
+        EXIT("No physical device supports the required features");
+
+    LOG("Using Physical Device %u (highest score)\n\n", best_idx);
+    return physical_devices[best_idx];
 }
 
 static std::vector<uint32_t> select_q_family_indices(VkPhysicalDevice physical_device, VkSurfaceKHR surface, const std::vector<VkQueueFlagBits> &q_flags)
@@ -100,7 +353,7 @@ static std::vector<uint32_t> select_q_family_indices(VkPhysicalDevice physical_d
         {
             if (q_family_props[i].queueFlags & q_flag)
             {
-                if (present)
+                if (present && surface != VK_NULL_HANDLE)
                 {
                     VkBool32 q_fam_supports_present = false;
                     vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &q_fam_supports_present);
@@ -133,8 +386,14 @@ static VkDevice create_device(VkPhysicalDevice physical_device, const std::vecto
 
     std::vector<VkDeviceQueueCreateInfo> q_create_infos;
     q_create_infos.reserve(q_family_indices.size());
-    for (const uint32_t idx : q_family_indices)
+    for (uint32_t i = 0; i < q_family_indices.size(); ++i)
     {
+        const uint32_t idx = q_family_indices[i];
+
+        // Several queue types can map to the same family, which then shares a single queue
+        if (std::find(q_family_indices.begin(), q_family_indices.begin() + i, idx) != q_family_indices.begin() + i)
+            continue;
+
         const VkDeviceQueueCreateInfo q_create_info{
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             .queueFamilyIndex = idx,
@@ -148,26 +407,55 @@ static VkDevice create_device(VkPhysicalDevice physical_device, const std::vecto
     void *p_next_chain = nullptr;
     void **next_p_next = nullptr;
 
+    auto chain_features = [&](void *features, void **features_p_next)
+    {
+        if (p_next_chain == nullptr)
+            p_next_chain = features;
+        else
+            *next_p_next = features;
+
+        next_p_next = features_p_next;
+    };
+
+    VkPhysicalDeviceFeatures device_features{};
+
+    bool vulkan_12_features_chained = false;
+    auto chain_vulkan_12_features = [&]()
+    {
+        if (!vulkan_12_features_chained)
+            chain_features(&vulkan_12_features, &vulkan_12_features.pNext);
+
+        vulkan_12_features_chained = true;
+    };
+
     for (const uint32_t ext_id : device_extension_ids)
     {
         switch (ext_id)
         {
         case DEVICE_EXT_SYNC_2:
         {
-            if (p_next_chain == nullptr)
-            {
-                p_next_chain = (void *)(&sync_2_features);
-                next_p_next = &sync_2_features.pNext;
-            }
-            else
-            {
-                *next_p_next = &sync_2_features;
-            }
+            // Only core in 1.3, the instance is created with 1.2
+            device_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+            chain_features(&sync_2_features, &sync_2_features.pNext);
             break;
         }
+        case DEVICE_EXT_DYNAMIC_RENDERING:
+            // Only core in 1.3, like sync 2
+            device_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+            chain_features(&dynamic_rendering_features, &dynamic_rendering_features.pNext);
+            break;
         case DEVICE_EXT_SWAPCHAIN:
             device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
             break;
+        case DEVICE_EXT_TIMELINE_SEMAPHORE:
+            vulkan_12_features.timelineSemaphore = VK_TRUE;
+            chain_vulkan_12_features();
+            break;
+        case DEVICE_EXT_MULTI_DRAW_INDIRECT:
+            // Indirect draws are instanced batches starting at their batch's firstInstance, one multi-draw per index type
+            device_features.drawIndirectFirstInstance = VK_TRUE;
+            device_features.multiDrawIndirect = VK_TRUE;
+            break;
         default:
             EXIT("Unsupported device extension specified!");
             break;
@@ -183,13 +471,33 @@ static VkDevice create_device(VkPhysicalDevice physical_device, const std::vecto
         .ppEnabledLayerNames = nullptr,
         .enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
         .ppEnabledExtensionNames = device_extensions.data(),
-        .pEnabledFeatures = nullptr};
+        .pEnabledFeatures = &device_features};
 
     VkDevice device;
     VK_CHECK(vkCreateDevice(physical_device, &device_create_info, nullptr, &device));
     return device;
 }
 
+static void load_device_functions(VulkanManager &vulkan_manager, const std::vector<uint32_t> &device_extension_ids)
+{
+    for (const uint32_t ext_id : device_extension_ids)
+    {
+        switch (ext_id)
+        {
+        case DEVICE_EXT_SYNC_2:
+            vulkan_manager.vkCmdWriteTimestamp2KHR = (PFN_vkCmdWriteTimestamp2KHR)vkGetDeviceProcAddr(vulkan_manager.device, "vkCmdWriteTimestamp2KHR");
+            vulkan_manager.vkCmdPipelineBarrier2KHR = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(vulkan_manager.device, "vkCmdPipelineBarrier2KHR");
+            break;
+        case DEVICE_EXT_DYNAMIC_RENDERING:
+            vulkan_manager.vkCmdBeginRenderingKHR = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(vulkan_manager.device, "vkCmdBeginRenderingKHR");
+            vulkan_manager.vkCmdEndRenderingKHR = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(vulkan_manager.device, "vkCmdEndRenderingKHR");
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 static std::vector<VkQueue> get_queues(VkDevice device, const std::vector<uint32_t> &q_family_indices)
 {
     std::vector<VkQueue> queues(q_family_indices.size(), VK_NULL_HANDLE);
@@ -202,7 +510,8 @@ static std::vector<VkQueue> get_queues(VkDevice device, const std::vector<uint32
     return queues;
 }
 
-static VkSwapchainCreateInfoKHR populate_swapchain_create_info(VkPhysicalDevice physical_device, VkSurfaceKHR surface, uint32_t image_count, VkFormat format, VkExtent2D extent, VkPresentModeKHR present_mode)
+static VkSwapchainCreateInfoKHR populate_swapchain_create_info(VkPhysicalDevice physical_device, VkSurfaceKHR surface, uint32_t image_count, VkFormat format, VkExtent2D extent, VkPresentModeKHR present_mode,
+                                                               VkSwapchainKHR old_swapchain)
 {
     VkSurfaceCapabilitiesKHR surface_capabilities;
     VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &surface_capabilities));
@@ -269,10 +578,13 @@ static VkSwapchainCreateInfoKHR populate_swapchain_create_info(VkPhysicalDevice
     //** Extent
     {
         // The Vulkan Spec states that if the current width/height is 0xFFFFFFFF, then the surface size
-        // will be deteremined by the extent specified in the VkSwapchainCreateInfoKHR.
-        if (surface_capabilities.currentExtent.width != (uint32_t)-1)
+        // will be deteremined by the extent specified in the VkSwapchainCreateInfoKHR. Otherwise the
+        // swapchain has to match the surface, which may already have been resized again.
+        if (surface_capabilities.currentExtent.width == (uint32_t)-1)
         {
-            swapchain_create_info.imageExtent = extent;
+            swapchain_create_info.imageExtent = {
+                .width = std::clamp(extent.width, surface_capabilities.minImageExtent.width, surface_capabilities.maxImageExtent.width),
+                .height = std::clamp(extent.height, surface_capabilities.minImageExtent.height, surface_capabilities.maxImageExtent.height)};
         }
         else
         {
@@ -341,11 +653,16 @@ static VkSwapchainCreateInfoKHR populate_swapchain_create_info(VkPhysicalDevice
                 break;
             }
         }
+
+        if (swapchain_create_info.presentMode != present_mode)
+        {
+            LOG("Requested present mode %d is not supported, using FIFO\n", present_mode);
+        }
     }
 
     //** Creating Swapchain
     swapchain_create_info.clipped = VK_TRUE;
-    swapchain_create_info.oldSwapchain = VK_NULL_HANDLE;
+    swapchain_create_info.oldSwapchain = old_swapchain;
 
     return swapchain_create_info;
 }
@@ -391,44 +708,73 @@ static std::vector<VkImageView> create_swapchain_image_views(VkDevice device, co
     return image_views;
 }
 
-static uint32_t get_heap_idx(const uint32_t memory_type_indices, const VkMemoryPropertyFlags memory_property_flags, VkPhysicalDeviceMemoryProperties memory_properties)
+static void create_offscreen_images(VkDevice device, uint32_t image_count, VkFormat format, VkExtent2D extent, const VkPhysicalDeviceMemoryProperties& memory_properties,
+                                   std::vector<VkImage>& images, std::vector<VkDeviceMemory>& memory)
 {
-    // Iterate over all memory types available for the device used in this example
-    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+    images.resize(image_count, VK_NULL_HANDLE);
+    memory.resize(image_count, VK_NULL_HANDLE);
+
+    for (uint32_t i = 0; i < image_count; ++i)
     {
-        if (memory_type_indices & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & memory_property_flags) == memory_property_flags)
-        {
-            return i;
-        }
+        // TRANSFER_SRC so results can be read back / compared by batch jobs
+        images[i] = create_image(device, format, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        memory[i] = allocate_image_memory(device, images[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory_properties);
+        VK_CHECK(vkBindImageMemory(device, images[i], memory[i], 0));
     }
 
-    assert(false && "Could not find suitable memory type!");
-    return 0;
+    LOG("Headless Offscreen Image Count: %u\n", image_count);
 }
 
-
 VulkanManager vulkan_init(const VulkanInitParams& params)
 {
     VkInstance instance = create_instance(params.instance_extensions, params.instance_layers);
-    VkSurfaceKHR surface = create_surface(instance, params.window);
-    VkPhysicalDevice physical_device = select_physical_device(instance);
+    VkSurfaceKHR surface = params.headless ? VK_NULL_HANDLE : create_surface(instance, params.window);
+    VkPhysicalDevice physical_device = select_physical_device(instance, surface, params.device_extension_ids, params.device_override);
     std::vector<uint32_t> q_family_indices = select_q_family_indices(physical_device, surface, params.queue_flags);
-    VkDevice device = create_device(physical_device, q_family_indices, params.device_extension_ids);
-    std::vector<VkQueue> queues = get_queues(device, q_family_indices);
 
-    VkSwapchainCreateInfoKHR swapchain_create_info = populate_swapchain_create_info(physical_device, surface, params.swapchain_image_count, params.swapchain_format, {params.window_width, params.window_height}, params.swapchain_present_mode);
-    VkFormat swapchain_format = swapchain_create_info.imageFormat;
-    VkExtent2D swapchain_extent = swapchain_create_info.imageExtent;
+    std::vector<uint32_t> device_extension_ids = params.device_extension_ids;
+    for (const uint32_t ext_id : params.optional_device_extension_ids)
+    {
+        if (check_device_extensions(physical_device, {ext_id}) == nullptr)
+            device_extension_ids.push_back(ext_id);
+    }
 
-    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
-    VK_CHECK(vkCreateSwapchainKHR(device, &swapchain_create_info, nullptr, &swapchain));
-    std::vector<VkImage> swapchain_images = get_swapchain_images(device, swapchain);
-    std::vector<VkImageView> swapchain_image_views = create_swapchain_image_views(device, swapchain_images, swapchain_format);
+    VkDevice device = create_device(physical_device, q_family_indices, device_extension_ids);
+    std::vector<VkQueue> queues = get_queues(device, q_family_indices);
+
+    VkPhysicalDeviceProperties physical_device_properties;
+    vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
 
     VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
     vkGetPhysicalDeviceMemoryProperties(physical_device, &physical_device_memory_properties);
 
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    VkFormat swapchain_format = params.swapchain_format;
+    VkExtent2D swapchain_extent = {params.window_width, params.window_height};
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    std::vector<VkImage> swapchain_images;
+    std::vector<VkDeviceMemory> swapchain_image_memory;
+
+    if (params.headless)
+    {
+        create_offscreen_images(device, params.swapchain_image_count, swapchain_format, swapchain_extent, physical_device_memory_properties, swapchain_images, swapchain_image_memory);
+    }
+    else
+    {
+        VkSwapchainCreateInfoKHR swapchain_create_info = populate_swapchain_create_info(physical_device, surface, params.swapchain_image_count, params.swapchain_format, swapchain_extent,
+                                                                                        params.swapchain_present_mode, VK_NULL_HANDLE);
+        swapchain_format = swapchain_create_info.imageFormat;
+        swapchain_extent = swapchain_create_info.imageExtent;
+        present_mode = swapchain_create_info.presentMode;
+
+        VK_CHECK(vkCreateSwapchainKHR(device, &swapchain_create_info, nullptr, &swapchain));
+        swapchain_images = get_swapchain_images(device, swapchain);
+    }
+
+    std::vector<VkImageView> swapchain_image_views = create_swapchain_image_views(device, swapchain_images, swapchain_format);
+
     VulkanManager vulkan_manager {
+        .headless = params.headless,
         .instance = instance,
         .surface = surface,
         .physical_device = physical_device,
@@ -438,11 +784,17 @@ VulkanManager vulkan_init(const VulkanInitParams& params)
         .queues = queues,
         .swapchain_format = swapchain_format,
         .swapchain_extent = swapchain_extent,
+        .present_mode = present_mode,
+        .swapchain_min_image_count = params.swapchain_image_count,
         .swapchain_images = swapchain_images,
         .swapchain_image_views = swapchain_image_views,
+        .swapchain_image_memory = swapchain_image_memory,
+        .physical_device_properties = physical_device_properties,
         .physical_device_memory_properties = physical_device_memory_properties
     };
 
+    load_device_functions(vulkan_manager, device_extension_ids);
+
     return vulkan_manager;
 }
 
@@ -451,48 +803,123 @@ void vulkan_release(VulkanManager& vulkan_manager)
     for (uint32_t i = 0; i < vulkan_manager.swapchain_images.size(); ++i)
         vkDestroyImageView(vulkan_manager.device, vulkan_manager.swapchain_image_views[i], nullptr);
 
-    vkDestroySwapchainKHR(vulkan_manager.device, vulkan_manager.swapchain, nullptr);
+    if (vulkan_manager.headless)
+    {
+        for (uint32_t i = 0; i < vulkan_manager.swapchain_images.size(); ++i)
+        {
+            vkDestroyImage(vulkan_manager.device, vulkan_manager.swapchain_images[i], nullptr);
+            vkFreeMemory(vulkan_manager.device, vulkan_manager.swapchain_image_memory[i], nullptr);
+        }
+    }
+    else
+    {
+        vkDestroySwapchainKHR(vulkan_manager.device, vulkan_manager.swapchain, nullptr);
+    }
+
     vkDestroyDevice(vulkan_manager.device, nullptr);
-    vkDestroySurfaceKHR(vulkan_manager.instance, vulkan_manager.surface, nullptr);
+
+    if (!vulkan_manager.headless)
+        vkDestroySurfaceKHR(vulkan_manager.instance, vulkan_manager.surface, nullptr);
+
     vkDestroyInstance(vulkan_manager.instance, nullptr);
 }
 
-VkShaderModule create_shader_module(VkDevice device, const char *filename)
+OldSwapchain vulkan_recreate_swapchain(VulkanManager& vulkan_manager, VkExtent2D extent, VkPresentModeKHR present_mode)
 {
-    FILE *f = fopen(filename, "r");
-    if (f == NULL)
+    OldSwapchain old_swapchain{
+        .swapchain = VK_NULL_HANDLE,
+        .image_views = std::move(vulkan_manager.swapchain_image_views),
+        .images = {},
+        .image_memory = {}};
+
+    if (vulkan_manager.headless)
+    {
+        old_swapchain.images = std::move(vulkan_manager.swapchain_images);
+        old_swapchain.image_memory = std::move(vulkan_manager.swapchain_image_memory);
+        vulkan_manager.swapchain_images.clear();
+        vulkan_manager.swapchain_image_memory.clear();
+
+        vulkan_manager.swapchain_extent = extent;
+        create_offscreen_images(vulkan_manager.device, vulkan_manager.swapchain_min_image_count, vulkan_manager.swapchain_format, extent, vulkan_manager.physical_device_memory_properties,
+                                vulkan_manager.swapchain_images, vulkan_manager.swapchain_image_memory);
+    }
+    else
     {
-        printf("Failed to open file %s!\n", filename);
-        exit(EXIT_FAILURE);
+        // The old swapchain lets the presentation engine hand its resources over, its images are released
+        // once the caller destroys it
+        const VkSwapchainCreateInfoKHR swapchain_create_info = populate_swapchain_create_info(vulkan_manager.physical_device, vulkan_manager.surface, vulkan_manager.swapchain_min_image_count,
+                                                                                              vulkan_manager.swapchain_format, extent, present_mode, vulkan_manager.swapchain);
+
+        VkSwapchainKHR swapchain;
+        VK_CHECK(vkCreateSwapchainKHR(vulkan_manager.device, &swapchain_create_info, nullptr, &swapchain));
+
+        old_swapchain.swapchain = vulkan_manager.swapchain;
+        vulkan_manager.swapchain = swapchain;
+        vulkan_manager.swapchain_extent = swapchain_create_info.imageExtent;
+        vulkan_manager.present_mode = swapchain_create_info.presentMode;
+        vulkan_manager.swapchain_images = get_swapchain_images(vulkan_manager.device, swapchain);
     }
 
-    fseek(f, 0, SEEK_END);
-    const size_t nbytes_file_size = (size_t)ftell(f);
-    rewind(f);
+    vulkan_manager.swapchain_image_views = create_swapchain_image_views(vulkan_manager.device, vulkan_manager.swapchain_images, vulkan_manager.swapchain_format);
 
-    uint32_t *buffer = (uint32_t *)malloc(nbytes_file_size);
-    fread(buffer, nbytes_file_size, 1, f);
-    fclose(f);
+    return old_swapchain;
+}
 
-    const VkShaderModuleCreateInfo ci_shader_module{
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0x0,
-        .codeSize = nbytes_file_size,
-        .pCode = buffer,
-    };
+std::vector<VkPresentModeKHR> get_present_modes(const VulkanManager& vulkan_manager)
+{
+    if (vulkan_manager.headless)
+        return {VK_PRESENT_MODE_FIFO_KHR};
 
-    VkShaderModule vk_shader_module;
-    VkResult result = vkCreateShaderModule(device, &ci_shader_module, NULL, &vk_shader_module);
-    if (result != VK_SUCCESS)
+    uint32_t count = 0;
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan_manager.physical_device, vulkan_manager.surface, &count, nullptr));
+    std::vector<VkPresentModeKHR> present_modes(count);
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan_manager.physical_device, vulkan_manager.surface, &count, present_modes.data()));
+
+    return present_modes;
+}
+
+VkResult acquire_next_image(const VulkanManager& vulkan_manager, VkSemaphore semaphore, uint32_t* image_idx)
+{
+    if (vulkan_manager.headless)
     {
-        printf("Failed to create shader module for %s!\n", filename);
-        exit(EXIT_FAILURE);
+        // Round robin. As long as there are at least as many offscreen images as frames in flight,
+        // the frame fence that was waited on before acquiring also covers the last use of this image.
+        *image_idx = (*image_idx + 1) % static_cast<uint32_t>(vulkan_manager.swapchain_images.size());
+        return VK_SUCCESS;
     }
 
-    free(buffer);
+    return vkAcquireNextImageKHR(vulkan_manager.device, vulkan_manager.swapchain, UINT64_MAX, semaphore, VK_NULL_HANDLE, image_idx);
+}
 
-    return vk_shader_module;
+VkResult present_image(const VulkanManager& vulkan_manager, VkQueue queue, VkSemaphore wait_semaphore, uint32_t image_idx)
+{
+    if (vulkan_manager.headless)
+        return VK_SUCCESS;
+
+    const VkPresentInfoKHR present_info{
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &wait_semaphore,
+        .swapchainCount = 1,
+        .pSwapchains = &vulkan_manager.swapchain,
+        .pImageIndices = &image_idx,
+        .pResults = nullptr,
+    };
+
+    return vkQueuePresentKHR(queue, &present_info);
+}
+
+std::string get_executable_dir()
+{
+    char path[4096];
+    const ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length <= 0)
+        EXIT("Failed to resolve the executable path");
+
+    path[length] = '\0';
+
+    std::string dir(path);
+    return dir.substr(0, dir.find_last_of('/'));
 }
 
 /**
@@ -519,12 +946,12 @@ VkCommandPool create_command_pool(VkDevice device, uint32_t q_family_idx)
 }
 
 
-VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool pool)
+VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool pool, VkCommandBufferLevel level)
 {
     const VkCommandBufferAllocateInfo commandBufferAllocateInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .commandPool = pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .level = level,
         .commandBufferCount = 1,
     };
 
@@ -570,62 +997,130 @@ VkBuffer create_buffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags us
     return buffer;
 }
 
-VkDeviceMemory allocate_buffer_memory(VkDevice device, VkBuffer buffer, VkMemoryPropertyFlags memory_property_flags, const VkPhysicalDeviceMemoryProperties &physical_device_memory_properties)
+VkImage create_image(VkDevice device, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage)
+{
+    const VkImageCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {extent.width, extent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    VkImage image;
+    VK_CHECK(vkCreateImage(device, &create_info, nullptr, &image));
+    return image;
+}
+
+VkDeviceMemory allocate_image_memory(VkDevice device, VkImage image, VkMemoryPropertyFlags memory_property_flags, const VkPhysicalDeviceMemoryProperties &physical_device_memory_properties)
 {
     VkMemoryRequirements memReqs;
-    vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+    vkGetImageMemoryRequirements(device, image, &memReqs);
 
     const VkMemoryAllocateInfo allocInfo{
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
         .allocationSize = memReqs.size,
-        .memoryTypeIndex = get_heap_idx(memReqs.memoryTypeBits, memory_property_flags, physical_device_memory_properties)};
+        .memoryTypeIndex = find_memory_type(physical_device_memory_properties, memReqs.memoryTypeBits, memory_property_flags, 0x0)};
 
     VkDeviceMemory memory;
     VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &memory));
     return memory;
 }
 
-void upload_data(VkDevice device, VkCommandPool command_pool, VkQueue queue, VkCommandBuffer command_buffer, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceMemory src_memory, VkDeviceMemory dst_memory, VkDeviceSize size, void* data)
+VkPipelineCache create_pipeline_cache(VkDevice device, const VkPhysicalDeviceProperties& physical_device_properties, const char* path, bool* loaded)
 {
-    void *staging_data;
-    vkMapMemory(device, src_memory, 0, VK_WHOLE_SIZE, 0, &staging_data);
-    memcpy(staging_data, data, size);
+    std::vector<char> data;
 
-    VkMappedMemoryRange range{
-        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-        .memory = src_memory,
-        .offset = 0,
-        .size = VK_WHOLE_SIZE,
-    };
+    if (FILE* f = fopen(path, "rb"))
+    {
+        // An unreadable file is a cold cache like a missing one
+        fseek(f, 0, SEEK_END);
+        const long size = ftell(f);
+        rewind(f);
 
-    vkFlushMappedMemoryRanges(device, 1, &range);
-    vkUnmapMemory(device, src_memory);
+        if (size > 0)
+        {
+            data.resize(static_cast<size_t>(size));
+            if (fread(data.data(), 1, data.size(), f) != data.size())
+                data.clear();
+        }
 
-    static const VkCommandBufferBeginInfo command_buffer_begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-    };
+        fclose(f);
+    }
 
-    vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+    // Drivers are supposed to reject foreign data themselves, but not all of them do. A cache written by
+    // another device or driver version is useless anyway, so it is dropped and rebuilt.
+    if (!data.empty())
+    {
+        VkPipelineCacheHeaderVersionOne header;
+        bool valid = data.size() >= sizeof(header);
 
-    const VkBufferCopy buffer_copy {
-        .srcOffset = 0,
-        .dstOffset = 0,
-        .size = size
-    };
+        if (valid)
+        {
+            memcpy(&header, data.data(), sizeof(header));
+            valid = header.headerSize >= sizeof(header) &&
+                    header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                    header.vendorID == physical_device_properties.vendorID &&
+                    header.deviceID == physical_device_properties.deviceID &&
+                    memcmp(header.pipelineCacheUUID, physical_device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
 
-    vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1u, &buffer_copy);
+        if (!valid)
+        {
+            LOG("Pipeline cache %s does not match the device, starting with an empty cache\n", path);
+            data.clear();
+        }
+    }
 
-    vkEndCommandBuffer(command_buffer);
+    const VkPipelineCacheCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .initialDataSize = data.size(),
+        .pInitialData = data.empty() ? nullptr : data.data()};
 
-    const VkSubmitInfo submit_info {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1u,
-        .pCommandBuffers = &command_buffer
-    };
+    VkPipelineCache pipeline_cache;
+    VK_CHECK(vkCreatePipelineCache(device, &create_info, nullptr, &pipeline_cache));
 
-    VK_CHECK(vkQueueSubmit(queue, 1u, &submit_info, VK_NULL_HANDLE));
+    if (loaded != nullptr)
+        *loaded = !data.empty();
 
-    vkQueueWaitIdle(queue);
-    vkResetCommandPool(device, command_pool,  0x0);
-}
\ No newline at end of file
+    return pipeline_cache;
+}
+
+void save_pipeline_cache(VkDevice device, VkPipelineCache pipeline_cache, const char* path)
+{
+    size_t size = 0u;
+    VK_CHECK(vkGetPipelineCacheData(device, pipeline_cache, &size, nullptr));
+
+    std::vector<char> data(size);
+    VK_CHECK(vkGetPipelineCacheData(device, pipeline_cache, &size, data.data()));
+
+    // Written next to the real file first, so a crash while writing never leaves a truncated cache behind
+    const std::string tmp_path = std::string(path) + ".tmp";
+
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr)
+    {
+        LOG("Failed to write pipeline cache %s\n", tmp_path.c_str());
+        return;
+    }
+
+    const bool written = fwrite(data.data(), 1, size, f) == size;
+    fclose(f);
+
+    if (!written || rename(tmp_path.c_str(), path) != 0)
+    {
+        LOG("Failed to write pipeline cache %s\n", path);
+        remove(tmp_path.c_str());
+        return;
+    }
+
+    LOG("Pipeline cache written to %s (%zu KB)\n", path, size / 1024u);
+}
@@ -1,13 +1,18 @@
 #ifndef HELPERS_HPP
 #define HELPERS_HPP
 
+#include <string>
 #include <vector>
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 
+#include "Allocator.hpp"
+
 struct VulkanManager
 {
+    bool headless;
+
     VkInstance instance;
     VkSurfaceKHR surface;
     VkPhysicalDevice physical_device;
@@ -17,21 +22,46 @@ struct VulkanManager
     std::vector<VkQueue> queues;
     VkFormat swapchain_format;
     VkExtent2D swapchain_extent;
+    VkPresentModeKHR present_mode;          // The one in use, FIFO if the requested one is not supported
+    uint32_t swapchain_min_image_count;
     std::vector<VkImage> swapchain_images;
     std::vector<VkImageView> swapchain_image_views;
+    // Only used in headless mode, where swapchain_images are device-local offscreen images
+    std::vector<VkDeviceMemory> swapchain_image_memory;
 
+    VkPhysicalDeviceProperties physical_device_properties;
     VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
+
+    // Extension entry points are not exported by the loader, they are fetched with vkGetDeviceProcAddr
+    // for the extensions in VulkanInitParams::device_extension_ids. Null if the extension is not enabled.
+    PFN_vkCmdWriteTimestamp2KHR vkCmdWriteTimestamp2KHR;
+    PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR;
+    PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR;
+    PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR;
 };
 
 enum
 {
-    DEVICE_EXT_SWAPCHAIN = 0,
-    DEVICE_EXT_SYNC_2    = 1,
-    DEVICE_EXT_COUNT     = 2
+    DEVICE_EXT_SWAPCHAIN           = 0,
+    DEVICE_EXT_SYNC_2              = 1,
+    DEVICE_EXT_TIMELINE_SEMAPHORE  = 2, // Core in 1.2, but the feature still has to be enabled
+    DEVICE_EXT_MULTI_DRAW_INDIRECT = 3, // Core features multiDrawIndirect and drawIndirectFirstInstance
+    DEVICE_EXT_DYNAMIC_RENDERING   = 4,
+    DEVICE_EXT_COUNT               = 5
 };
 
+// Environment variable read if VulkanInitParams::device_override is null
+constexpr const char* DEVICE_OVERRIDE_ENV = "VK_TEMPLATE_DEVICE";
+
+// Devices with fewer allowed allocations are rejected, the allocator needs one per block
+constexpr uint32_t DEVICE_MIN_MEMORY_ALLOCATION_COUNT = 1024u;
+
 struct VulkanInitParams
 {
+    // Skips surface, swapchain and present. Frames are rendered into swapchain_image_count offscreen
+    // images instead, so no window (and no display) is needed.
+    bool headless;
+
     GLFWwindow* window;
     uint32_t window_width;
     uint32_t window_height;
@@ -39,9 +69,15 @@ struct VulkanInitParams
     std::vector<const char *> instance_extensions;
     std::vector<const char *> instance_layers;
     std::vector<uint32_t> device_extension_ids;
+    // Enabled if the selected device supports them, check the entry points in VulkanManager
+    std::vector<uint32_t> optional_device_extension_ids;
 
     std::vector<VkQueueFlagBits> queue_flags;
 
+    // Index or part of the name of the physical device to use instead of the highest scoring one that
+    // supports everything above. Null to use DEVICE_OVERRIDE_ENV, if set.
+    const char* device_override;
+
     uint32_t swapchain_image_count;
     VkFormat swapchain_format;
     VkPresentModeKHR swapchain_present_mode;
@@ -51,11 +87,40 @@ VulkanManager vulkan_init(const VulkanInitParams& params);
 
 void vulkan_release(VulkanManager& vulkan_manager);
 
-VkShaderModule create_shader_module(VkDevice device, const char *filename);
+// What vulkan_recreate_swapchain replaced, frames in flight may still use it
+struct OldSwapchain
+{
+    VkSwapchainKHR swapchain;               // VK_NULL_HANDLE in headless mode
+    std::vector<VkImageView> image_views;
+    // Only set in headless mode, swapchain images are released with their swapchain
+    std::vector<VkImage> images;
+    std::vector<VkDeviceMemory> image_memory;
+};
+
+// Creates a new swapchain from the current one (passed as oldSwapchain) and replaces the images and views.
+// Used for resizes and present mode changes. Nothing is destroyed, the caller destroys the returned handles
+// once no frame uses them anymore. In headless mode the offscreen images are recreated at the new extent and
+// present_mode is ignored.
+OldSwapchain vulkan_recreate_swapchain(VulkanManager& vulkan_manager, VkExtent2D extent, VkPresentModeKHR present_mode);
+
+// Present modes the surface supports, FIFO only in headless mode
+std::vector<VkPresentModeKHR> get_present_modes(const VulkanManager& vulkan_manager);
+
+// Returns the image to render into next. In headless mode there is no presentation engine, so the
+// offscreen image after *image_idx is returned and semaphore is left untouched. Semaphore is not signaled
+// if VK_ERROR_OUT_OF_DATE_KHR is returned.
+VkResult acquire_next_image(const VulkanManager& vulkan_manager, VkSemaphore semaphore, uint32_t* image_idx);
+
+// No-op in headless mode. VK_ERROR_OUT_OF_DATE_KHR and VK_SUBOPTIMAL_KHR are returned to the caller, who
+// recreates the swapchain.
+VkResult present_image(const VulkanManager& vulkan_manager, VkQueue queue, VkSemaphore wait_semaphore, uint32_t image_idx);
+
+// Directory containing the running binary, data files like the shader archive are installed next to it
+std::string get_executable_dir();
 
 VkCommandPool create_command_pool(VkDevice device, uint32_t q_family_idx);
 
-VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool pool);
+VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool pool, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 VkFence create_fence(VkDevice device, bool signaled);
 
@@ -63,8 +128,14 @@ VkSemaphore create_semaphore(VkDevice device);
 
 VkBuffer create_buffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage);
 
-VkDeviceMemory allocate_buffer_memory(VkDevice device, VkBuffer buffer, VkMemoryPropertyFlags memory_property_flags, const VkPhysicalDeviceMemoryProperties &physical_device_memory_properties);
+VkImage create_image(VkDevice device, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage);
+
+VkDeviceMemory allocate_image_memory(VkDevice device, VkImage image, VkMemoryPropertyFlags memory_property_flags, const VkPhysicalDeviceMemoryProperties &physical_device_memory_properties);
+
+// Seeds the cache with the contents of path if the file exists and its header matches the vendorID, deviceID
+// and pipelineCacheUUID of the device. *loaded (optional) is set to whether that was the case.
+VkPipelineCache create_pipeline_cache(VkDevice device, const VkPhysicalDeviceProperties& physical_device_properties, const char* path, bool* loaded);
 
-void upload_data(VkDevice device, VkCommandPool command_pool, VkQueue queue, VkCommandBuffer command_buffer, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceMemory src_memory, VkDeviceMemory dst_memory, VkDeviceSize size, void* data);
+void save_pipeline_cache(VkDevice device, VkPipelineCache pipeline_cache, const char* path);
 
 #endif // HELPERS_HPP
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "MeshFile.hpp"
+#include "Defines.hpp"
+#include "StreamCodec.hpp"
+
+MeshFile create_mesh_file(const char* path)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        EXIT("Failed to open mesh file " << path);
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(MeshFileHeader))
+        EXIT("Invalid mesh file " << path);
+
+    const size_t size = static_cast<size_t>(file_stat.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        EXIT("Failed to map mesh file " << path);
+
+    // Everything is read once right away by the decoders, start paging it in now
+    madvise(data, size, MADV_WILLNEED);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(bytes);
+
+    if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION)
+        EXIT("Mesh file " << path << " has an unsupported format");
+
+    const size_t tables_size = sizeof(MeshFileHeader) + header->mesh_count * sizeof(MeshFileMesh) +
+                               header->submesh_count * (sizeof(MeshFileSubmesh) + sizeof(MeshFileBounds));
+
+    // Sections are in file order, each one has to end before the next one starts. Sizes are compared with
+    // what is left of the file after the offset, so crafted values can not wrap around.
+    bool valid = tables_size <= size && header->vertex_offset >= tables_size && header->vertex_offset <= size &&
+                 header->vertex_size <= size - header->vertex_offset;
+    uint64_t section_end = header->vertex_offset + header->vertex_size;
+
+    for (uint32_t i = 0; i < MESH_FILE_INDEX_TYPE_COUNT; ++i)
+    {
+        const uint64_t offset = header->index_offsets[i];
+        valid = valid && offset >= section_end && offset <= size && header->index_sizes[i] <= size - offset;
+        section_end = offset + header->index_sizes[i];
+    }
+
+    if (!valid)
+        EXIT("Mesh file " << path << " is truncated");
+
+    if (header->submesh_count == 0u)
+        EXIT("Mesh file " << path << " has no submeshes");
+
+    const uint8_t* tables = bytes + sizeof(MeshFileHeader);
+    const MeshFileMesh* meshes = reinterpret_cast<const MeshFileMesh*>(tables);
+    const MeshFileSubmesh* submeshes = reinterpret_cast<const MeshFileSubmesh*>(meshes + header->mesh_count);
+    const MeshFileBounds* bounds = reinterpret_cast<const MeshFileBounds*>(submeshes + header->submesh_count);
+
+    // Submeshes are drawn straight from the decoded sections, a range outside them reads past the buffers
+    for (uint32_t i = 0; i < header->submesh_count; ++i)
+    {
+        const MeshFileSubmesh& submesh = submeshes[i];
+
+        // Selects one of the index sections and its count
+        if (submesh.index_type >= MESH_FILE_INDEX_TYPE_COUNT)
+            EXIT("Mesh file " << path << " has an invalid index type in submesh " << i);
+
+        const bool vertices_valid = submesh.vertex_offset >= 0 &&
+                                    static_cast<uint64_t>(submesh.vertex_offset) + submesh.vertex_count <= header->vertex_count;
+        const bool indices_valid = static_cast<uint64_t>(submesh.first_index) + submesh.index_count <= header->index_counts[submesh.index_type];
+
+        if (!vertices_valid || !indices_valid)
+            EXIT("Mesh file " << path << " has an out of range submesh " << i);
+    }
+
+    // Meshes are drawn as their submeshes
+    for (uint32_t i = 0; i < header->mesh_count; ++i)
+    {
+        if (static_cast<uint64_t>(meshes[i].first_submesh) + meshes[i].submesh_count > header->submesh_count)
+            EXIT("Mesh file " << path << " has an out of range mesh " << i);
+    }
+
+    LOG("Mesh File: %s (%u meshes, %u submeshes, %u vertices, %u 16 bit + %u 32 bit indices)\n", path, header->mesh_count, header->submesh_count,
+        header->vertex_count, header->index_counts[MESH_FILE_INDEX_TYPE_UINT16], header->index_counts[MESH_FILE_INDEX_TYPE_UINT32]);
+
+    return MeshFile{
+        .data = bytes,
+        .size = size,
+        .header = header,
+        .meshes = meshes,
+        .submeshes = submeshes,
+        .bounds = bounds};
+}
+
+void mesh_file_release(MeshFile& mesh_file)
+{
+    munmap(const_cast<uint8_t*>(mesh_file.data), mesh_file.size);
+    mesh_file.data = nullptr;
+}
+
+void mesh_file_decode_vertices(const MeshFile& mesh_file, MeshFileQuantizedVertex* vertices)
+{
+    const uint32_t vertex_count = mesh_file.header->vertex_count;
+    const uint8_t* src = mesh_file.data + mesh_file.header->vertex_offset;
+    size_t src_size = mesh_file.header->vertex_size;
+
+    // One stream per component, the values are sign extended
+    std::vector<uint32_t> values(vertex_count);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        const size_t read = stream_codec_decode(src, src_size, vertex_count, values.data());
+        if (read == 0u && vertex_count > 0u)
+            EXIT("Mesh file vertex section is corrupt");
+
+        for (uint32_t i = 0; i < vertex_count; ++i)
+            vertices[i].position[c] = static_cast<int16_t>(values[i]);
+
+        src += read;
+        src_size -= read;
+    }
+}
+
+void mesh_file_decode_indices(const MeshFile& mesh_file, uint32_t index_type, void* indices)
+{
+    const uint32_t index_count = mesh_file.header->index_counts[index_type];
+    const uint8_t* src = mesh_file.data + mesh_file.header->index_offsets[index_type];
+    const size_t src_size = mesh_file.header->index_sizes[index_type];
+
+    if (index_type == MESH_FILE_INDEX_TYPE_UINT32)
+    {
+        if (stream_codec_decode(src, src_size, index_count, static_cast<uint32_t*>(indices)) == 0u && index_count > 0u)
+            EXIT("Mesh file index section is corrupt");
+        return;
+    }
+
+    std::vector<uint32_t> values(index_count);
+    if (stream_codec_decode(src, src_size, index_count, values.data()) == 0u && index_count > 0u)
+        EXIT("Mesh file index section is corrupt");
+
+    uint16_t* indices_16 = static_cast<uint16_t*>(indices);
+    for (uint32_t i = 0; i < index_count; ++i)
+        indices_16[i] = static_cast<uint16_t>(values[i]);
+}
@@ -0,0 +1,167 @@
+#ifndef MESH_FILE_HPP
+#define MESH_FILE_HPP
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// .mesh layout, written offline by tools/mesh_import:
+//
+//   MeshFileHeader
+//   MeshFileMesh[mesh_count]
+//   MeshFileSubmesh[submesh_count]
+//   MeshFileBounds[submesh_count]       bounds[i] belongs to submeshes[i]
+//   vertex section                      x, y and z of MeshFileQuantizedVertex[vertex_count] as three streams
+//   16 bit index section                stream of index_counts[0] indices
+//   32 bit index section                stream of index_counts[1] indices
+//
+// Every section is aligned to MESH_FILE_SECTION_ALIGNMENT and compressed with StreamCodec.hpp, the streams
+// are decoded by mesh_file_decode_vertices / mesh_file_decode_indices. Submesh indices are relative to the
+// submesh's vertex_offset, submeshes with fewer than 65536 vertices use 16 bit indices. Triangles and vertices
+// are already reordered for the post-transform cache, overdraw and vertex fetch by tools/mesh_import.
+constexpr uint32_t MESH_FILE_MAGIC = 0x4853454du; // "MESH"
+constexpr uint32_t MESH_FILE_VERSION = 3u;
+constexpr uint32_t MESH_FILE_SECTION_ALIGNMENT = 4096u;
+constexpr uint32_t MESH_FILE_MAX_NAME = 64u;
+
+// Meshes span [-0.5, 0.5]^3 (see tools/mesh_import), positions are stored as snorm16 of position / scale
+constexpr float MESH_FILE_POSITION_SCALE = 0.5f;
+
+enum
+{
+    MESH_FILE_INDEX_TYPE_UINT16 = 0,
+    MESH_FILE_INDEX_TYPE_UINT32 = 1,
+    MESH_FILE_INDEX_TYPE_COUNT
+};
+
+constexpr uint32_t MESH_FILE_INDEX_SIZE[MESH_FILE_INDEX_TYPE_COUNT] = {sizeof(uint16_t), sizeof(uint32_t)};
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+
+    uint32_t mesh_count;
+    uint32_t submesh_count;
+    uint32_t vertex_count;
+    uint32_t index_counts[MESH_FILE_INDEX_TYPE_COUNT];
+
+    // From the start of the file, sizes are the compressed ones
+    uint64_t vertex_offset;
+    uint64_t vertex_size;
+    uint64_t index_offsets[MESH_FILE_INDEX_TYPE_COUNT];
+    uint64_t index_sizes[MESH_FILE_INDEX_TYPE_COUNT];
+};
+
+struct MeshFileMesh
+{
+    char name[MESH_FILE_MAX_NAME];
+    uint32_t first_submesh;
+    uint32_t submesh_count;
+};
+
+struct MeshFileSubmesh
+{
+    int32_t vertex_offset;
+    uint32_t vertex_count;
+    uint32_t index_type;                // MESH_FILE_INDEX_TYPE_*
+    uint32_t first_index;               // Into the index section of index_type
+    uint32_t index_count;
+};
+
+struct MeshFileBounds
+{
+    float min[3];
+    float max[3];
+    float center[3];                    // Of the bounding sphere
+    float radius;
+};
+
+struct MeshFileVertex
+{
+    float position[3];
+};
+
+struct MeshFileQuantizedVertex
+{
+    int16_t position[3];
+};
+
+// The file stays mapped until mesh_file_release, all pointers point into the mapping
+struct MeshFile
+{
+    const uint8_t* data;
+    size_t size;
+
+    const MeshFileHeader* header;
+    const MeshFileMesh* meshes;
+    const MeshFileSubmesh* submeshes;
+    const MeshFileBounds* bounds;
+};
+
+inline int16_t mesh_file_quantize(float value)
+{
+    return static_cast<int16_t>(lrintf(std::clamp(value / MESH_FILE_POSITION_SCALE, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline float mesh_file_dequantize(int16_t value)
+{
+    return std::max(value / 32767.0f, -1.0f) * MESH_FILE_POSITION_SCALE;
+}
+
+inline MeshFileQuantizedVertex mesh_file_quantize_vertex(const MeshFileVertex& vertex)
+{
+    return MeshFileQuantizedVertex{.position = {mesh_file_quantize(vertex.position[0]), mesh_file_quantize(vertex.position[1]), mesh_file_quantize(vertex.position[2])}};
+}
+
+inline uint64_t mesh_file_align(uint64_t offset)
+{
+    return (offset + MESH_FILE_SECTION_ALIGNMENT - 1u) & ~static_cast<uint64_t>(MESH_FILE_SECTION_ALIGNMENT - 1u);
+}
+
+// Bounding box and a bounding sphere around the box center
+inline MeshFileBounds mesh_file_compute_bounds(const MeshFileVertex* vertices, uint32_t vertex_count)
+{
+    MeshFileBounds bounds{
+        .min = {FLT_MAX, FLT_MAX, FLT_MAX},
+        .max = {-FLT_MAX, -FLT_MAX, -FLT_MAX},
+        .center = {0.0f, 0.0f, 0.0f},
+        .radius = 0.0f};
+
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            bounds.min[c] = std::min(bounds.min[c], vertices[i].position[c]);
+            bounds.max[c] = std::max(bounds.max[c], vertices[i].position[c]);
+        }
+    }
+
+    for (uint32_t c = 0; c < 3; ++c)
+        bounds.center[c] = (bounds.min[c] + bounds.max[c]) * 0.5f;
+
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        const float dx = vertices[i].position[0] - bounds.center[0];
+        const float dy = vertices[i].position[1] - bounds.center[1];
+        const float dz = vertices[i].position[2] - bounds.center[2];
+        bounds.radius = std::max(bounds.radius, sqrtf(dx * dx + dy * dy + dz * dz));
+    }
+
+    return bounds;
+}
+
+// Exits if the file can not be mapped or is not a valid .mesh file
+MeshFile create_mesh_file(const char* path);
+
+void mesh_file_release(MeshFile& mesh_file);
+
+// Decode the compressed sections, exit if a section is corrupt. vertices has room for header->vertex_count
+// vertices, indices for header->index_counts[index_type] indices of index_type.
+void mesh_file_decode_vertices(const MeshFile& mesh_file, MeshFileQuantizedVertex* vertices);
+
+void mesh_file_decode_indices(const MeshFile& mesh_file, uint32_t index_type, void* indices);
+
+#endif // MESH_FILE_HPP
@@ -0,0 +1,242 @@
+#include "PipelineBuilder.hpp"
+#include "Defines.hpp"
+
+static VkPipeline build_graphics_pipeline(VkDevice device, VkPipelineCache pipeline_cache, const ShaderArchive& shader_archive, const GraphicsPipelineDesc& desc)
+{
+    // Modules are owned by the archive and shared between pipelines
+    const ShaderStage vertex_stage = shader_archive_get(shader_archive, desc.vertex_shader.c_str());
+    const ShaderStage fragment_stage = shader_archive_get(shader_archive, desc.fragment_shader.c_str());
+
+    const VkPipelineShaderStageCreateInfo shader_stage_create_info[2]{
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = vertex_stage.stage,
+            .module = vertex_stage.module,
+            .pName = vertex_stage.entry_point,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = fragment_stage.stage,
+            .module = fragment_stage.module,
+            .pName = fragment_stage.entry_point,
+        }};
+
+    const VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertex_bindings.size()),
+        .pVertexBindingDescriptions = desc.vertex_bindings.data(),
+        .vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertex_attributes.size()),
+        .pVertexAttributeDescriptions = desc.vertex_attributes.data()};
+
+    // Set with vkCmdSetViewport / vkCmdSetScissor, so pipelines survive swapchain resizes
+    const VkPipelineViewportStateCreateInfo viewport_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .pViewports = nullptr,
+        .scissorCount = 1,
+        .pScissors = nullptr,
+    };
+
+    const VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    const VkPipelineDynamicStateCreateInfo dynamic_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamic_states,
+    };
+
+    const VkPipelineColorBlendAttachmentState blend_attachment_state{
+        .blendEnable = desc.blend_enable ? VK_TRUE : VK_FALSE,
+        .srcColorBlendFactor = desc.blend_enable ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ZERO,
+        .dstColorBlendFactor = desc.blend_enable ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = desc.blend_enable ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+
+    const VkPipelineColorBlendStateCreateInfo color_blend_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .logicOp = VK_LOGIC_OP_COPY,
+        .attachmentCount = 1,
+        .pAttachments = &blend_attachment_state,
+        .blendConstants = {0, 0, 0, 0}};
+
+    const VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = desc.topology,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    const VkPipelineRasterizationStateCreateInfo rasterization_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = desc.polygon_mode,
+        .cullMode = desc.cull_mode,
+        .frontFace = desc.front_face,
+        .depthBiasEnable = VK_FALSE,
+        .depthBiasConstantFactor = 0.0f,
+        .depthBiasClamp = 0.0f,
+        .depthBiasSlopeFactor = 0.0f,
+        .lineWidth = 1.0f,
+    };
+
+    const VkPipelineMultisampleStateCreateInfo multisample_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = desc.samples,
+        .sampleShadingEnable = VK_FALSE,
+        .minSampleShading = 0.0f,
+        .pSampleMask = nullptr,
+        .alphaToCoverageEnable = VK_FALSE,
+        .alphaToOneEnable = VK_FALSE,
+    };
+
+    const VkPipelineDepthStencilStateCreateInfo depth_stencil_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = desc.depth_test ? VK_TRUE : VK_FALSE,
+        .depthWriteEnable = desc.depth_test ? VK_TRUE : VK_FALSE,
+        .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+        .front = {},
+        .back = {},
+        .minDepthBounds = 0.0f,
+        .maxDepthBounds = 1.0f,
+    };
+
+    // Without a render pass the pipeline is compatible with any dynamic rendering using these formats
+    const VkPipelineRenderingCreateInfoKHR rendering_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .pNext = nullptr,
+        .viewMask = 0u,
+        .colorAttachmentCount = 1u,
+        .pColorAttachmentFormats = &desc.color_format,
+        .depthAttachmentFormat = desc.depth_format,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED};
+
+    const VkGraphicsPipelineCreateInfo pipeline_create_info{
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = (desc.renderpass == VK_NULL_HANDLE) ? &rendering_create_info : nullptr,
+        .stageCount = 2u,
+        .pStages = shader_stage_create_info,
+        .pVertexInputState = &vertex_input_state_create_info,
+        .pInputAssemblyState = &input_assembly_state_create_info,
+        .pViewportState = &viewport_state_create_info,
+        .pRasterizationState = &rasterization_state_create_info,
+        .pMultisampleState = &multisample_state_create_info,
+        .pDepthStencilState = &depth_stencil_state_create_info,
+        .pColorBlendState = &color_blend_state_create_info,
+        .pDynamicState = &dynamic_state_create_info,
+        .layout = desc.layout,
+        .renderPass = desc.renderpass,
+        .subpass = desc.subpass,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
+    };
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline));
+
+    return pipeline;
+}
+
+static VkPipeline build_compute_pipeline(VkDevice device, VkPipelineCache pipeline_cache, const ShaderArchive& shader_archive, const ComputePipelineDesc& desc)
+{
+    const ShaderStage compute_stage = shader_archive_get(shader_archive, desc.compute_shader.c_str());
+
+    const VkComputePipelineCreateInfo pipeline_create_info{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = compute_stage.stage,
+            .module = compute_stage.module,
+            .pName = compute_stage.entry_point,
+        },
+        .layout = desc.layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
+    };
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline));
+
+    return pipeline;
+}
+
+PipelineBuilder create_pipeline_builder(VkDevice device, ThreadPool& thread_pool, const ShaderArchive& shader_archive, VkPipelineCache pipeline_cache)
+{
+    size_t size = 0u;
+    VK_CHECK(vkGetPipelineCacheData(device, pipeline_cache, &size, nullptr));
+
+    std::vector<char> data(size);
+    VK_CHECK(vkGetPipelineCacheData(device, pipeline_cache, &size, data.data()));
+
+    // Each cache is only ever touched by its own worker
+    const VkPipelineCacheCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .initialDataSize = size,
+        .pInitialData = data.data()};
+
+    std::vector<VkPipelineCache> worker_pipeline_caches(thread_pool_size(thread_pool));
+    for (VkPipelineCache& worker_pipeline_cache : worker_pipeline_caches)
+        VK_CHECK(vkCreatePipelineCache(device, &create_info, nullptr, &worker_pipeline_cache));
+
+    return PipelineBuilder{
+        .device = device,
+        .thread_pool = &thread_pool,
+        .shader_archive = &shader_archive,
+        .pipeline_cache = pipeline_cache,
+        .worker_pipeline_caches = worker_pipeline_caches,
+        .pending = {}};
+}
+
+std::shared_future<VkPipeline> pipeline_builder_enqueue(PipelineBuilder& builder, const GraphicsPipelineDesc& desc)
+{
+    const VkDevice device = builder.device;
+    const ShaderArchive* shader_archive = builder.shader_archive;
+    const VkPipelineCache* worker_pipeline_caches = builder.worker_pipeline_caches.data();
+
+    std::shared_future<VkPipeline> pipeline = thread_pool_submit(*builder.thread_pool, [=](uint32_t worker_idx) {
+        return build_graphics_pipeline(device, worker_pipeline_caches[worker_idx], *shader_archive, desc);
+    }).share();
+
+    builder.pending.push_back(pipeline);
+    return pipeline;
+}
+
+std::shared_future<VkPipeline> pipeline_builder_enqueue(PipelineBuilder& builder, const ComputePipelineDesc& desc)
+{
+    const VkDevice device = builder.device;
+    const ShaderArchive* shader_archive = builder.shader_archive;
+    const VkPipelineCache* worker_pipeline_caches = builder.worker_pipeline_caches.data();
+
+    std::shared_future<VkPipeline> pipeline = thread_pool_submit(*builder.thread_pool, [=](uint32_t worker_idx) {
+        return build_compute_pipeline(device, worker_pipeline_caches[worker_idx], *shader_archive, desc);
+    }).share();
+
+    builder.pending.push_back(pipeline);
+    return pipeline;
+}
+
+void pipeline_builder_finish(PipelineBuilder& builder)
+{
+    for (const std::shared_future<VkPipeline>& pipeline : builder.pending)
+        pipeline.wait();
+
+    VK_CHECK(vkMergePipelineCaches(builder.device, builder.pipeline_cache, static_cast<uint32_t>(builder.worker_pipeline_caches.size()), builder.worker_pipeline_caches.data()));
+
+    for (VkPipelineCache worker_pipeline_cache : builder.worker_pipeline_caches)
+        vkDestroyPipelineCache(builder.device, worker_pipeline_cache, nullptr);
+
+    LOG("Pipelines Built: %zu on %u threads\n", builder.pending.size(), thread_pool_size(*builder.thread_pool));
+
+    builder.worker_pipeline_caches.clear();
+    builder.pending.clear();
+}
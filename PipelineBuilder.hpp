@@ -0,0 +1,72 @@
+#ifndef PIPELINE_BUILDER_HPP
+#define PIPELINE_BUILDER_HPP
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ShaderArchive.hpp"
+#include "ThreadPool.hpp"
+
+// Everything that differs between our graphics pipelines. Descriptions are copied into the build task, so
+// they do not have to outlive pipeline_builder_enqueue.
+struct GraphicsPipelineDesc
+{
+    std::string vertex_shader;      // Shader archive names, e.g. "default.vert"
+    std::string fragment_shader;
+
+    std::vector<VkVertexInputBindingDescription> vertex_bindings;
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cull_mode = VK_CULL_MODE_NONE;
+    VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    bool blend_enable = false;
+    bool depth_test = false;        // Tests and writes depth with LESS_OR_EQUAL
+
+    VkPipelineLayout layout;
+    VkRenderPass renderpass;
+    uint32_t subpass = 0u;
+
+    // Attachment formats for dynamic rendering, only used if renderpass is null
+    VkFormat color_format = VK_FORMAT_UNDEFINED;
+    VkFormat depth_format = VK_FORMAT_UNDEFINED;
+};
+
+struct ComputePipelineDesc
+{
+    std::string compute_shader;     // Shader archive name, e.g. "cull.comp"
+
+    VkPipelineLayout layout;
+};
+
+// Pipelines are compiled on the thread pool. Every worker compiles into its own VkPipelineCache, seeded with
+// the contents of the destination cache, so the workers never contend on a cache lock. The worker caches
+// are merged back into the destination cache by pipeline_builder_finish.
+struct PipelineBuilder
+{
+    VkDevice device;
+    ThreadPool* thread_pool;
+    const ShaderArchive* shader_archive;
+
+    VkPipelineCache pipeline_cache;
+    std::vector<VkPipelineCache> worker_pipeline_caches;
+
+    std::vector<std::shared_future<VkPipeline>> pending;
+};
+
+PipelineBuilder create_pipeline_builder(VkDevice device, ThreadPool& thread_pool, const ShaderArchive& shader_archive, VkPipelineCache pipeline_cache);
+
+std::shared_future<VkPipeline> pipeline_builder_enqueue(PipelineBuilder& builder, const GraphicsPipelineDesc& desc);
+
+std::shared_future<VkPipeline> pipeline_builder_enqueue(PipelineBuilder& builder, const ComputePipelineDesc& desc);
+
+// Waits for all enqueued pipelines and merges the worker caches into the destination cache. The builder
+// can not be used afterwards.
+void pipeline_builder_finish(PipelineBuilder& builder);
+
+#endif // PIPELINE_BUILDER_HPP
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <float.h>
+
+#include <imgui/imgui.h>
+
+#include "Defines.hpp"
+#include "Profiler.hpp"
+
+namespace
+{
+    constexpr uint32_t QUERIES_PER_FRAME = PROFILER_MAX_SCOPES * 2u;
+    constexpr uint32_t SCOPE_DROPPED = UINT32_MAX;
+
+    uint32_t get_stats_idx(Profiler& profiler, const char* name)
+    {
+        for (uint32_t i = 0; i < profiler.stats.size(); ++i)
+        {
+            if (profiler.stats[i].name == name)
+                return i;
+        }
+
+        profiler.stats.push_back(ProfilerScopeStats{
+            .name = name,
+            .depth = profiler.depth,
+            .gpu_ms = {},
+            .cpu_ms = {},
+            .sample_count = 0u});
+
+        return static_cast<uint32_t>(profiler.stats.size() - 1);
+    }
+
+    float average(const float* samples, uint32_t sample_count)
+    {
+        const uint32_t count = std::min(sample_count, PROFILER_AVERAGE_FRAMES);
+        if (count == 0u)
+            return 0.0f;
+
+        float sum = 0.0f;
+        for (uint32_t i = 0; i < count; ++i)
+            sum += samples[i];
+
+        return sum / count;
+    }
+
+    // Reads back the queries written the last time frame_idx was recorded. The caller guarantees that the
+    // frame's fence has signaled, so the results are available and the call does not block.
+    void resolve_frame(Profiler& profiler, VkDevice device, uint32_t frame_idx)
+    {
+        ProfilerFrame& frame = profiler.frames[frame_idx];
+        if (frame.scopes.empty())
+            return;
+
+        const uint32_t query_count = static_cast<uint32_t>(frame.scopes.size()) * 2u;
+
+        // [timestamp, availability] per query
+        profiler.query_results.resize(query_count * 2u);
+
+        if (profiler.gpu_enabled)
+        {
+            const VkResult result = vkGetQueryPoolResults(device, profiler.query_pool, frame_idx * QUERIES_PER_FRAME, query_count,
+                                                          profiler.query_results.size() * sizeof(uint64_t), profiler.query_results.data(), 2u * sizeof(uint64_t),
+                                                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            assert(result == VK_SUCCESS || result == VK_NOT_READY);
+        }
+
+        for (uint32_t i = 0; i < frame.scopes.size(); ++i)
+        {
+            const ProfilerScopeRecord& record = frame.scopes[i];
+            ProfilerScopeStats& stats = profiler.stats[record.stats_idx];
+
+            float gpu_ms = 0.0f;
+            if (profiler.gpu_enabled)
+            {
+                const uint64_t* begin = &profiler.query_results[i * 4u];
+                const uint64_t* end = begin + 2u;
+
+                // Skip the sample rather than wait if a query somehow is not available yet
+                if (begin[1] == 0u || end[1] == 0u)
+                    continue;
+
+                const uint64_t ticks = (end[0] - begin[0]) & profiler.timestamp_mask;
+                gpu_ms = static_cast<float>(ticks * profiler.timestamp_period_ns * 1e-6);
+            }
+
+            const uint32_t sample_idx = stats.sample_count % PROFILER_AVERAGE_FRAMES;
+            stats.gpu_ms[sample_idx] = gpu_ms;
+            stats.cpu_ms[sample_idx] = record.cpu_ms;
+            ++stats.sample_count;
+
+            // Scope 0 is the whole frame
+            if (i == 0u)
+                profiler.gpu_frame_ms_history[profiler.history_offset] = gpu_ms;
+        }
+    }
+}
+
+Profiler create_profiler(const VulkanManager& vulkan_manager, uint32_t q_family_idx, uint32_t frame_count)
+{
+    uint32_t num_q_family_props = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkan_manager.physical_device, &num_q_family_props, nullptr);
+    std::vector<VkQueueFamilyProperties> q_family_props(num_q_family_props);
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkan_manager.physical_device, &num_q_family_props, q_family_props.data());
+
+    const uint32_t timestamp_valid_bits = q_family_props[q_family_idx].timestampValidBits;
+
+    Profiler profiler{
+        .query_pool = VK_NULL_HANDLE,
+        .gpu_enabled = timestamp_valid_bits != 0u && vulkan_manager.vkCmdWriteTimestamp2KHR != nullptr,
+        .timestamp_period_ns = vulkan_manager.physical_device_properties.limits.timestampPeriod,
+        .timestamp_mask = (timestamp_valid_bits >= 64u) ? UINT64_MAX : ((1ull << timestamp_valid_bits) - 1ull),
+        .vkCmdWriteTimestamp2KHR = vulkan_manager.vkCmdWriteTimestamp2KHR,
+        .frames = std::vector<ProfilerFrame>(frame_count),
+        .frame_idx = 0u,
+        .depth = 0u,
+        .stats = {},
+        .query_results = {},
+        .gpu_frame_ms_history = {},
+        .cpu_frame_ms_history = {},
+        .history_offset = 0u,
+        .last_frame_begin = std::chrono::steady_clock::now()};
+
+    for (ProfilerFrame& frame : profiler.frames)
+    {
+        frame.scopes.reserve(PROFILER_MAX_SCOPES);
+        frame.open_scopes.reserve(PROFILER_MAX_SCOPES);
+    }
+
+    profiler.stats.reserve(PROFILER_MAX_SCOPES);
+
+    if (profiler.gpu_enabled)
+    {
+        const VkQueryPoolCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = frame_count * QUERIES_PER_FRAME};
+
+        VK_CHECK(vkCreateQueryPool(vulkan_manager.device, &create_info, nullptr, &profiler.query_pool));
+    }
+    else
+    {
+        LOG("Profiler: GPU timestamps unavailable, only CPU scopes are recorded\n");
+    }
+
+    return profiler;
+}
+
+void profiler_release(Profiler& profiler, VkDevice device)
+{
+    if (profiler.query_pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device, profiler.query_pool, nullptr);
+
+    profiler.query_pool = VK_NULL_HANDLE;
+}
+
+void profiler_begin_frame(Profiler& profiler, VkDevice device, VkCommandBuffer cmd_buff, uint32_t frame_idx)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    profiler.history_offset = (profiler.history_offset + 1) % PROFILER_HISTORY_FRAMES;
+    profiler.cpu_frame_ms_history[profiler.history_offset] = std::chrono::duration<float, std::milli>(now - profiler.last_frame_begin).count();
+    profiler.gpu_frame_ms_history[profiler.history_offset] = 0.0f;
+    profiler.last_frame_begin = now;
+
+    resolve_frame(profiler, device, frame_idx);
+
+    profiler.frame_idx = frame_idx;
+    profiler.depth = 0u;
+
+    ProfilerFrame& frame = profiler.frames[frame_idx];
+    frame.scopes.clear();
+    frame.open_scopes.clear();
+
+    if (profiler.gpu_enabled)
+        vkCmdResetQueryPool(cmd_buff, profiler.query_pool, frame_idx * QUERIES_PER_FRAME, QUERIES_PER_FRAME);
+
+    profiler_begin_scope(profiler, cmd_buff, "Frame");
+}
+
+void profiler_end_frame(Profiler& profiler, VkCommandBuffer cmd_buff)
+{
+    profiler_end_scope(profiler, cmd_buff);
+    assert(profiler.frames[profiler.frame_idx].open_scopes.empty() && "Unbalanced profiler scopes");
+}
+
+void profiler_begin_scope(Profiler& profiler, VkCommandBuffer cmd_buff, const char* name)
+{
+    ProfilerFrame& frame = profiler.frames[profiler.frame_idx];
+
+    if (frame.scopes.size() >= PROFILER_MAX_SCOPES)
+    {
+        frame.open_scopes.push_back(SCOPE_DROPPED);
+        return;
+    }
+
+    const uint32_t scope_idx = static_cast<uint32_t>(frame.scopes.size());
+
+    frame.scopes.push_back(ProfilerScopeRecord{
+        .stats_idx = get_stats_idx(profiler, name),
+        .cpu_begin = std::chrono::steady_clock::now(),
+        .cpu_ms = 0.0f});
+    frame.open_scopes.push_back(scope_idx);
+    ++profiler.depth;
+
+    if (profiler.gpu_enabled)
+        profiler.vkCmdWriteTimestamp2KHR(cmd_buff, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT_KHR, profiler.query_pool, profiler.frame_idx * QUERIES_PER_FRAME + scope_idx * 2u);
+}
+
+void profiler_end_scope(Profiler& profiler, VkCommandBuffer cmd_buff)
+{
+    ProfilerFrame& frame = profiler.frames[profiler.frame_idx];
+    assert(!frame.open_scopes.empty() && "profiler_end_scope without matching profiler_begin_scope");
+
+    const uint32_t scope_idx = frame.open_scopes.back();
+    frame.open_scopes.pop_back();
+
+    if (scope_idx == SCOPE_DROPPED)
+        return;
+
+    --profiler.depth;
+
+    ProfilerScopeRecord& record = frame.scopes[scope_idx];
+    record.cpu_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - record.cpu_begin).count();
+
+    // ALL_COMMANDS so the timestamp is only written once all work recorded inside the scope has finished
+    if (profiler.gpu_enabled)
+        profiler.vkCmdWriteTimestamp2KHR(cmd_buff, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, profiler.query_pool, profiler.frame_idx * QUERIES_PER_FRAME + scope_idx * 2u + 1u);
+}
+
+void profiler_gui(const Profiler& profiler)
+{
+    if (!ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen))
+        return;
+
+    // History is a ring, history_offset is the most recent sample
+    const int plot_offset = static_cast<int>((profiler.history_offset + 1) % PROFILER_HISTORY_FRAMES);
+    const ImVec2 plot_size(0.0f, 60.0f);
+    char overlay[64];
+
+    snprintf(overlay, sizeof(overlay), "CPU frame %.2f ms", profiler.cpu_frame_ms_history[profiler.history_offset]);
+    ImGui::PlotLines("##cpu_frame", profiler.cpu_frame_ms_history, PROFILER_HISTORY_FRAMES, plot_offset, overlay, 0.0f, FLT_MAX, plot_size);
+
+    if (profiler.gpu_enabled)
+    {
+        // GPU samples lag the CPU ones by the number of frames in flight
+        snprintf(overlay, sizeof(overlay), "GPU frame %.2f ms", profiler.gpu_frame_ms_history[profiler.history_offset]);
+        ImGui::PlotLines("##gpu_frame", profiler.gpu_frame_ms_history, PROFILER_HISTORY_FRAMES, plot_offset, overlay, 0.0f, FLT_MAX, plot_size);
+    }
+    else
+    {
+        ImGui::TextUnformatted("GPU timestamps unavailable");
+    }
+
+    if (ImGui::BeginTable("##scopes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+    {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("GPU ms");
+        ImGui::TableSetupColumn("CPU ms");
+        ImGui::TableHeadersRow();
+
+        for (const ProfilerScopeStats& stats : profiler.stats)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", static_cast<int>(stats.depth * 2u), "", stats.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", average(stats.gpu_ms, stats.sample_count));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", average(stats.cpu_ms, stats.sample_count));
+        }
+
+        ImGui::EndTable();
+    }
+}
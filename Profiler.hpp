@@ -0,0 +1,99 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <chrono>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Helpers.hpp"
+
+constexpr uint32_t PROFILER_MAX_SCOPES = 32u;   // Per frame, including the implicit frame scope
+constexpr uint32_t PROFILER_AVERAGE_FRAMES = 64u;
+constexpr uint32_t PROFILER_HISTORY_FRAMES = 256u;
+
+// Rolling statistics of one named scope, identified by the name pointer passed to profiler_begin_scope
+struct ProfilerScopeStats
+{
+    const char* name;
+    uint32_t depth;
+
+    float gpu_ms[PROFILER_AVERAGE_FRAMES];
+    float cpu_ms[PROFILER_AVERAGE_FRAMES];
+    uint32_t sample_count;
+};
+
+// One scope recorded into a frame slot, resolved once the slot's fence has signaled
+struct ProfilerScopeRecord
+{
+    uint32_t stats_idx;
+    std::chrono::steady_clock::time_point cpu_begin;
+    float cpu_ms;
+};
+
+struct ProfilerFrame
+{
+    std::vector<ProfilerScopeRecord> scopes; // scopes[i] owns queries 2*i and 2*i+1 of the slot
+    std::vector<uint32_t> open_scopes;
+};
+
+// Timestamps are written into a query pool that holds one range of queries per frame in flight. A range
+// is only read back after the fence of the frame that wrote it has been waited on, so vkGetQueryPoolResults
+// is called without VK_QUERY_RESULT_WAIT_BIT and never adds a sync point.
+struct Profiler
+{
+    VkQueryPool query_pool;
+    bool gpu_enabled;           // False if the queue does not support timestamps or sync2 is not enabled
+    float timestamp_period_ns;
+    uint64_t timestamp_mask;
+
+    PFN_vkCmdWriteTimestamp2KHR vkCmdWriteTimestamp2KHR;
+
+    std::vector<ProfilerFrame> frames;
+    uint32_t frame_idx;
+    uint32_t depth;
+
+    std::vector<ProfilerScopeStats> stats;
+    std::vector<uint64_t> query_results; // Scratch space for vkGetQueryPoolResults
+
+    float gpu_frame_ms_history[PROFILER_HISTORY_FRAMES];
+    float cpu_frame_ms_history[PROFILER_HISTORY_FRAMES];
+    uint32_t history_offset;
+    std::chrono::steady_clock::time_point last_frame_begin;
+};
+
+Profiler create_profiler(const VulkanManager& vulkan_manager, uint32_t q_family_idx, uint32_t frame_count);
+
+void profiler_release(Profiler& profiler, VkDevice device);
+
+// Must be called outside of a render pass, after the fence of frame_idx has been waited on
+void profiler_begin_frame(Profiler& profiler, VkDevice device, VkCommandBuffer cmd_buff, uint32_t frame_idx);
+
+void profiler_end_frame(Profiler& profiler, VkCommandBuffer cmd_buff);
+
+// name must outlive the profiler, it is used as the scope's identity
+void profiler_begin_scope(Profiler& profiler, VkCommandBuffer cmd_buff, const char* name);
+
+void profiler_end_scope(Profiler& profiler, VkCommandBuffer cmd_buff);
+
+// Draws the scope table and frame time graph into the current ImGui window
+void profiler_gui(const Profiler& profiler);
+
+struct ProfilerScope
+{
+    ProfilerScope(Profiler& profiler, VkCommandBuffer cmd_buff, const char* name)
+        : profiler(profiler), cmd_buff(cmd_buff)
+    {
+        profiler_begin_scope(profiler, cmd_buff, name);
+    }
+
+    ~ProfilerScope()
+    {
+        profiler_end_scope(profiler, cmd_buff);
+    }
+
+    Profiler& profiler;
+    VkCommandBuffer cmd_buff;
+};
+
+#endif // PROFILER_HPP
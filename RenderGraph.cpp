@@ -0,0 +1,804 @@
+#include <algorithm>
+#include <cassert>
+#include <stdio.h>
+
+#include <imgui/imgui.h>
+
+#include "RenderGraph.hpp"
+#include "Defines.hpp"
+
+constexpr VkAccessFlags2KHR WRITE_ACCESS_MASK = VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR |
+                                                VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR |
+                                                VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR | VK_ACCESS_2_HOST_WRITE_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+
+// Synchronization state of a resource while the passes are walked in order
+struct ResourceTrack
+{
+    VkPipelineStageFlags2KHR write_stage;   // Of the last write, 0 if there was none
+    VkAccessFlags2KHR write_access;
+    VkPipelineStageFlags2KHR read_stage;    // Stages that have read the resource since the last write
+    VkAccessFlags2KHR read_access;          // Accesses the last write has been made visible to
+    VkImageLayout layout;
+
+    // -1 before the first pass, which is where uses by the previous execution count as well
+    int32_t last_write_pass;
+    int32_t last_use_pass;
+};
+
+static RenderGraphResource add_resource(RenderGraph& graph, const RenderGraphResourceInfo& info)
+{
+    assert(!graph.compiled);
+    graph.resources.push_back(info);
+    return static_cast<RenderGraphResource>(graph.resources.size() - 1u);
+}
+
+static void add_use(RenderGraph& graph, uint32_t pass_idx, RenderGraphResource resource, const RenderGraphState& state, bool write)
+{
+    assert(!graph.compiled && pass_idx < graph.passes.size() && resource < graph.resources.size());
+
+    for (RenderGraphUse& use : graph.passes[pass_idx].uses)
+    {
+        if (use.resource == resource)
+        {
+            assert(!graph.resources[resource].image || use.state.layout == state.layout);
+            use.state.stage |= state.stage;
+            use.state.access |= state.access;
+            use.write = use.write || write;
+            return;
+        }
+    }
+
+    graph.passes[pass_idx].uses.push_back(RenderGraphUse{.resource = resource, .state = state, .write = write});
+}
+
+static bool lifetimes_overlap(const RenderGraphResourceInfo& a, const RenderGraphResourceInfo& b)
+{
+    return a.first_pass <= a.last_pass && b.first_pass <= b.last_pass && a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+}
+
+// Transients only used by culled passes are neither created nor given memory
+static bool unused_transient(const RenderGraphResourceInfo& resource)
+{
+    return resource.transient && resource.first_pass > resource.last_pass;
+}
+
+static bool memory_overlaps(const RenderGraphResourceInfo& a, const RenderGraphResourceInfo& b)
+{
+    return a.heap == b.heap && a.heap_offset < b.heap_offset + b.memory_requirements.size && b.heap_offset < a.heap_offset + a.memory_requirements.size;
+}
+
+// Marks every pass whose results are never used as culled. Walking backwards, a pass is kept if it writes
+// an imported resource or one that a kept pass reads.
+static void cull_passes(RenderGraph& graph)
+{
+    std::vector<bool> needed(graph.resources.size(), false);
+    graph.culled_pass_count = 0u;
+
+    for (size_t p = graph.passes.size(); p-- > 0u;)
+    {
+        RenderGraphPass& pass = graph.passes[p];
+
+        bool keep = false;
+        for (const RenderGraphUse& use : pass.uses)
+            keep = keep || (use.write && (!graph.resources[use.resource].transient || needed[use.resource]));
+
+        pass.culled = !keep;
+        if (pass.culled)
+        {
+            ++graph.culled_pass_count;
+            continue;
+        }
+
+        // A read-modify-write needs the previous contents as well
+        for (const RenderGraphUse& use : pass.uses)
+        {
+            if (!use.write || (use.state.access & ~WRITE_ACCESS_MASK) != 0u)
+                needed[use.resource] = true;
+        }
+    }
+}
+
+static void compute_lifetimes(RenderGraph& graph)
+{
+    for (RenderGraphResourceInfo& resource : graph.resources)
+    {
+        resource.first_pass = UINT32_MAX;
+        resource.last_pass = 0u;
+    }
+
+    for (uint32_t p = 0; p < graph.passes.size(); ++p)
+    {
+        if (graph.passes[p].culled)
+            continue;
+
+        for (const RenderGraphUse& use : graph.passes[p].uses)
+        {
+            RenderGraphResourceInfo& resource = graph.resources[use.resource];
+            resource.first_pass = std::min(resource.first_pass, p);
+            resource.last_pass = std::max(resource.last_pass, p);
+        }
+    }
+}
+
+static void create_transients(RenderGraph& graph)
+{
+    for (RenderGraphResourceInfo& resource : graph.resources)
+    {
+        if (!resource.transient || unused_transient(resource))
+            continue;
+
+        if (!resource.image)
+        {
+            resource.buffer = create_buffer(graph.device, resource.buffer_size, resource.buffer_usage);
+            vkGetBufferMemoryRequirements(graph.device, resource.buffer, &resource.memory_requirements);
+            resource.heap = RENDER_GRAPH_HEAP_BUFFER;
+            continue;
+        }
+
+        const RenderGraphImageDesc& desc = resource.image_desc;
+        const VkImageCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = desc.format,
+            .extent = {.width = desc.extent.width, .height = desc.extent.height, .depth = 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = desc.samples,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = desc.usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+        VK_CHECK(vkCreateImage(graph.device, &create_info, nullptr, &resource.image_handle));
+        vkGetImageMemoryRequirements(graph.device, resource.image_handle, &resource.memory_requirements);
+
+        resource.heap = RENDER_GRAPH_HEAP_IMAGE;
+        if (desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+        {
+            const VkPhysicalDeviceMemoryProperties& memory_properties = graph.allocator->memory_properties;
+            for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+            {
+                if ((resource.memory_requirements.memoryTypeBits & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+                    resource.heap = RENDER_GRAPH_HEAP_LAZY;
+            }
+        }
+    }
+}
+
+// Places the transients of each heap, largest first, at the lowest offset that does not overlap a placed
+// transient with an overlapping lifetime. Then every heap gets one allocation the transients are bound to.
+static void alias_transients(RenderGraph& graph)
+{
+    graph.transient_size = 0u;
+    graph.heap_size = 0u;
+
+    for (uint32_t heap_idx = 0; heap_idx < RENDER_GRAPH_HEAP_COUNT; ++heap_idx)
+    {
+        std::vector<uint32_t> order;
+        for (uint32_t i = 0; i < graph.resources.size(); ++i)
+        {
+            if (graph.resources[i].transient && !unused_transient(graph.resources[i]) && graph.resources[i].heap == heap_idx)
+                order.push_back(i);
+        }
+
+        graph.heaps[heap_idx] = RenderGraphHeap{.allocation = {}, .size = 0u};
+        if (order.empty())
+            continue;
+
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return graph.resources[a].memory_requirements.size > graph.resources[b].memory_requirements.size;
+        });
+
+        VkMemoryRequirements heap_requirements{.size = 0u, .alignment = 1u, .memoryTypeBits = ~0u};
+        std::vector<uint32_t> placed;
+
+        for (uint32_t idx : order)
+        {
+            RenderGraphResourceInfo& resource = graph.resources[idx];
+            const VkMemoryRequirements& requirements = resource.memory_requirements;
+
+            std::vector<VkDeviceSize> candidates{0u};
+            for (uint32_t other : placed)
+            {
+                if (lifetimes_overlap(resource, graph.resources[other]))
+                {
+                    const VkDeviceSize end = graph.resources[other].heap_offset + graph.resources[other].memory_requirements.size;
+                    candidates.push_back((end + requirements.alignment - 1u) / requirements.alignment * requirements.alignment);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+
+            for (VkDeviceSize candidate : candidates)
+            {
+                resource.heap_offset = candidate;
+
+                bool fits = true;
+                for (uint32_t other : placed)
+                    fits = fits && !(lifetimes_overlap(resource, graph.resources[other]) && memory_overlaps(resource, graph.resources[other]));
+
+                if (fits)
+                    break;
+            }
+
+            placed.push_back(idx);
+            graph.transient_size += requirements.size;
+
+            heap_requirements.size = std::max(heap_requirements.size, resource.heap_offset + requirements.size);
+            heap_requirements.alignment = std::max(heap_requirements.alignment, requirements.alignment);
+            heap_requirements.memoryTypeBits &= requirements.memoryTypeBits;
+        }
+
+        if (heap_requirements.memoryTypeBits == 0u)
+            EXIT("Render graph transients have no memory type in common");
+
+        const bool lazy = (heap_idx == RENDER_GRAPH_HEAP_LAZY);
+        const uint32_t kind = (heap_idx == RENDER_GRAPH_HEAP_BUFFER) ? ALLOCATION_KIND_LINEAR : ALLOCATION_KIND_OPTIMAL;
+
+        RenderGraphHeap& heap = graph.heaps[heap_idx];
+        heap.allocation = allocator_allocate(*graph.allocator, heap_requirements, lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                             lazy ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : 0x0, kind);
+        heap.size = heap_requirements.size;
+        graph.heap_size += heap.size;
+
+        for (uint32_t idx : order)
+        {
+            RenderGraphResourceInfo& resource = graph.resources[idx];
+            const VkDeviceSize offset = heap.allocation.offset + resource.heap_offset;
+
+            if (!resource.image)
+            {
+                VK_CHECK(vkBindBufferMemory(graph.device, resource.buffer, heap.allocation.memory, offset));
+                continue;
+            }
+
+            VK_CHECK(vkBindImageMemory(graph.device, resource.image_handle, heap.allocation.memory, offset));
+
+            const VkImageViewCreateInfo view_create_info{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0x0,
+                .image = resource.image_handle,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = resource.image_desc.format,
+                .components = {},
+                .subresourceRange = {.aspectMask = resource.aspect, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1}};
+
+            VK_CHECK(vkCreateImageView(graph.device, &view_create_info, nullptr, &resource.view));
+        }
+    }
+}
+
+// A barrier can be recorded in front of any executed pass from earliest to latest (passes.size() is after
+// the last pass)
+struct PendingBarrier
+{
+    RenderGraphBarrier barrier;
+    uint32_t earliest;
+    uint32_t latest;
+};
+
+// Brings track to state for a use at position, appends the barrier that takes if one is needed
+static void transition(const RenderGraphResourceInfo& resource, RenderGraphResource resource_idx, ResourceTrack& track, const RenderGraphState& state,
+                       bool write, uint32_t position, const std::vector<uint32_t>& next_executed, std::vector<PendingBarrier>& barriers)
+{
+    const VkImageLayout layout = resource.image ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    const bool layout_change = track.layout != layout;
+
+    PendingBarrier pending{
+        .barrier = {
+            .resource = resource_idx,
+            .src_stage = track.write_stage,
+            .src_access = track.write_access & WRITE_ACCESS_MASK,
+            .dst_stage = state.stage,
+            .dst_access = state.access,
+            .old_layout = track.layout,
+            .new_layout = layout},
+        .earliest = 0u,
+        .latest = position};
+
+    bool needed;
+    if (write || layout_change)
+    {
+        // Write after read only needs the readers to have finished, a layout transition is a write too.
+        // Either one has to wait until every earlier use is done.
+        pending.barrier.src_stage |= track.read_stage;
+        pending.earliest = next_executed[track.last_use_pass + 1];
+        needed = layout_change || pending.barrier.src_stage != 0u;
+
+        // Later uses in other stages have to wait for state.stage, which the transition finishes before
+        track.write_stage = state.stage;
+        track.write_access = write ? state.access : 0u;
+        track.read_stage = write ? 0u : state.stage;
+        track.read_access = write ? 0u : state.access;
+        track.layout = layout;
+        track.last_write_pass = static_cast<int32_t>(position);
+    }
+    else
+    {
+        // Readers after the first one only wait if they read in a stage or way the write is not visible to
+        // yet. Only the write has to be done, so the barrier can move up to right after it.
+        pending.earliest = next_executed[track.last_write_pass + 1];
+        needed = track.write_stage != 0u && ((state.stage & ~track.read_stage) != 0u || (state.access & ~track.read_access) != 0u);
+
+        track.read_stage |= state.stage;
+        track.read_access |= state.access;
+    }
+
+    track.last_use_pass = static_cast<int32_t>(position);
+
+    if (needed)
+        barriers.push_back(pending);
+}
+
+// Walks the passes and final transitions once. tracks holds the state every resource starts in and is left
+// with the one the execution ends with. previous_end is the end state of the previous execution, null on
+// the first walk.
+static void simulate(RenderGraph& graph, std::vector<ResourceTrack>& tracks, const std::vector<ResourceTrack>* previous_end, std::vector<PendingBarrier>& barriers)
+{
+    const uint32_t pass_count = static_cast<uint32_t>(graph.passes.size());
+
+    // next_executed[i] is the first pass from i on that is not culled, pass_count if there is none
+    std::vector<uint32_t> next_executed(pass_count + 1u, pass_count);
+    for (uint32_t p = pass_count; p-- > 0u;)
+        next_executed[p] = graph.passes[p].culled ? next_executed[p + 1u] : p;
+
+    for (uint32_t p = 0; p < pass_count; ++p)
+    {
+        if (graph.passes[p].culled)
+            continue;
+
+        for (const RenderGraphUse& use : graph.passes[p].uses)
+        {
+            const RenderGraphResourceInfo& resource = graph.resources[use.resource];
+            ResourceTrack& track = tracks[use.resource];
+
+            // The memory of a transient was last used by the transients it is aliased with in this execution
+            // or, for frames in flight, by any transient overlapping it in the previous one
+            if (resource.transient && resource.first_pass == p && previous_end != nullptr)
+            {
+                for (uint32_t other = 0; other < graph.resources.size(); ++other)
+                {
+                    const RenderGraphResourceInfo& other_resource = graph.resources[other];
+                    if (!other_resource.transient || unused_transient(other_resource) || !memory_overlaps(resource, other_resource))
+                        continue;
+
+                    const bool in_this_execution = other_resource.last_pass < p;
+                    const ResourceTrack& last_use = in_this_execution ? tracks[other] : (*previous_end)[other];
+                    track.write_stage |= last_use.write_stage | last_use.read_stage;
+                    track.write_access |= last_use.write_access;
+
+                    if (in_this_execution)
+                        track.last_use_pass = std::max(track.last_use_pass, static_cast<int32_t>(other_resource.last_pass));
+                }
+            }
+
+            transition(resource, use.resource, track, use.state, use.write, p, next_executed, barriers);
+        }
+    }
+
+    for (uint32_t i = 0; i < graph.resources.size(); ++i)
+    {
+        if (graph.resources[i].has_final_state && !unused_transient(graph.resources[i]))
+            transition(graph.resources[i], i, tracks[i], graph.resources[i].final_state, false, pass_count, next_executed, barriers);
+    }
+}
+
+// Picks the fewest positions so that every barrier's range contains one (interval stabbing: by increasing
+// latest, a barrier joins the last picked position if it can, otherwise its own latest is picked) and stores
+// the barriers grouped by position
+static void place_barriers(RenderGraph& graph, std::vector<PendingBarrier>& pending)
+{
+    const uint32_t pass_count = static_cast<uint32_t>(graph.passes.size());
+
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingBarrier& a, const PendingBarrier& b) { return a.latest < b.latest; });
+
+    std::vector<std::vector<RenderGraphBarrier>> positions(pass_count + 1u);
+    uint32_t picked = UINT32_MAX;
+
+    for (const PendingBarrier& barrier : pending)
+    {
+        assert(barrier.earliest <= barrier.latest);
+
+        if (picked == UINT32_MAX || barrier.earliest > picked)
+            picked = barrier.latest;
+
+        positions[picked].push_back(barrier.barrier);
+    }
+
+    graph.barriers.clear();
+    for (uint32_t p = 0; p <= pass_count; ++p)
+    {
+        const uint32_t first = static_cast<uint32_t>(graph.barriers.size());
+        graph.barriers.insert(graph.barriers.end(), positions[p].begin(), positions[p].end());
+        const uint32_t count = static_cast<uint32_t>(graph.barriers.size()) - first;
+
+        if (p < pass_count)
+        {
+            graph.passes[p].first_barrier = first;
+            graph.passes[p].barrier_count = count;
+        }
+        else
+        {
+            graph.final_first_barrier = first;
+            graph.final_barrier_count = count;
+        }
+    }
+}
+
+static std::vector<ResourceTrack> initial_tracks(const RenderGraph& graph, const std::vector<ResourceTrack>* previous_end)
+{
+    std::vector<ResourceTrack> tracks(graph.resources.size(), ResourceTrack{
+        .write_stage = 0u, .write_access = 0u, .read_stage = 0u, .read_access = 0u, .layout = VK_IMAGE_LAYOUT_UNDEFINED, .last_write_pass = -1, .last_use_pass = -1});
+
+    for (uint32_t i = 0; i < graph.resources.size(); ++i)
+    {
+        const RenderGraphResourceInfo& resource = graph.resources[i];
+
+        if (resource.has_initial_state)
+        {
+            tracks[i].write_stage = resource.initial_state.stage;
+            tracks[i].write_access = resource.initial_state.access;
+            tracks[i].layout = resource.image ? resource.initial_state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+        else if (!resource.transient && previous_end != nullptr)
+        {
+            tracks[i] = (*previous_end)[i];
+            tracks[i].last_write_pass = -1;
+            tracks[i].last_use_pass = -1;
+        }
+    }
+
+    return tracks;
+}
+
+static void record_barriers(RenderGraph& graph, VkCommandBuffer cmd_buff, uint32_t first_barrier, uint32_t barrier_count)
+{
+    if (barrier_count == 0u)
+        return;
+
+    VkMemoryBarrier2KHR memory_barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR,
+        .pNext = nullptr,
+        .srcStageMask = 0u,
+        .srcAccessMask = 0u,
+        .dstStageMask = 0u,
+        .dstAccessMask = 0u};
+
+    graph.image_barrier_scratch.clear();
+
+    for (uint32_t i = first_barrier; i < first_barrier + barrier_count; ++i)
+    {
+        const RenderGraphBarrier& barrier = graph.barriers[i];
+        const RenderGraphResourceInfo& resource = graph.resources[barrier.resource];
+
+        if (!resource.image)
+        {
+            memory_barrier.srcStageMask |= barrier.src_stage;
+            memory_barrier.srcAccessMask |= barrier.src_access;
+            memory_barrier.dstStageMask |= barrier.dst_stage;
+            memory_barrier.dstAccessMask |= barrier.dst_access;
+            continue;
+        }
+
+        graph.image_barrier_scratch.push_back(VkImageMemoryBarrier2KHR{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+            .pNext = nullptr,
+            .srcStageMask = barrier.src_stage,
+            .srcAccessMask = barrier.src_access,
+            .dstStageMask = barrier.dst_stage,
+            .dstAccessMask = barrier.dst_access,
+            .oldLayout = barrier.old_layout,
+            .newLayout = barrier.new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = resource.image_handle,
+            .subresourceRange = {.aspectMask = resource.aspect, .baseMipLevel = 0, .levelCount = VK_REMAINING_MIP_LEVELS, .baseArrayLayer = 0, .layerCount = VK_REMAINING_ARRAY_LAYERS}});
+    }
+
+    const bool has_memory_barrier = (memory_barrier.srcStageMask | memory_barrier.dstStageMask) != 0u;
+
+    const VkDependencyInfoKHR dependency{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .pNext = nullptr,
+        .dependencyFlags = 0x0,
+        .memoryBarrierCount = has_memory_barrier ? 1u : 0u,
+        .pMemoryBarriers = &memory_barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = static_cast<uint32_t>(graph.image_barrier_scratch.size()),
+        .pImageMemoryBarriers = graph.image_barrier_scratch.data()};
+
+    graph.vkCmdPipelineBarrier2KHR(cmd_buff, &dependency);
+}
+
+RenderGraph create_render_graph(const VulkanManager& vulkan_manager, DeviceAllocator& allocator)
+{
+    assert(vulkan_manager.vkCmdPipelineBarrier2KHR != nullptr);
+
+    return RenderGraph{
+        .device = vulkan_manager.device,
+        .allocator = &allocator,
+        .vkCmdPipelineBarrier2KHR = vulkan_manager.vkCmdPipelineBarrier2KHR,
+        .resources = {},
+        .passes = {},
+        .compiled = false,
+        .barriers = {},
+        .final_first_barrier = 0u,
+        .final_barrier_count = 0u,
+        .heaps = {},
+        .culled_pass_count = 0u,
+        .barrier_call_count = 0u,
+        .transient_size = 0u,
+        .heap_size = 0u,
+        .image_barrier_scratch = {}};
+}
+
+void render_graph_release(RenderGraph& graph)
+{
+    for (RenderGraphResourceInfo& resource : graph.resources)
+    {
+        if (!resource.transient)
+            continue;
+
+        vkDestroyImageView(graph.device, resource.view, nullptr);
+        vkDestroyImage(graph.device, resource.image_handle, nullptr);
+        vkDestroyBuffer(graph.device, resource.buffer, nullptr);
+    }
+
+    for (RenderGraphHeap& heap : graph.heaps)
+    {
+        if (heap.allocation.memory != VK_NULL_HANDLE)
+            allocator_free(*graph.allocator, heap.allocation);
+    }
+
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.barriers.clear();
+    graph.compiled = false;
+}
+
+void render_graph_retire(RenderGraph& graph, DeletionQueue& queue)
+{
+    for (RenderGraphResourceInfo& resource : graph.resources)
+    {
+        if (!resource.transient)
+            continue;
+
+        // Views before their images, the queue destroys in retirement order
+        if (resource.view != VK_NULL_HANDLE)
+            deletion_queue_retire_image_view(queue, resource.view);
+        if (resource.image_handle != VK_NULL_HANDLE)
+            deletion_queue_retire_image(queue, resource.image_handle, Allocation{});
+        if (resource.buffer != VK_NULL_HANDLE)
+            deletion_queue_retire_buffer(queue, resource.buffer, Allocation{});
+    }
+
+    for (RenderGraphHeap& heap : graph.heaps)
+    {
+        if (heap.allocation.memory != VK_NULL_HANDLE)
+            deletion_queue_retire_allocation(queue, heap.allocation);
+        heap.allocation = Allocation{};
+    }
+
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.barriers.clear();
+    graph.compiled = false;
+}
+
+RenderGraphResource render_graph_import_buffer(RenderGraph& graph, const char* name, VkBuffer buffer)
+{
+    return add_resource(graph, RenderGraphResourceInfo{.name = name, .image = false, .transient = false, .buffer = buffer});
+}
+
+RenderGraphResource render_graph_import_image(RenderGraph& graph, const char* name, VkImage image, VkImageAspectFlags aspect)
+{
+    return add_resource(graph, RenderGraphResourceInfo{.name = name, .image = true, .transient = false, .buffer = VK_NULL_HANDLE, .image_handle = image, .view = VK_NULL_HANDLE, .aspect = aspect});
+}
+
+RenderGraphResource render_graph_create_buffer(RenderGraph& graph, const char* name, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    RenderGraphResourceInfo info{.name = name, .image = false, .transient = true};
+    info.buffer_size = size;
+    info.buffer_usage = usage;
+    return add_resource(graph, info);
+}
+
+RenderGraphResource render_graph_create_image(RenderGraph& graph, const char* name, const RenderGraphImageDesc& desc)
+{
+    RenderGraphResourceInfo info{.name = name, .image = true, .transient = true};
+    info.aspect = desc.aspect;
+    info.image_desc = desc;
+    return add_resource(graph, info);
+}
+
+void render_graph_set_initial_state(RenderGraph& graph, RenderGraphResource resource, const RenderGraphState& state)
+{
+    assert(!graph.compiled && !graph.resources[resource].transient);
+    graph.resources[resource].has_initial_state = true;
+    graph.resources[resource].initial_state = state;
+}
+
+void render_graph_set_final_state(RenderGraph& graph, RenderGraphResource resource, const RenderGraphState& state)
+{
+    assert(!graph.compiled);
+    graph.resources[resource].has_final_state = true;
+    graph.resources[resource].final_state = state;
+}
+
+uint32_t render_graph_add_pass(RenderGraph& graph, const char* name, const RenderGraphRecordFunction& record)
+{
+    assert(!graph.compiled);
+    graph.passes.push_back(RenderGraphPass{.name = name, .uses = {}, .record = record, .culled = false, .first_barrier = 0u, .barrier_count = 0u});
+    return static_cast<uint32_t>(graph.passes.size() - 1u);
+}
+
+void render_graph_read(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkPipelineStageFlags2KHR stage, VkAccessFlags2KHR access, VkImageLayout layout)
+{
+    add_use(graph, pass, resource, RenderGraphState{.stage = stage, .access = access, .layout = layout}, false);
+}
+
+void render_graph_write(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkPipelineStageFlags2KHR stage, VkAccessFlags2KHR access, VkImageLayout layout)
+{
+    add_use(graph, pass, resource, RenderGraphState{.stage = stage, .access = access, .layout = layout}, true);
+}
+
+void render_graph_compile(RenderGraph& graph)
+{
+    assert(!graph.compiled);
+
+    for (const RenderGraphResourceInfo& resource : graph.resources)
+    {
+        if (resource.image && !resource.transient && !resource.has_initial_state)
+            EXIT("Imported render graph image " << resource.name << " has no initial state");
+    }
+
+    cull_passes(graph);
+    compute_lifetimes(graph);
+    create_transients(graph);
+    alias_transients(graph);
+
+    // The first walk finds the state each execution ends in, which is where the next one starts. Only the
+    // barriers of the second walk are kept.
+    std::vector<PendingBarrier> pending;
+    std::vector<ResourceTrack> previous_end = initial_tracks(graph, nullptr);
+    simulate(graph, previous_end, nullptr, pending);
+
+    pending.clear();
+    std::vector<ResourceTrack> tracks = initial_tracks(graph, &previous_end);
+    simulate(graph, tracks, &previous_end, pending);
+    place_barriers(graph, pending);
+
+    graph.barrier_call_count = (graph.final_barrier_count > 0u) ? 1u : 0u;
+    for (const RenderGraphPass& pass : graph.passes)
+        graph.barrier_call_count += (pass.barrier_count > 0u) ? 1u : 0u;
+
+    graph.compiled = true;
+
+    LOG("Render Graph: %zu passes (%u culled), %u barrier calls, %zu barriers, transients %.2f KiB aliased into %.2f KiB\n",
+        graph.passes.size(), graph.culled_pass_count, graph.barrier_call_count, graph.barriers.size(), graph.transient_size / 1024.0f, graph.heap_size / 1024.0f);
+}
+
+void render_graph_set_buffer(RenderGraph& graph, RenderGraphResource resource, VkBuffer buffer)
+{
+    assert(!graph.resources[resource].transient && !graph.resources[resource].image);
+    graph.resources[resource].buffer = buffer;
+}
+
+void render_graph_set_image(RenderGraph& graph, RenderGraphResource resource, VkImage image)
+{
+    assert(!graph.resources[resource].transient && graph.resources[resource].image);
+    graph.resources[resource].image_handle = image;
+}
+
+VkBuffer render_graph_get_buffer(const RenderGraph& graph, RenderGraphResource resource)
+{
+    return graph.resources[resource].buffer;
+}
+
+VkImageView render_graph_get_image_view(const RenderGraph& graph, RenderGraphResource resource)
+{
+    return graph.resources[resource].view;
+}
+
+void render_graph_execute(RenderGraph& graph, VkCommandBuffer cmd_buff)
+{
+    assert(graph.compiled);
+
+    for (const RenderGraphPass& pass : graph.passes)
+    {
+        if (pass.culled)
+            continue;
+
+        record_barriers(graph, cmd_buff, pass.first_barrier, pass.barrier_count);
+        pass.record(cmd_buff);
+    }
+
+    record_barriers(graph, cmd_buff, graph.final_first_barrier, graph.final_barrier_count);
+}
+
+void render_graph_gui(const RenderGraph& graph)
+{
+    if (!ImGui::CollapsingHeader("Render Graph"))
+        return;
+
+    const float kib = 1.0f / 1024.0f;
+
+    ImGui::Text("%zu passes, %u culled, %u barrier calls", graph.passes.size(), graph.culled_pass_count, graph.barrier_call_count);
+    ImGui::Text("Transients: %.2f KiB aliased into %.2f KiB", graph.transient_size * kib, graph.heap_size * kib);
+
+    const RenderGraphHeap& lazy_heap = graph.heaps[RENDER_GRAPH_HEAP_LAZY];
+    if (lazy_heap.allocation.memory != VK_NULL_HANDLE)
+    {
+        // Of the whole VkDeviceMemory, which the lazy heap usually has to itself
+        VkDeviceSize committed = 0u;
+        vkGetDeviceMemoryCommitment(graph.device, lazy_heap.allocation.memory, &committed);
+        ImGui::Text("Lazily allocated: %.2f KiB, %.2f KiB committed", lazy_heap.size * kib, committed * kib);
+    }
+
+    if (ImGui::BeginTable("##passes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+    {
+        ImGui::TableSetupColumn("Pass");
+        ImGui::TableSetupColumn("Barriers");
+        ImGui::TableSetupColumn("Culled");
+        ImGui::TableHeadersRow();
+
+        for (const RenderGraphPass& pass : graph.passes)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(pass.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", pass.barrier_count);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(pass.culled ? "yes" : "no");
+        }
+
+        ImGui::EndTable();
+    }
+}
+
+#ifndef NDEBUG
+void render_graph_self_test(const VulkanManager& vulkan_manager, DeviceAllocator& allocator)
+{
+    RenderGraph graph = create_render_graph(vulkan_manager, allocator);
+
+    // Never executed, so the imported buffer needs no handle
+    const RenderGraphResource output = render_graph_import_buffer(graph, "Output", VK_NULL_HANDLE);
+
+    const VkDeviceSize size = 64u * 1024u;
+    const RenderGraphResource first = render_graph_create_buffer(graph, "First", size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    const RenderGraphResource second = render_graph_create_buffer(graph, "Second", size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    const RenderGraphResource unused = render_graph_create_buffer(graph, "Unused", size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    // first lives in passes 0 and 1, second in passes 2 and 3
+    for (const RenderGraphResource transient : {first, second})
+    {
+        const uint32_t write_pass = render_graph_add_pass(graph, "Write", [](VkCommandBuffer) {});
+        render_graph_write(graph, write_pass, transient, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR);
+
+        const uint32_t read_pass = render_graph_add_pass(graph, "Read", [](VkCommandBuffer) {});
+        render_graph_read(graph, read_pass, transient, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR);
+        render_graph_write(graph, read_pass, output, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR);
+    }
+
+    // Nothing reads what it writes, so it is culled
+    const uint32_t culled_pass = render_graph_add_pass(graph, "Culled", [](VkCommandBuffer) {});
+    render_graph_write(graph, culled_pass, unused, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR);
+
+    render_graph_compile(graph);
+
+    const RenderGraphResourceInfo& first_info = graph.resources[first];
+    const RenderGraphResourceInfo& second_info = graph.resources[second];
+    assert(graph.culled_pass_count == 1u && first_info.last_pass < second_info.first_pass);
+    assert(first_info.heap == second_info.heap && first_info.heap_offset == second_info.heap_offset);
+    assert(graph.heap_size < graph.transient_size);
+    assert(render_graph_get_buffer(graph, unused) == VK_NULL_HANDLE);
+
+    render_graph_release(graph);
+}
+#endif
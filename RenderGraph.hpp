@@ -0,0 +1,209 @@
+#ifndef RENDER_GRAPH_HPP
+#define RENDER_GRAPH_HPP
+
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Allocator.hpp"
+#include "DeletionQueue.hpp"
+#include "Helpers.hpp"
+
+typedef uint32_t RenderGraphResource;
+
+// Transients of different heaps never share memory
+enum
+{
+    RENDER_GRAPH_HEAP_BUFFER = 0,
+    RENDER_GRAPH_HEAP_IMAGE  = 1,
+    RENDER_GRAPH_HEAP_LAZY   = 2, // VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT images in LAZILY_ALLOCATED memory
+    RENDER_GRAPH_HEAP_COUNT
+};
+
+// How a pass (or the world outside the graph) uses a resource. layout is ignored for buffers.
+struct RenderGraphState
+{
+    VkPipelineStageFlags2KHR stage;
+    VkAccessFlags2KHR access;
+    VkImageLayout layout;
+};
+
+struct RenderGraphImageDesc
+{
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+    VkSampleCountFlagBits samples;
+    VkImageAspectFlags aspect;
+};
+
+struct RenderGraphResourceInfo
+{
+    const char* name;
+    bool image;
+    bool transient;                     // Created, owned and aliased by the graph
+
+    VkBuffer buffer;
+    VkImage image_handle;
+    VkImageView view;                   // Transient images only
+    VkImageAspectFlags aspect;
+
+    // Transients only
+    VkDeviceSize buffer_size;
+    VkBufferUsageFlags buffer_usage;
+    RenderGraphImageDesc image_desc;
+
+    // Imported resources without an initial state start every execution in the state the previous one
+    // left them in. Transients always start with undefined contents.
+    bool has_initial_state;
+    RenderGraphState initial_state;
+    bool has_final_state;               // Transitioned to final_state after the last pass
+    RenderGraphState final_state;
+
+    // Compiled. Passes are numbered in execution order, first_pass > last_pass if no pass uses the resource.
+    uint32_t first_pass;
+    uint32_t last_pass;
+    VkMemoryRequirements memory_requirements;
+    uint32_t heap;                      // RENDER_GRAPH_HEAP_*
+    VkDeviceSize heap_offset;
+};
+
+struct RenderGraphUse
+{
+    RenderGraphResource resource;
+    RenderGraphState state;
+    bool write;
+};
+
+struct RenderGraphBarrier
+{
+    RenderGraphResource resource;
+    VkPipelineStageFlags2KHR src_stage;
+    VkAccessFlags2KHR src_access;
+    VkPipelineStageFlags2KHR dst_stage;
+    VkAccessFlags2KHR dst_access;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+};
+
+typedef std::function<void(VkCommandBuffer cmd_buff)> RenderGraphRecordFunction;
+
+struct RenderGraphPass
+{
+    const char* name;
+    std::vector<RenderGraphUse> uses;
+    RenderGraphRecordFunction record;
+
+    // Compiled
+    bool culled;
+    uint32_t first_barrier;             // Into RenderGraph::barriers, recorded right before the pass
+    uint32_t barrier_count;
+};
+
+// One allocation per heap that all transients of that heap are placed in. Buffers and images never share
+// memory, so bufferImageGranularity does not matter.
+//
+// Transient attachments that are only ever cleared, drawn to and resolved within a render pass (MSAA color,
+// depth) go into the lazy heap if the device has a LAZILY_ALLOCATED memory type for them. Tile based GPUs
+// then never back them with physical memory. Elsewhere they are aliased in the image heap like any other
+// transient.
+struct RenderGraphHeap
+{
+    Allocation allocation;
+    VkDeviceSize size;
+};
+
+// Passes declare the resources they read and write and are recorded in the order they were added. Compiling
+// the graph
+//  - culls passes whose writes are never read by a later pass and do not touch an imported resource,
+//  - places transients whose lifetimes (first to last using pass) do not overlap in the same memory,
+//  - turns the declared uses into one vkCmdPipelineBarrier2KHR call in front of every pass that needs one.
+//    Buffer hazards of a pass are merged into a single global memory barrier, images get image barriers
+//    for their layout transitions.
+//
+// The graph is built and compiled once and executed every frame. Per-frame imported handles (swapchain
+// image, readback buffers) are swapped in with render_graph_set_buffer / render_graph_set_image. Frames
+// in flight share the transients, so the first use of a transient waits for the previous execution's last
+// use of its memory.
+struct RenderGraph
+{
+    VkDevice device;
+    DeviceAllocator* allocator;
+    PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR;
+
+    std::vector<RenderGraphResourceInfo> resources;
+    std::vector<RenderGraphPass> passes;
+    bool compiled;
+
+    std::vector<RenderGraphBarrier> barriers;
+    uint32_t final_first_barrier;       // Transitions to the final states after the last pass
+    uint32_t final_barrier_count;
+
+    RenderGraphHeap heaps[RENDER_GRAPH_HEAP_COUNT];
+
+    uint32_t culled_pass_count;
+    uint32_t barrier_call_count;        // vkCmdPipelineBarrier2KHR calls per execution
+    VkDeviceSize transient_size;        // Of all transients without aliasing
+    VkDeviceSize heap_size;             // Of all heaps
+
+    std::vector<VkImageMemoryBarrier2KHR> image_barrier_scratch;
+};
+
+RenderGraph create_render_graph(const VulkanManager& vulkan_manager, DeviceAllocator& allocator);
+
+// Destroys the transients, the device has to be idle
+void render_graph_release(RenderGraph& graph);
+
+// Like render_graph_release, but the transients and their heaps are retired into queue, so frames in flight
+// can still use them
+void render_graph_retire(RenderGraph& graph, DeletionQueue& queue);
+
+RenderGraphResource render_graph_import_buffer(RenderGraph& graph, const char* name, VkBuffer buffer);
+
+RenderGraphResource render_graph_import_image(RenderGraph& graph, const char* name, VkImage image, VkImageAspectFlags aspect);
+
+RenderGraphResource render_graph_create_buffer(RenderGraph& graph, const char* name, VkDeviceSize size, VkBufferUsageFlags usage);
+
+RenderGraphResource render_graph_create_image(RenderGraph& graph, const char* name, const RenderGraphImageDesc& desc);
+
+// Imported images need an initial state, their layout is not known otherwise
+void render_graph_set_initial_state(RenderGraph& graph, RenderGraphResource resource, const RenderGraphState& state);
+
+void render_graph_set_final_state(RenderGraph& graph, RenderGraphResource resource, const RenderGraphState& state);
+
+uint32_t render_graph_add_pass(RenderGraph& graph, const char* name, const RenderGraphRecordFunction& record);
+
+// Uses of the same resource by one pass are merged, a read-modify-write is a write with read access bits
+void render_graph_read(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkPipelineStageFlags2KHR stage, VkAccessFlags2KHR access,
+                       VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+void render_graph_write(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkPipelineStageFlags2KHR stage, VkAccessFlags2KHR access,
+                        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+// Creates and binds the transients, so their handles are valid afterwards. No passes or resources can be
+// added to a compiled graph.
+void render_graph_compile(RenderGraph& graph);
+
+// Replace the handle of an imported resource, for the next executions
+void render_graph_set_buffer(RenderGraph& graph, RenderGraphResource resource, VkBuffer buffer);
+
+void render_graph_set_image(RenderGraph& graph, RenderGraphResource resource, VkImage image);
+
+// VK_NULL_HANDLE for transients that only culled passes use, they are never created
+VkBuffer render_graph_get_buffer(const RenderGraph& graph, RenderGraphResource resource);
+
+VkImageView render_graph_get_image_view(const RenderGraph& graph, RenderGraphResource resource);
+
+// Records the barriers and passes that survived culling
+void render_graph_execute(RenderGraph& graph, VkCommandBuffer cmd_buff);
+
+void render_graph_gui(const RenderGraph& graph);
+
+#ifndef NDEBUG
+// Compiles a small graph without executing it and asserts that transients with disjoint lifetimes share
+// memory and that transients of culled passes get none
+void render_graph_self_test(const VulkanManager& vulkan_manager, DeviceAllocator& allocator);
+#endif
+
+#endif // RENDER_GRAPH_HPP
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ShaderArchive.hpp"
+#include "Defines.hpp"
+
+ShaderArchive create_shader_archive(VkDevice device, const char* path)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        EXIT("Failed to open shader archive " << path);
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(ShaderArchiveHeader))
+        EXIT("Invalid shader archive " << path);
+
+    const size_t size = static_cast<size_t>(file_stat.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        EXIT("Failed to map shader archive " << path);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const ShaderArchiveHeader* header = reinterpret_cast<const ShaderArchiveHeader*>(bytes);
+
+    if (header->magic != SHADER_ARCHIVE_MAGIC || header->version != SHADER_ARCHIVE_VERSION)
+        EXIT("Shader archive " << path << " has an unsupported format");
+
+    const size_t tables_size = sizeof(ShaderArchiveHeader) + header->entry_count * sizeof(ShaderArchiveEntry) + header->blob_count * sizeof(ShaderArchiveBlob);
+    if (tables_size > size)
+        EXIT("Shader archive " << path << " is truncated");
+
+    ShaderArchive archive{
+        .data = bytes,
+        .size = size,
+        .header = header,
+        .entries = reinterpret_cast<const ShaderArchiveEntry*>(bytes + sizeof(ShaderArchiveHeader)),
+        .blobs = reinterpret_cast<const ShaderArchiveBlob*>(bytes + sizeof(ShaderArchiveHeader) + header->entry_count * sizeof(ShaderArchiveEntry)),
+        .modules = std::vector<VkShaderModule>(header->blob_count, VK_NULL_HANDLE)};
+
+    // shader_archive_get indexes the modules with blob_idx
+    for (uint32_t i = 0; i < header->entry_count; ++i)
+    {
+        if (archive.entries[i].blob_idx >= header->blob_count)
+            EXIT("Shader archive " << path << " has an invalid blob index in entry " << i);
+    }
+
+    for (uint32_t i = 0; i < header->blob_count; ++i)
+    {
+        const ShaderArchiveBlob& blob = archive.blobs[i];
+
+        if (static_cast<size_t>(blob.offset) + blob.size > size)
+            EXIT("Shader archive " << path << " is truncated");
+
+        // Blobs are word aligned inside a page aligned mapping, so the pages can be handed to the driver as is
+        const VkShaderModuleCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .codeSize = blob.size,
+            .pCode = reinterpret_cast<const uint32_t*>(bytes + blob.offset)};
+
+        VK_CHECK(vkCreateShaderModule(device, &create_info, nullptr, &archive.modules[i]));
+    }
+
+    LOG("Shader Archive: %s (%u shaders, %u unique modules, %zu KB)\n", path, header->entry_count, header->blob_count, size / 1024u);
+
+    return archive;
+}
+
+void shader_archive_release(ShaderArchive& archive, VkDevice device)
+{
+    for (VkShaderModule module : archive.modules)
+        vkDestroyShaderModule(device, module, nullptr);
+
+    munmap(const_cast<uint8_t*>(archive.data), archive.size);
+
+    archive.modules.clear();
+    archive.data = nullptr;
+}
+
+ShaderStage shader_archive_get(const ShaderArchive& archive, const char* name)
+{
+    const ShaderArchiveEntry* entries_end = archive.entries + archive.header->entry_count;
+    const ShaderArchiveEntry* entry = std::lower_bound(archive.entries, entries_end, name, [](const ShaderArchiveEntry& entry, const char* name) {
+        return strncmp(entry.name, name, SHADER_ARCHIVE_MAX_NAME) < 0;
+    });
+
+    if (entry == entries_end || strncmp(entry->name, name, SHADER_ARCHIVE_MAX_NAME) != 0)
+        EXIT("Shader " << name << " is not in the shader archive");
+
+    return ShaderStage{
+        .module = archive.modules[entry->blob_idx],
+        .stage = static_cast<VkShaderStageFlagBits>(entry->stage),
+        .entry_point = entry->entry_point};
+}
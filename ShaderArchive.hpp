@@ -0,0 +1,81 @@
+#ifndef SHADER_ARCHIVE_HPP
+#define SHADER_ARCHIVE_HPP
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// shaders.pak layout, written by tools/shader_pack at build time:
+//
+//   ShaderArchiveHeader
+//   ShaderArchiveEntry[entry_count]  sorted by name
+//   ShaderArchiveBlob[blob_count]
+//   SPIR-V blobs, each aligned to SHADER_ARCHIVE_BLOB_ALIGNMENT
+//
+// Entries with identical SPIR-V share one blob, blobs are identified by the FNV-1a hash of their contents.
+constexpr uint32_t SHADER_ARCHIVE_MAGIC = 0x4b415053u; // "SPAK"
+constexpr uint32_t SHADER_ARCHIVE_VERSION = 1u;
+constexpr uint32_t SHADER_ARCHIVE_BLOB_ALIGNMENT = 16u;
+constexpr uint32_t SHADER_ARCHIVE_MAX_NAME = 64u;
+constexpr uint32_t SHADER_ARCHIVE_MAX_ENTRY_POINT = 32u;
+
+struct ShaderArchiveHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t blob_count;
+};
+
+struct ShaderArchiveEntry
+{
+    char name[SHADER_ARCHIVE_MAX_NAME];               // Source file name, e.g. "default.vert"
+    char entry_point[SHADER_ARCHIVE_MAX_ENTRY_POINT]; // From the module's OpEntryPoint
+    uint32_t stage;                                   // VkShaderStageFlagBits
+    uint32_t blob_idx;
+};
+
+struct ShaderArchiveBlob
+{
+    uint64_t hash;
+    uint32_t offset;                                  // From the start of the archive
+    uint32_t size;
+};
+
+inline uint64_t shader_archive_hash(const void* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+// The archive stays mapped for its whole lifetime. One VkShaderModule is created per blob up front, straight
+// from the mapped pages, so lookups are read only and can be done from any thread.
+struct ShaderArchive
+{
+    const uint8_t* data;
+    size_t size;
+
+    const ShaderArchiveHeader* header;
+    const ShaderArchiveEntry* entries;
+    const ShaderArchiveBlob* blobs;
+
+    std::vector<VkShaderModule> modules;              // One per blob
+};
+
+struct ShaderStage
+{
+    VkShaderModule module;
+    VkShaderStageFlagBits stage;
+    const char* entry_point;                          // Points into the mapped archive
+};
+
+ShaderArchive create_shader_archive(VkDevice device, const char* path);
+
+void shader_archive_release(ShaderArchive& archive, VkDevice device);
+
+// Exits if name is not in the archive
+ShaderStage shader_archive_get(const ShaderArchive& archive, const char* name);
+
+#endif // SHADER_ARCHIVE_HPP
@@ -0,0 +1,254 @@
+#include <string.h>
+
+#include "StreamCodec.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+constexpr uint32_t ROWS_PER_BLOCK = STREAM_CODEC_BLOCK_SIZE / STREAM_CODEC_LANES;
+
+// Decodes one block of differences bit packed with bit_width into out, returns the last value
+typedef uint32_t (*DecodeBlockFunction)(const uint8_t* words, uint32_t bit_width, uint32_t previous, uint32_t* out);
+
+static uint32_t zigzag_encode(uint32_t delta)
+{
+    return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+}
+
+static uint32_t bit_mask(uint32_t bit_width)
+{
+    return (bit_width == 32u) ? ~0u : (1u << bit_width) - 1u;
+}
+
+size_t stream_codec_max_encoded_size(uint32_t count)
+{
+    const size_t block_count = (count + STREAM_CODEC_BLOCK_SIZE - 1u) / STREAM_CODEC_BLOCK_SIZE;
+    return block_count * (1u + STREAM_CODEC_BLOCK_SIZE * sizeof(uint32_t));
+}
+
+size_t stream_codec_encode(const uint32_t* values, uint32_t count, uint8_t* dst)
+{
+    uint8_t* const begin = dst;
+    uint32_t previous = 0u;
+
+    for (uint32_t first = 0; first < count; first += STREAM_CODEC_BLOCK_SIZE)
+    {
+        uint32_t deltas[STREAM_CODEC_BLOCK_SIZE] = {};
+        uint32_t bits = 0u;
+
+        for (uint32_t i = 0; i < STREAM_CODEC_BLOCK_SIZE && first + i < count; ++i)
+        {
+            deltas[i] = zigzag_encode(values[first + i] - previous);
+            previous = values[first + i];
+            bits |= deltas[i];
+        }
+
+        uint32_t bit_width = 0u;
+        while (bit_width < 32u && (bits >> bit_width) != 0u)
+            ++bit_width;
+
+        uint32_t words[STREAM_CODEC_LANES * 32u] = {};
+        for (uint32_t i = 0; i < STREAM_CODEC_BLOCK_SIZE && bit_width > 0u; ++i)
+        {
+            const uint32_t lane = i % STREAM_CODEC_LANES;
+            const uint32_t bit = (i / STREAM_CODEC_LANES) * bit_width;
+            const uint32_t word = bit / 32u;
+            const uint32_t shift = bit % 32u;
+
+            words[word * STREAM_CODEC_LANES + lane] |= deltas[i] << shift;
+            if (shift + bit_width > 32u)
+                words[(word + 1u) * STREAM_CODEC_LANES + lane] |= deltas[i] >> (32u - shift);
+        }
+
+        *dst++ = static_cast<uint8_t>(bit_width);
+        memcpy(dst, words, STREAM_CODEC_LANES * bit_width * sizeof(uint32_t));
+        dst += STREAM_CODEC_LANES * bit_width * sizeof(uint32_t);
+    }
+
+    return static_cast<size_t>(dst - begin);
+}
+
+#if !defined(__x86_64__)
+
+static uint32_t zigzag_decode(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1u));
+}
+
+static uint32_t decode_block_scalar(const uint8_t* words, uint32_t bit_width, uint32_t previous, uint32_t* out)
+{
+    const uint32_t mask = bit_mask(bit_width);
+
+    for (uint32_t i = 0; i < STREAM_CODEC_BLOCK_SIZE; ++i)
+    {
+        const uint32_t lane = i % STREAM_CODEC_LANES;
+        const uint32_t bit = (i / STREAM_CODEC_LANES) * bit_width;
+        const uint32_t shift = bit % 32u;
+
+        uint32_t word;
+        memcpy(&word, words + ((bit / 32u) * STREAM_CODEC_LANES + lane) * sizeof(uint32_t), sizeof(word));
+        uint32_t value = word >> shift;
+
+        if (shift + bit_width > 32u)
+        {
+            memcpy(&word, words + ((bit / 32u + 1u) * STREAM_CODEC_LANES + lane) * sizeof(uint32_t), sizeof(word));
+            value |= word << (32u - shift);
+        }
+
+        previous += zigzag_decode(value & mask);
+        out[i] = previous;
+    }
+
+    return previous;
+}
+
+#else
+
+// SSE2 is part of x86-64, the two halves of a row are decoded separately
+static uint32_t decode_block_sse2(const uint8_t* words, uint32_t bit_width, uint32_t previous, uint32_t* out)
+{
+    const __m128i mask = _mm_set1_epi32(static_cast<int32_t>(bit_mask(bit_width)));
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(static_cast<int32_t>(previous));
+
+    for (uint32_t row = 0; row < ROWS_PER_BLOCK; ++row)
+    {
+        const uint32_t bit = row * bit_width;
+        const uint8_t* row_words = words + (bit / 32u) * STREAM_CODEC_LANES * sizeof(uint32_t);
+        const __m128i shift = _mm_cvtsi32_si128(static_cast<int32_t>(bit % 32u));
+        const bool spills = bit % 32u + bit_width > 32u;
+
+        for (uint32_t half = 0; half < 2u; ++half)
+        {
+            const uint8_t* half_words = row_words + half * 4u * sizeof(uint32_t);
+            __m128i value = _mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(half_words)), shift);
+
+            if (spills)
+            {
+                const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(half_words + STREAM_CODEC_LANES * sizeof(uint32_t)));
+                value = _mm_or_si128(value, _mm_sll_epi32(next, _mm_cvtsi32_si128(static_cast<int32_t>(32u - bit % 32u))));
+            }
+
+            value = _mm_and_si128(value, mask);
+            value = _mm_xor_si128(_mm_srli_epi32(value, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(value, one)));
+
+            value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+            value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+            value = _mm_add_epi32(value, carry);
+            carry = _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + row * STREAM_CODEC_LANES + half * 4u), value);
+        }
+    }
+
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(carry));
+}
+
+__attribute__((target("avx2")))
+static uint32_t decode_block_avx2(const uint8_t* words, uint32_t bit_width, uint32_t previous, uint32_t* out)
+{
+    const __m256i mask = _mm256_set1_epi32(static_cast<int32_t>(bit_mask(bit_width)));
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i last_lane = _mm256_set1_epi32(7);
+    __m256i carry = _mm256_set1_epi32(static_cast<int32_t>(previous));
+
+    for (uint32_t row = 0; row < ROWS_PER_BLOCK; ++row)
+    {
+        const uint32_t bit = row * bit_width;
+        const uint8_t* row_words = words + (bit / 32u) * STREAM_CODEC_LANES * sizeof(uint32_t);
+
+        __m256i value = _mm256_srl_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_words)), _mm_cvtsi32_si128(static_cast<int32_t>(bit % 32u)));
+
+        if (bit % 32u + bit_width > 32u)
+        {
+            const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_words + STREAM_CODEC_LANES * sizeof(uint32_t)));
+            value = _mm256_or_si256(value, _mm256_sll_epi32(next, _mm_cvtsi32_si128(static_cast<int32_t>(32u - bit % 32u))));
+        }
+
+        value = _mm256_and_si256(value, mask);
+        value = _mm256_xor_si256(_mm256_srli_epi32(value, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(value, one)));
+
+        // Prefix sum within each 128 bit half, then the low half's total is added to the high half
+        value = _mm256_add_epi32(value, _mm256_slli_si256(value, 4));
+        value = _mm256_add_epi32(value, _mm256_slli_si256(value, 8));
+        const __m256i low_total = _mm256_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+        value = _mm256_add_epi32(value, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+        value = _mm256_add_epi32(value, carry);
+        carry = _mm256_permutevar8x32_epi32(value, last_lane);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + row * STREAM_CODEC_LANES), value);
+    }
+
+    return static_cast<uint32_t>(_mm256_cvtsi256_si32(carry));
+}
+
+#endif
+
+struct Decoder
+{
+    DecodeBlockFunction decode_block;
+    const char* name;
+};
+
+static const Decoder& get_decoder()
+{
+    static const Decoder decoder = [] {
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("avx2"))
+            return Decoder{.decode_block = decode_block_avx2, .name = "avx2"};
+
+        return Decoder{.decode_block = decode_block_sse2, .name = "sse2"};
+#else
+        return Decoder{.decode_block = decode_block_scalar, .name = "scalar"};
+#endif
+    }();
+
+    return decoder;
+}
+
+size_t stream_codec_decode(const uint8_t* src, size_t src_size, uint32_t count, uint32_t* dst)
+{
+    const DecodeBlockFunction decode_block = get_decoder().decode_block;
+
+    size_t offset = 0u;
+    uint32_t previous = 0u;
+
+    for (uint32_t first = 0; first < count; first += STREAM_CODEC_BLOCK_SIZE)
+    {
+        if (offset >= src_size)
+            return 0u;
+
+        const uint32_t bit_width = src[offset++];
+        const size_t words_size = STREAM_CODEC_LANES * bit_width * sizeof(uint32_t);
+        if (bit_width > 32u || src_size - offset < words_size)
+            return 0u;
+
+        // A block of zero differences has no words the decoders could load from
+        if (bit_width == 0u)
+        {
+            for (uint32_t i = first; i < count && i < first + STREAM_CODEC_BLOCK_SIZE; ++i)
+                dst[i] = previous;
+        }
+        // The last block is decoded on the side, dst only has room for count values
+        else if (count - first >= STREAM_CODEC_BLOCK_SIZE)
+        {
+            previous = decode_block(src + offset, bit_width, previous, dst + first);
+        }
+        else
+        {
+            uint32_t last_block[STREAM_CODEC_BLOCK_SIZE];
+            previous = decode_block(src + offset, bit_width, previous, last_block);
+            memcpy(dst + first, last_block, (count - first) * sizeof(uint32_t));
+        }
+
+        offset += words_size;
+    }
+
+    return offset;
+}
+
+const char* stream_codec_decoder_name()
+{
+    return get_decoder().name;
+}
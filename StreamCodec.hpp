@@ -0,0 +1,34 @@
+#ifndef STREAM_CODEC_HPP
+#define STREAM_CODEC_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Lossless compression for streams of 32 bit integers, used for the vertex and index sections of .mesh files.
+//
+// Every value is replaced by the zigzag encoded difference to its predecessor (the first one to 0), so slowly
+// changing sequences like cache optimized indices or the positions of neighbouring vertices become small
+// numbers. The differences are bit packed in blocks of STREAM_CODEC_BLOCK_SIZE values:
+//
+//   uint8_t bit_width                   b, at most 32
+//   uint32_t words[8 * b]               value i of the block goes into lane i % 8, word w of lane l is words[8 * w + l]
+//
+// Values 8r .. 8r + 7 sit at the same bit offset of the 8 lanes, so the decoder unpacks them with one 256 bit
+// (AVX2) or two 128 bit (SSE2) shifts and masks and undoes the differences with an in-register prefix sum. The
+// last block is padded with zero differences.
+constexpr uint32_t STREAM_CODEC_BLOCK_SIZE = 256u;
+constexpr uint32_t STREAM_CODEC_LANES = 8u;
+
+size_t stream_codec_max_encoded_size(uint32_t count);
+
+// Returns the number of bytes written to dst, at most stream_codec_max_encoded_size(count)
+size_t stream_codec_encode(const uint32_t* values, uint32_t count, uint8_t* dst);
+
+// Returns the number of bytes read from src, 0 if src does not hold a valid stream of count values. Uses the
+// fastest decoder the CPU supports.
+size_t stream_codec_decode(const uint8_t* src, size_t src_size, uint32_t count, uint32_t* dst);
+
+// "avx2", "sse2" or "scalar"
+const char* stream_codec_decoder_name();
+
+#endif // STREAM_CODEC_HPP
@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+#include "Defines.hpp"
+
+static void worker_loop(ThreadPool& pool, uint32_t worker_idx)
+{
+    for (;;)
+    {
+        ThreadPoolTask task;
+
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.task_available.wait(lock, [&]() { return pool.stopping || !pool.tasks.empty(); });
+
+            if (pool.tasks.empty())
+                return;
+
+            task = std::move(pool.tasks.front());
+            pool.tasks.pop_front();
+        }
+
+        task(worker_idx);
+    }
+}
+
+void thread_pool_start(ThreadPool& pool, uint32_t thread_count)
+{
+    if (thread_count == 0u)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    pool.stopping = false;
+    pool.workers.reserve(thread_count);
+
+    for (uint32_t i = 0; i < thread_count; ++i)
+        pool.workers.emplace_back(worker_loop, std::ref(pool), i);
+
+    LOG("Worker Threads: %u\n", thread_count);
+}
+
+void thread_pool_stop(ThreadPool& pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stopping = true;
+    }
+
+    pool.task_available.notify_all();
+
+    for (std::thread& worker : pool.workers)
+        worker.join();
+
+    pool.workers.clear();
+}
+
+uint32_t thread_pool_size(const ThreadPool& pool)
+{
+    return static_cast<uint32_t>(pool.workers.size());
+}
+
+void thread_pool_enqueue(ThreadPool& pool, ThreadPoolTask task)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.tasks.push_back(std::move(task));
+    }
+
+    pool.task_available.notify_one();
+}
@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks get the index of the worker running them, so they can use per worker resources (pipeline caches,
+// command pools, ...) without any locking.
+typedef std::function<void(uint32_t worker_idx)> ThreadPoolTask;
+
+struct ThreadPool
+{
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::deque<ThreadPoolTask> tasks;
+    bool stopping = false;
+};
+
+// thread_count 0 uses one worker per hardware thread
+void thread_pool_start(ThreadPool& pool, uint32_t thread_count);
+
+// Finishes all queued tasks, then joins the workers
+void thread_pool_stop(ThreadPool& pool);
+
+uint32_t thread_pool_size(const ThreadPool& pool);
+
+void thread_pool_enqueue(ThreadPool& pool, ThreadPoolTask task);
+
+// Runs func(worker_idx) on a worker, the result is returned through the future
+template <typename Func>
+auto thread_pool_submit(ThreadPool& pool, Func&& func) -> std::future<decltype(func(0u))>
+{
+    typedef decltype(func(0u)) Result;
+
+    // std::function needs a copyable callable, packaged_task is move only
+    auto task = std::make_shared<std::packaged_task<Result(uint32_t)>>(std::forward<Func>(func));
+    std::future<Result> future = task->get_future();
+
+    thread_pool_enqueue(pool, [task](uint32_t worker_idx) { (*task)(worker_idx); });
+    return future;
+}
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cassert>
+
+#include "UniformAllocator.hpp"
+#include "Defines.hpp"
+#include "Helpers.hpp"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformAllocator create_uniform_allocator(VkDevice device, DeviceAllocator& allocator, const VkPhysicalDeviceLimits& limits, uint32_t frame_count,
+                                          VkDeviceSize frame_size, VkDeviceSize max_slice_size)
+{
+    assert(frame_count > 0u && max_slice_size > 0u && max_slice_size <= limits.maxUniformBufferRange);
+
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1u);
+    frame_size = align_up(std::max(frame_size, max_slice_size), alignment);
+
+    // Dynamic offsets are 32 bit
+    const VkDeviceSize buffer_size = frame_size * frame_count + max_slice_size;
+    assert(buffer_size <= UINT32_MAX);
+
+    const VkBuffer buffer = create_buffer(device, buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    // Written by the CPU every frame and read once per draw, device local if the device can map it (ReBAR, UMA)
+    const Allocation allocation = allocator_allocate_buffer(allocator, buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    return UniformAllocator{
+        .device = device,
+        .allocator = &allocator,
+        .buffer = buffer,
+        .allocation = allocation,
+        .alignment = alignment,
+        .frame_size = frame_size,
+        .max_slice_size = max_slice_size,
+        .frame_count = frame_count,
+        .frame_idx = 0u,
+        .head = 0u,
+        .peak = 0u};
+}
+
+void uniform_allocator_release(UniformAllocator& allocator)
+{
+    vkDestroyBuffer(allocator.device, allocator.buffer, nullptr);
+    allocator_free(*allocator.allocator, allocator.allocation);
+    allocator.buffer = VK_NULL_HANDLE;
+}
+
+void uniform_allocator_begin_frame(UniformAllocator& allocator, uint32_t frame_idx)
+{
+    assert(frame_idx < allocator.frame_count);
+
+    allocator.frame_idx = frame_idx;
+    allocator.head = 0u;
+}
+
+void uniform_allocator_end_frame(const UniformAllocator& allocator)
+{
+    if (allocator.head > 0u)
+        allocator_flush(*allocator.allocator, allocator.allocation, allocator.frame_idx * allocator.frame_size, allocator.head);
+}
+
+UniformSlice uniform_allocator_allocate(UniformAllocator& allocator, VkDeviceSize size)
+{
+    assert(size > 0u && size <= allocator.max_slice_size);
+
+    const VkDeviceSize begin = align_up(allocator.head, allocator.alignment);
+    if (begin + size > allocator.frame_size)
+        EXIT("Uniform allocator region of " << allocator.frame_size << " bytes is full");
+
+    allocator.head = begin + size;
+    allocator.peak = std::max(allocator.peak, allocator.head);
+
+    const VkDeviceSize offset = allocator.frame_idx * allocator.frame_size + begin;
+
+    return UniformSlice{
+        .data = static_cast<char*>(allocator.allocation.mapped) + offset,
+        .offset = static_cast<uint32_t>(begin)};
+}
+
+VkDescriptorBufferInfo uniform_allocator_descriptor_info(const UniformAllocator& allocator, uint32_t frame_idx)
+{
+    assert(frame_idx < allocator.frame_count);
+
+    return VkDescriptorBufferInfo{
+        .buffer = allocator.buffer,
+        .offset = frame_idx * allocator.frame_size,
+        .range = allocator.max_slice_size};
+}
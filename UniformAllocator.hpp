@@ -0,0 +1,64 @@
+#ifndef UNIFORM_ALLOCATOR_HPP
+#define UNIFORM_ALLOCATOR_HPP
+
+#include <vulkan/vulkan.h>
+
+#include "Allocator.hpp"
+
+constexpr VkDeviceSize UNIFORM_ALLOCATOR_DEFAULT_FRAME_SIZE = 64u * 1024u;
+
+// Range of the dynamic descriptor, so the largest slice. maxUniformBufferRange is at least 16 KB.
+constexpr VkDeviceSize UNIFORM_ALLOCATOR_DEFAULT_MAX_SLICE_SIZE = 1024u;
+
+struct UniformSlice
+{
+    void* data;                     // Persistently mapped, the constants are written here
+    uint32_t offset;                // Dynamic offset for vkCmdBindDescriptorSets, relative to the frame's region
+};
+
+// Per-frame bump allocator for shader constants. One persistently mapped, host visible buffer holds a region of
+// frame_size bytes per frame in flight. Slices are carved off the current frame's region at
+// minUniformBufferOffsetAlignment, and the whole region is rewound at once when the frame slot is reused.
+//
+// Every slice of a frame is read through the same VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor, which
+// points at the frame's region, so updating constants while recording only changes the dynamic offset. Nothing
+// is created and no descriptor is written per draw. This is for per-frame data, small per-draw data is pushed
+// as push constants (128 bytes are always available, see DrawParams in main.cpp). Not thread safe, allocate
+// before handing recording to the workers.
+struct UniformAllocator
+{
+    VkDevice device;
+    DeviceAllocator* allocator;
+
+    VkBuffer buffer;                // frame_count regions, plus max_slice_size so a slice at the end of the last region stays in range
+    Allocation allocation;
+
+    VkDeviceSize alignment;         // minUniformBufferOffsetAlignment
+    VkDeviceSize frame_size;        // Multiple of alignment
+    VkDeviceSize max_slice_size;
+    uint32_t frame_count;
+
+    uint32_t frame_idx;             // Region slices are allocated from
+    VkDeviceSize head;              // Bytes used in the region
+    VkDeviceSize peak;              // Most bytes any frame has used
+};
+
+UniformAllocator create_uniform_allocator(VkDevice device, DeviceAllocator& allocator, const VkPhysicalDeviceLimits& limits, uint32_t frame_count,
+                                          VkDeviceSize frame_size = UNIFORM_ALLOCATOR_DEFAULT_FRAME_SIZE,
+                                          VkDeviceSize max_slice_size = UNIFORM_ALLOCATOR_DEFAULT_MAX_SLICE_SIZE);
+
+void uniform_allocator_release(UniformAllocator& allocator);
+
+// Must be called after the fence of frame_idx has been waited on, before the first uniform_allocator_allocate
+void uniform_allocator_begin_frame(UniformAllocator& allocator, uint32_t frame_idx);
+
+// Flushes the frame's slices if the memory is not host coherent, before the frame is submitted
+void uniform_allocator_end_frame(const UniformAllocator& allocator);
+
+// size must not exceed max_slice_size. Exits if the frame's region is full.
+UniformSlice uniform_allocator_allocate(UniformAllocator& allocator, VkDeviceSize size);
+
+// For the VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor the slices of frame frame_idx are bound through
+VkDescriptorBufferInfo uniform_allocator_descriptor_info(const UniformAllocator& allocator, uint32_t frame_idx);
+
+#endif // UNIFORM_ALLOCATOR_HPP
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cassert>
+#include <string.h>
+
+#include "Uploader.hpp"
+#include "Defines.hpp"
+
+static VkCommandPool create_transient_command_pool(VkDevice device, uint32_t q_family_idx)
+{
+    const VkCommandPoolCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = q_family_idx};
+
+    VkCommandPool pool;
+    VK_CHECK(vkCreateCommandPool(device, &create_info, nullptr, &pool));
+    return pool;
+}
+
+static UploadTicket completed_ticket(const Uploader& uploader)
+{
+    uint64_t value;
+    VK_CHECK(vkGetSemaphoreCounterValue(uploader.device, uploader.timeline, &value));
+    return value;
+}
+
+// Returns the staging space of every completed batch to the ring
+static void reclaim_staging(Uploader& uploader, UploadTicket completed)
+{
+    for (const UploadBatch& batch : uploader.batches)
+    {
+        if (batch.ticket != 0u && batch.ticket <= completed)
+            uploader.staging_tail = std::max(uploader.staging_tail, batch.staging_end);
+    }
+}
+
+static UploadBatch& begin_batch(Uploader& uploader)
+{
+    if (uploader.recording_batch_idx != UINT32_MAX)
+        return uploader.batches[uploader.recording_batch_idx];
+
+    uint32_t batch_idx = 0u;
+    while (batch_idx < uploader.batches.size() && (uploader.batches[batch_idx].ticket != 0u || !uploader.batches[batch_idx].copies.empty()))
+        ++batch_idx;
+
+    if (batch_idx == uploader.batches.size())
+    {
+        UploadBatch batch{
+            .command_pool = create_transient_command_pool(uploader.device, uploader.q_family_idx),
+            .command_buffer = VK_NULL_HANDLE,
+            .ticket = 0u,
+            .staging_end = 0u,
+            .copies = {}};
+
+        batch.command_buffer = create_command_buffer(uploader.device, batch.command_pool);
+        uploader.batches.push_back(batch);
+    }
+
+    UploadBatch& batch = uploader.batches[batch_idx];
+
+    static const VkCommandBufferBeginInfo command_buffer_begin_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+    VK_CHECK(vkBeginCommandBuffer(batch.command_buffer, &command_buffer_begin_info));
+
+    uploader.recording_batch_idx = batch_idx;
+    return batch;
+}
+
+// Returns the ring offset of size contiguous bytes, waiting for in flight batches if the ring is full
+static VkDeviceSize allocate_staging(Uploader& uploader, VkDeviceSize size)
+{
+    assert(size <= uploader.staging_size);
+
+    for (;;)
+    {
+        VkDeviceSize begin = (uploader.staging_head + UPLOADER_STAGING_ALIGNMENT - 1) / UPLOADER_STAGING_ALIGNMENT * UPLOADER_STAGING_ALIGNMENT;
+
+        // Ranges never wrap, skip the rest of the ring instead
+        if (begin % uploader.staging_size + size > uploader.staging_size)
+            begin = (begin / uploader.staging_size + 1u) * uploader.staging_size;
+
+        if (begin + size - uploader.staging_tail <= uploader.staging_size)
+        {
+            uploader.staging_head = begin + size;
+            return begin % uploader.staging_size;
+        }
+
+        // The ring is full. The batch being recorded may hold the space that is needed, so it is submitted
+        // first, then the oldest batch still in flight is waited for.
+        if (uploader.recording_batch_idx != UINT32_MAX)
+            uploader_submit(uploader);
+
+        UploadTicket completed = completed_ticket(uploader);
+        if (completed < uploader.submitted_ticket)
+        {
+            const UploadTicket wait_ticket = completed + 1u;
+            const VkSemaphoreWaitInfo wait_info{
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                .flags = 0x0,
+                .semaphoreCount = 1u,
+                .pSemaphores = &uploader.timeline,
+                .pValues = &wait_ticket};
+
+            VK_CHECK(vkWaitSemaphores(uploader.device, &wait_info, UINT64_MAX));
+            completed = wait_ticket;
+        }
+
+        reclaim_staging(uploader, completed);
+    }
+}
+
+Uploader create_uploader(const VulkanManager& vulkan_manager, DeviceAllocator& allocator, uint32_t q_family_idx, VkQueue queue, uint32_t dst_q_family_idx,
+                         VkDeviceSize staging_size)
+{
+    const VkSemaphoreTypeCreateInfo semaphore_type_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = nullptr,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0u};
+
+    const VkSemaphoreCreateInfo semaphore_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semaphore_type_info};
+
+    VkSemaphore timeline;
+    VK_CHECK(vkCreateSemaphore(vulkan_manager.device, &semaphore_info, nullptr, &timeline));
+
+    // Mapped once for the lifetime of the uploader. Coherent memory is preferred so chunks need no flush.
+    const VkBuffer staging_buffer = create_buffer(vulkan_manager.device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    const Allocation staging_allocation = allocator_allocate_buffer(allocator, staging_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    LOG("Uploader Queue Family: %u (destination %u), Staging Ring: %llu KB\n", q_family_idx, dst_q_family_idx, (unsigned long long)(staging_size / 1024u));
+
+    return Uploader{
+        .device = vulkan_manager.device,
+        .allocator = &allocator,
+        .vkCmdPipelineBarrier2KHR = vulkan_manager.vkCmdPipelineBarrier2KHR,
+        .queue = queue,
+        .q_family_idx = q_family_idx,
+        .dst_q_family_idx = dst_q_family_idx,
+        .staging_buffer = staging_buffer,
+        .staging_allocation = staging_allocation,
+        .staging_size = staging_size,
+        .staging_head = 0u,
+        .staging_tail = 0u,
+        .timeline = timeline,
+        .submitted_ticket = 0u,
+        .acquired_ticket = 0u,
+        .batches = {},
+        .recording_batch_idx = UINT32_MAX};
+}
+
+void uploader_release(Uploader& uploader)
+{
+    const VkSemaphoreWaitInfo wait_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .flags = 0x0,
+        .semaphoreCount = 1u,
+        .pSemaphores = &uploader.timeline,
+        .pValues = &uploader.submitted_ticket};
+
+    VK_CHECK(vkWaitSemaphores(uploader.device, &wait_info, UINT64_MAX));
+
+    for (UploadBatch& batch : uploader.batches)
+        vkDestroyCommandPool(uploader.device, batch.command_pool, nullptr);
+
+    uploader.batches.clear();
+
+    vkDestroyBuffer(uploader.device, uploader.staging_buffer, nullptr);
+    allocator_free(*uploader.allocator, uploader.staging_allocation);
+    vkDestroySemaphore(uploader.device, uploader.timeline, nullptr);
+}
+
+UploadTicket uploader_upload_buffer(Uploader& uploader, VkBuffer dst_buffer, VkDeviceSize dst_offset, const void* data, VkDeviceSize size,
+                                    VkPipelineStageFlags2KHR dst_stage, VkAccessFlags2KHR dst_access)
+{
+    assert(size > 0u);
+
+    const VkDeviceSize max_chunk_size = uploader.staging_size / 2u;
+    const char* src = static_cast<const char*>(data);
+
+    reclaim_staging(uploader, completed_ticket(uploader));
+
+    for (VkDeviceSize chunk_offset = 0u; chunk_offset < size; chunk_offset += max_chunk_size)
+    {
+        const VkDeviceSize chunk_size = std::min(max_chunk_size, size - chunk_offset);
+
+        // May submit the current batch to make room, so the batch to record into is only picked afterwards
+        const VkDeviceSize staging_offset = allocate_staging(uploader, chunk_size);
+        UploadBatch& batch = begin_batch(uploader);
+
+        memcpy(static_cast<char*>(uploader.staging_allocation.mapped) + staging_offset, src + chunk_offset, chunk_size);
+        allocator_flush(*uploader.allocator, uploader.staging_allocation, staging_offset, chunk_size);
+
+        const VkBufferCopy buffer_copy{
+            .srcOffset = staging_offset,
+            .dstOffset = dst_offset + chunk_offset,
+            .size = chunk_size};
+
+        vkCmdCopyBuffer(batch.command_buffer, uploader.staging_buffer, dst_buffer, 1u, &buffer_copy);
+
+        batch.staging_end = uploader.staging_head;
+        batch.copies.push_back(UploadCopy{
+            .dst_buffer = dst_buffer,
+            .dst_offset = dst_offset + chunk_offset,
+            .size = chunk_size,
+            .dst_stage = dst_stage,
+            .dst_access = dst_access});
+
+        // Hand every full chunk to the transfer queue right away, so it copies while the next one is written
+        if (chunk_offset + chunk_size < size)
+            uploader_submit(uploader);
+    }
+
+    return uploader.submitted_ticket + 1u;
+}
+
+UploadTicket uploader_submit(Uploader& uploader)
+{
+    if (uploader.recording_batch_idx == UINT32_MAX)
+        return 0u;
+
+    UploadBatch& batch = uploader.batches[uploader.recording_batch_idx];
+
+    // Release ownership of all destinations with a single barrier, the acquire half is recorded on the destination queue
+    if (uploader.q_family_idx != uploader.dst_q_family_idx)
+    {
+        std::vector<VkBufferMemoryBarrier2KHR> barriers;
+        barriers.reserve(batch.copies.size());
+
+        for (const UploadCopy& copy : batch.copies)
+        {
+            barriers.push_back(VkBufferMemoryBarrier2KHR{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+                .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+                .dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR,
+                .dstAccessMask = VK_ACCESS_2_NONE_KHR,
+                .srcQueueFamilyIndex = uploader.q_family_idx,
+                .dstQueueFamilyIndex = uploader.dst_q_family_idx,
+                .buffer = copy.dst_buffer,
+                .offset = copy.dst_offset,
+                .size = copy.size});
+        }
+
+        const VkDependencyInfoKHR dependency_info{
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+            .pBufferMemoryBarriers = barriers.data()};
+
+        uploader.vkCmdPipelineBarrier2KHR(batch.command_buffer, &dependency_info);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(batch.command_buffer));
+
+    batch.ticket = ++uploader.submitted_ticket;
+
+    const VkTimelineSemaphoreSubmitInfo timeline_info{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1u,
+        .pSignalSemaphoreValues = &batch.ticket};
+
+    const VkSubmitInfo submit_info{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
+        .commandBufferCount = 1u,
+        .pCommandBuffers = &batch.command_buffer,
+        .signalSemaphoreCount = 1u,
+        .pSignalSemaphores = &uploader.timeline};
+
+    VK_CHECK(vkQueueSubmit(uploader.queue, 1u, &submit_info, VK_NULL_HANDLE));
+
+    uploader.recording_batch_idx = UINT32_MAX;
+    return batch.ticket;
+}
+
+bool uploader_is_complete(const Uploader& uploader, UploadTicket ticket)
+{
+    return completed_ticket(uploader) >= ticket;
+}
+
+bool uploader_is_acquired(const Uploader& uploader, UploadTicket ticket)
+{
+    return ticket != 0u && ticket <= uploader.acquired_ticket;
+}
+
+UploadTicket uploader_record_acquire(Uploader& uploader, VkCommandBuffer cmd_buff)
+{
+    const UploadTicket completed = completed_ticket(uploader);
+
+    std::vector<VkBufferMemoryBarrier2KHR> barriers;
+
+    for (UploadBatch& batch : uploader.batches)
+    {
+        if (batch.ticket == 0u || batch.ticket > completed)
+            continue;
+
+        if (uploader.q_family_idx != uploader.dst_q_family_idx)
+        {
+            for (const UploadCopy& copy : batch.copies)
+            {
+                barriers.push_back(VkBufferMemoryBarrier2KHR{
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                    .srcStageMask = VK_PIPELINE_STAGE_2_NONE_KHR,
+                    .srcAccessMask = VK_ACCESS_2_NONE_KHR,
+                    .dstStageMask = copy.dst_stage,
+                    .dstAccessMask = copy.dst_access,
+                    .srcQueueFamilyIndex = uploader.q_family_idx,
+                    .dstQueueFamilyIndex = uploader.dst_q_family_idx,
+                    .buffer = copy.dst_buffer,
+                    .offset = copy.dst_offset,
+                    .size = copy.size});
+            }
+        }
+
+        uploader.acquired_ticket = std::max(uploader.acquired_ticket, batch.ticket);
+
+        // The batch has completed, its staging range and command buffer can be reused right away
+        uploader.staging_tail = std::max(uploader.staging_tail, batch.staging_end);
+        VK_CHECK(vkResetCommandPool(uploader.device, batch.command_pool, 0x0));
+        batch.copies.clear();
+        batch.ticket = 0u;
+    }
+
+    if (!barriers.empty())
+    {
+        const VkDependencyInfoKHR dependency_info{
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+            .pBufferMemoryBarriers = barriers.data()};
+
+        uploader.vkCmdPipelineBarrier2KHR(cmd_buff, &dependency_info);
+    }
+
+    return uploader.acquired_ticket;
+}
@@ -0,0 +1,100 @@
+#ifndef UPLOADER_HPP
+#define UPLOADER_HPP
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Allocator.hpp"
+#include "Helpers.hpp"
+
+// Value of the uploader's timeline semaphore that signals once the upload has completed, 0 is never used
+typedef uint64_t UploadTicket;
+
+constexpr VkDeviceSize UPLOADER_DEFAULT_STAGING_SIZE = 16ull * 1024 * 1024;
+constexpr VkDeviceSize UPLOADER_STAGING_ALIGNMENT = 16u;
+
+struct UploadCopy
+{
+    VkBuffer dst_buffer;
+    VkDeviceSize dst_offset;
+    VkDeviceSize size;
+
+    // First use on the destination queue, the acquire barrier makes the data visible to these
+    VkPipelineStageFlags2KHR dst_stage;
+    VkAccessFlags2KHR dst_access;
+};
+
+// All copies recorded between two uploader_submit calls, executed with a single vkQueueSubmit
+struct UploadBatch
+{
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    UploadTicket ticket;                     // 0 while the batch is free or being recorded
+    VkDeviceSize staging_end;                // Staging ring head after the batch's last chunk
+
+    std::vector<UploadCopy> copies;
+};
+
+// All data is streamed through one persistently mapped staging ring. staging_head and staging_tail only
+// ever grow, the ring offset is their value modulo staging_size. Space up to staging_tail is free again,
+// it advances to a batch's staging_end once the batch's timeline value has signaled.
+//
+// Copies run on q_family_idx (ideally a transfer only family) and never stall the CPU or the destination
+// queue. If the families differ, batches end with a queue family ownership release and the matching
+// acquire is recorded into a destination queue command buffer by uploader_record_acquire once the batch
+// has completed.
+struct Uploader
+{
+    VkDevice device;
+    DeviceAllocator* allocator;
+    PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR;
+
+    VkQueue queue;
+    uint32_t q_family_idx;
+    uint32_t dst_q_family_idx;
+
+    VkBuffer staging_buffer;
+    Allocation staging_allocation;
+    VkDeviceSize staging_size;
+    VkDeviceSize staging_head;
+    VkDeviceSize staging_tail;
+
+    VkSemaphore timeline;
+    UploadTicket submitted_ticket;          // Ticket of the last submitted batch
+    UploadTicket acquired_ticket;           // Every batch up to this ticket is owned by the destination queue
+
+    std::vector<UploadBatch> batches;
+    uint32_t recording_batch_idx;           // UINT32_MAX if no batch is being recorded
+};
+
+// Needs DEVICE_EXT_SYNC_2 and DEVICE_EXT_TIMELINE_SEMAPHORE
+Uploader create_uploader(const VulkanManager& vulkan_manager, DeviceAllocator& allocator, uint32_t q_family_idx, VkQueue queue, uint32_t dst_q_family_idx,
+                         VkDeviceSize staging_size = UPLOADER_DEFAULT_STAGING_SIZE);
+
+// Waits for all submitted batches
+void uploader_release(Uploader& uploader);
+
+// Records a copy of data into dst_buffer. data is copied into staging memory before returning. The
+// returned ticket is the one of the current batch and only completes after the next uploader_submit.
+//
+// Uploads of any size are split into chunks of half the staging ring. While the transfer queue copies
+// one half, the next chunk is written into the other, so this only blocks if the CPU outruns the copies.
+// size must not be 0, nothing would be recorded to complete the returned ticket.
+UploadTicket uploader_upload_buffer(Uploader& uploader, VkBuffer dst_buffer, VkDeviceSize dst_offset, const void* data, VkDeviceSize size,
+                                    VkPipelineStageFlags2KHR dst_stage, VkAccessFlags2KHR dst_access);
+
+// Submits the current batch, returns its ticket or 0 if nothing was recorded
+UploadTicket uploader_submit(Uploader& uploader);
+
+bool uploader_is_complete(const Uploader& uploader, UploadTicket ticket);
+
+// True once the data of ticket may be used by work recorded on the destination queue
+bool uploader_is_acquired(const Uploader& uploader, UploadTicket ticket);
+
+// Records the ownership acquire of every completed batch into cmd_buff (a destination queue command buffer)
+// and recycles those batches. Returns the timeline value the submission of cmd_buff has to wait on, it is
+// already signaled so the wait never stalls.
+UploadTicket uploader_record_acquire(Uploader& uploader, VkCommandBuffer cmd_buff);
+
+#endif // UPLOADER_HPP
@@ -0,0 +1,103 @@
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+
+#include <string.h>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "MeshFile.hpp"
+
+// Encodings of the vertex position, chosen at compile time with VertexLayout. All of them hold the snorm
+// position of MeshFileQuantizedVertex (position / MESH_FILE_POSITION_SCALE, in [-1, 1]), shaders/default.vert
+// scales it back. 16 bit encodings have a fourth component, 3 component 16 bit formats are rarely supported
+// for vertex input.
+struct PositionFloat32
+{
+    static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+
+    float value[3];
+
+    static PositionFloat32 encode(const int16_t snorm[3])
+    {
+        PositionFloat32 position;
+        for (uint32_t c = 0; c < 3; ++c)
+            position.value[c] = std::max(snorm[c] / 32767.0f, -1.0f);
+        return position;
+    }
+};
+
+struct PositionHalf
+{
+    static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    uint16_t value[4];
+
+    // Values are in [-1, 1], so there are no overflows or infinities to handle. Denormals are flushed to 0.
+    static uint16_t float_to_half(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+
+        const uint32_t sign = (bits >> 16) & 0x8000u;
+        const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xffu) - 127 + 15;
+        if (exponent <= 0)
+            return static_cast<uint16_t>(sign);
+
+        // Round to nearest, a carry out of the mantissa correctly bumps the exponent
+        const uint32_t half = (static_cast<uint32_t>(exponent) << 10) | ((bits >> 13) & 0x3ffu);
+        return static_cast<uint16_t>(sign | (half + ((bits >> 12) & 1u)));
+    }
+
+    static PositionHalf encode(const int16_t snorm[3])
+    {
+        const PositionFloat32 position = PositionFloat32::encode(snorm);
+        return PositionHalf{.value = {float_to_half(position.value[0]), float_to_half(position.value[1]), float_to_half(position.value[2]), 0u}};
+    }
+};
+
+struct PositionSnorm16
+{
+    static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SNORM;
+
+    int16_t value[4];
+
+    static PositionSnorm16 encode(const int16_t snorm[3])
+    {
+        return PositionSnorm16{.value = {snorm[0], snorm[1], snorm[2], 0}};
+    }
+};
+
+// Interleaved vertex of PIPELINE_DEFAULT, location 0 is the position
+template <typename Position>
+struct VertexLayout
+{
+    Position position;
+};
+
+template <typename Vertex>
+VkVertexInputBindingDescription vertex_binding_description(uint32_t binding)
+{
+    return VkVertexInputBindingDescription{
+        .binding = binding,
+        .stride = sizeof(Vertex),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+}
+
+template <typename Vertex>
+std::vector<VkVertexInputAttributeDescription> vertex_attribute_descriptions(uint32_t binding)
+{
+    return {{.location = 0,
+             .binding = binding,
+             .format = decltype(Vertex::position)::format,
+             .offset = offsetof(Vertex, position)}};
+}
+
+template <typename Vertex>
+void encode_vertices(const MeshFileQuantizedVertex* src, uint32_t count, Vertex* dst)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        dst[i].position = decltype(Vertex::position)::encode(src[i].position);
+}
+
+#endif // VERTEX_LAYOUT_HPP
@@ -1,4 +1,8 @@
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <float.h>
+#include <math.h>
 #include <string.h>
 
 #include <vulkan/vulkan.h>
@@ -8,12 +12,28 @@
 #include <imgui/backends/imgui_impl_glfw.h>
 #include <imgui/backends/imgui_impl_vulkan.h>
 
+#include "Allocator.hpp"
+#include "Bench.hpp"
+#include "CommandRecorder.hpp"
 #include "Defines.hpp"
+#include "DeletionQueue.hpp"
+#include "DescriptorAllocator.hpp"
 #include "Helpers.hpp"
+#include "MeshFile.hpp"
+#include "PipelineBuilder.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
+#include "ShaderArchive.hpp"
+#include "StreamCodec.hpp"
+#include "ThreadPool.hpp"
+#include "UniformAllocator.hpp"
+#include "Uploader.hpp"
+#include "VertexLayout.hpp"
 
 enum
 {
     QUEUE_GRAPHICS = 0,
+    QUEUE_TRANSFER = 1, // Dedicated transfer family if there is one, otherwise the same queue as QUEUE_GRAPHICS
     QUEUE_COUNT
 };
 
@@ -26,6 +46,7 @@ enum
 enum
 {
     PIPELINE_DEFAULT = 0,
+    PIPELINE_CULL    = 1,
     PIPELINE_COUNT
 };
 
@@ -37,58 +58,233 @@ enum
 
 enum
 {
-    COMMAND_BUFFER_RENDER = 0,
+    COMMAND_BUFFER_UPLOAD = 0,
     COMMAND_BUFFER_COUNT
 };
 
+// Per frame-in-flight sync objects (see Frame)
 enum
 {
+    SEMAPHORE_IMAGE_ACQUIRED  = 0,
+    SEMAPHORE_RENDER_FINISHED = 1,
     SEMAPHORE_COUNT
 };
 
 enum
 {
-    FENCE_IMAGE_ACQUIRE = 0,
+    FENCE_SUBMIT = 0,
     FENCE_COUNT
 };
 
 enum
 {
-    DESCRIPTOR_POOL_IMGUI = 0,
-    DESCRIPTOR_POOL_COUNT 
+    DESCRIPTOR_SET_LAYOUT_CULL  = 0,
+    DESCRIPTOR_SET_LAYOUT_FRAME = 1,
+    DESCRIPTOR_SET_LAYOUT_COUNT
 };
 
 enum
 {
-    BUFFER_VERTEX_TRIANGLE = 0,
-    BUFFER_INDEX_TRIANGLE  = 1,
-    BUFFER_STAGING         = 2,
+    BUFFER_VERTEX        = 0, // Vertices of all meshes
+    BUFFER_INDEX         = 1, // 16 bit then 32 bit indices of all meshes, relative to the mesh's vertex_offset
+    BUFFER_DRAW_RECORDS  = 2, // DrawRecord per object, grouped by mesh. Instance buffer of direct draws.
+    BUFFER_MESHES        = 3, // Mesh per mesh, read by the cull pass
+    BUFFER_BATCHES       = 4, // BUFFER_DRAW_COMMANDS with no instances, copied over it before every cull pass
+    // Rewritten every frame, these are transients of the render graph
+    BUFFER_DRAW_COMMANDS = 5, // Instanced VkDrawIndexedIndirectCommand per mesh, instance counts written by the cull pass
+    BUFFER_INSTANCES     = 6, // DrawRecord per visible object, grouped by mesh. Instance buffer of indirect draws.
     BUFFER_COUNT
 };
 
+constexpr uint32_t BUFFER_PERSISTENT_COUNT = BUFFER_DRAW_COMMANDS; // Created and uploaded by init()
+
+enum
+{
+    // Built-in meshes, replaced by the submeshes of the --scene file
+    MESH_TRIANGLE = 0,
+    MESH_QUAD     = 1,
+    MESH_COUNT
+};
+
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3u;
+constexpr uint32_t CULL_GROUP_SIZE = 64u; // local_size_x of shaders/cull.comp
+
+constexpr VkIndexType INDEX_TYPES[MESH_FILE_INDEX_TYPE_COUNT] = {VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32};
+
+// Vertex format of BUFFER_VERTEX: PositionFloat32 (12 bytes), PositionHalf or PositionSnorm16 (8 bytes)
+using SceneVertex = VertexLayout<PositionSnorm16>;
+
+// Range of a mesh in BUFFER_VERTEX / BUFFER_INDEX and its bounding circle. Also uploaded to BUFFER_MESHES,
+// the layout matches Mesh in shaders/cull.comp.
+struct Mesh
+{
+    float center[2];
+    float radius;
+    int32_t vertex_offset;
+    uint32_t index_type;            // MESH_FILE_INDEX_TYPE_*
+    uint32_t first_index;           // Into the index_type region of BUFFER_INDEX
+    uint32_t index_count;
+    uint32_t draw_idx;              // Of the mesh's instanced draw in BUFFER_DRAW_COMMANDS
+};
+
+// Per object data in BUFFER_DRAW_RECORDS and per instance vertex input of PIPELINE_DEFAULT (binding 1, see
+// shaders/default.vert). The layout matches DrawRecord in shaders/cull.comp.
+struct DrawRecord
+{
+    float offset[2];
+    float scale;
+    uint32_t color;                 // RGBA8
+    uint32_t mesh_idx;
+    uint32_t pad;
+};
+
+// Objects of one mesh, they are contiguous in BUFFER_DRAW_RECORDS and drawn with a single instanced draw
+struct Batch
+{
+    uint32_t first_object;
+    uint32_t object_count;
+};
+
+// Push constants of PIPELINE_DEFAULT, per draw. Draws of a single object (--no-instancing) push its DrawRecord
+// fields instead of fetching them as instance attributes, instanced draws push per_draw = 0.
+struct DrawParams
+{
+    float offset[2];
+    float scale;
+    uint32_t color;                 // RGBA8
+    uint32_t per_draw;
+};
+
+// Orthographic 2D camera, a per-frame uniform slice bound to set 0 of PIPELINE_DEFAULT. Clip space is
+// (world - position) * zoom. std140 compatible.
+struct Camera
+{
+    float position[2];
+    float zoom;
+    float pad;
+};
+
+// Input to present latency of the last LATENCY_SAMPLE_COUNT frames that had input. An input event is
+// reflected by the first frame recorded after it was polled, its latency ends when that frame's
+// vkQueuePresentKHR call returns.
+constexpr uint32_t LATENCY_SAMPLE_COUNT = 128u;
+
+struct LatencyStats
+{
+    float samples_ms[LATENCY_SAMPLE_COUNT];
+    uint32_t count;
+    uint32_t next;                  // Ring buffer position of the next sample
+};
+
+// Push constants of PIPELINE_CULL. xyz of a plane is its normal pointing into the view volume, w the distance.
+struct CullParams
+{
+    float frustum_planes[6][4];
+    uint32_t object_count;
+};
+
 VulkanManager g_vk;
 
+// Everything a single frame in flight records into / synchronizes with. A slot is only reused
+// once its FENCE_SUBMIT has signaled, so the CPU can record frame N+1 while the GPU runs frame N.
+struct Frame
+{
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkCommandBuffer gui_command_buffer;     // Secondary, only used when recording on worker threads
+
+    VkSemaphore semaphore[SEMAPHORE_COUNT];
+    VkFence fence[FENCE_COUNT];
+
+    // Uploader timeline value the submission waits on, 0 if nothing has been acquired yet
+    UploadTicket upload_wait_ticket;
+
+    // BUFFER_DRAW_COMMANDS is copied here by the frame's Cull Readback pass and read back once its fence has signaled
+    VkBuffer cull_readback_buffer;
+    Allocation cull_readback_allocation;
+
+    // Sets only used by this frame's command buffers
+    DescriptorAllocator descriptor_allocator;
+
+    // Allocated from descriptor_allocator once at init. A dynamic uniform buffer over the frame's region of
+    // uniform_allocator, the slice is picked by the dynamic offset, so it is written only once.
+    VkDescriptorSet frame_descriptor_set;
+    // Points at the render graph's transients. A swapchain recreation replaces them while older frames still use
+    // the previous ones, so it is rewritten after the fence wait. VK_NULL_HANDLE with --direct-draws.
+    VkDescriptorSet cull_descriptor_set;
+    uint64_t cull_descriptor_generation;    // VulkanApp::graph_generation cull_descriptor_set points at, 0 if none
+    uint32_t camera_offset;                 // Dynamic offset of the frame's Camera slice
+
+    uint64_t frame_number;                  // Last frame recorded in this slot, 0 if none
+};
+
 struct VulkanApp
 {
+    // With dynamic rendering there is no render pass and there are no framebuffers, pipelines only know the
+    // attachment formats
+    bool dynamic_rendering;
     VkRenderPass renderpass[RENDERPASS_COUNT];
-    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkFramebuffer> framebuffers;    // Created by build_render_graph(), they reference its transients
+
+    std::vector<VkPresentModeKHR> present_modes;   // Supported by the surface
+
+    VkSampleCountFlagBits samples;  // Of the scene, resolved into the swapchain image if more than 1
+    VkFormat depth_format;          // VK_FORMAT_UNDEFINED without --depth
 
     VkPipeline pipeline[PIPELINE_COUNT];
+    VkPipelineCache pipeline_cache;
+    ShaderArchive shader_archive;
+    bool pipeline_cache_warm;       // The cache was loaded from disk
+    float pipeline_creation_ms;     // All pipelines, including the ImGui ones
     VkPipelineLayout pipeline_layout[PIPELINE_COUNT];
 
+    DescriptorLayoutCache descriptor_layout_cache;
+    VkDescriptorSetLayout descriptor_set_layout[DESCRIPTOR_SET_LAYOUT_COUNT]; // Owned by descriptor_layout_cache
+    VkDescriptorPool imgui_descriptor_pool;
+
     VkCommandPool command_pool[COMMAND_POOL_COUNT];
     VkCommandBuffer command_buffer[COMMAND_BUFFER_COUNT];
 
-    VkSemaphore semaphore[SEMAPHORE_COUNT];
-    VkFence fence[FENCE_COUNT];
+    Frame frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t frame_idx = 0u;
+    uint64_t frame_number = 0u;     // Of the last recorded frame, see DeletionQueue
 
-    VkDescriptorPool descriptor_pool[DESCRIPTOR_POOL_COUNT];
+    DeviceAllocator allocator;
+    Uploader uploader;
+    DeletionQueue deletion_queue;
+    UniformAllocator uniform_allocator;
 
     VkBuffer buffer[BUFFER_COUNT];
-    VkDeviceMemory buffer_memory[BUFFER_COUNT];
-    uint32_t index_count[BUFFER_COUNT];
+    Allocation buffer_allocation[BUFFER_PERSISTENT_COUNT];
+    UploadTicket scene_upload_ticket;
+    bool scene_ready;               // The scene upload has been acquired by the frame being recorded
+
+    RenderGraph render_graph;       // Built once by build_render_graph(), rebuilt by recreate_swapchain()
+    uint64_t graph_generation = 1u; // Bumped by recreate_swapchain()
+    RenderGraphResource graph_buffer[BUFFER_COUNT];
+    RenderGraphResource graph_cull_readback;
+    RenderGraphResource graph_color;
+    RenderGraphResource graph_msaa_color;
+    RenderGraphResource graph_depth;
+
+    std::vector<Mesh> meshes;       // One per submesh
+    uint32_t index_counts[MESH_FILE_INDEX_TYPE_COUNT];
+    VkDeviceSize index_offsets[MESH_FILE_INDEX_TYPE_COUNT]; // Of each index type's region in BUFFER_INDEX
+    std::vector<DrawRecord> objects;
+    std::vector<Batch> batches;     // One per mesh
+    uint32_t draw_offsets[MESH_FILE_INDEX_TYPE_COUNT]; // First draw command of each index type's meshes
+    uint32_t draw_counts[MESH_FILE_INDEX_TYPE_COUNT];
+
+    // Of the last frame that has finished on the GPU
+    uint32_t visible_count;
+    uint32_t visible_draw_count;    // Draws with at least one instance
 
     uint32_t current_swapchain_image_idx = 0u;
+
+    Profiler profiler;
+
+    ThreadPool thread_pool;
+    CommandRecorder command_recorder;
 } g_vk_app;
 
 struct AppManager
@@ -97,12 +293,106 @@ struct AppManager
     uint32_t window_width = 500;
     uint32_t window_height = 500;
 
+    // 1 .. MAX_FRAMES_IN_FLIGHT, set with --frames-in-flight
+    uint32_t frames_in_flight = 2u;
+
+    // Render into offscreen images without a window, surface or swapchain
+    bool headless = false;
+    // 0 = run until the window is closed
+    uint64_t max_frames = 0u;
+
+    // Run warmup_frames + bench_frames frames and write frame timings as JSON
+    bool bench = false;
+    uint32_t warmup_frames = 100u;
+    uint32_t bench_frames = 1000u;
+    // Not stdout by default, LOG writes there and would break the JSON
+    const char* bench_output = "bench.json";
+
+    const char* pipeline_cache_path = "pipeline_cache.bin";
+
+    // 0 uses one worker thread per hardware thread, set with --threads
+    uint32_t worker_threads = 0u;
+
+    // Size of the uploader's staging ring in bytes, set in KB with --staging-size
+    VkDeviceSize staging_size = UPLOADER_DEFAULT_STAGING_SIZE;
+
+    // Number of secondary command buffers the scene is recorded into on worker threads, 0 records
+    // everything inline into the frame's primary command buffer. Set with --record-threads
+    uint32_t record_threads = 0u;
+
+    // Number of objects drawn, laid out on a grid. Set with --objects
+    uint32_t object_count = 1u;
+
+    // Issue one instanced vkCmdDrawIndexed per mesh from the CPU instead of the culled indirect draws,
+    // set with --direct-draws
+    bool direct_draws = false;
+
+    // Draw every object of --direct-draws with its own vkCmdDrawIndexed, set with --no-instancing
+    bool no_instancing = false;
+
+    // Samples per pixel, set with --msaa. Lowered to the highest count the device supports.
+    VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Draw with a depth buffer and depth test, set with --depth
+    bool depth = false;
+
+    // Use a render pass and framebuffers even if VK_KHR_dynamic_rendering is supported, set with --no-dynamic-rendering
+    bool no_dynamic_rendering = false;
+
+    // .mesh file written by tools/mesh_import, set with --scene
+    const char* scene_path = nullptr;
+
+    Camera camera{.position = {0.0f, 0.0f}, .zoom = 1.0f, .pad = 0.0f};
+
     bool render_gui = true;
+
+    // Index or part of the name of the physical device, set with --device. See DEVICE_OVERRIDE_ENV.
+    const char* device_override = nullptr;
+
+    // Set with --present-mode and in the Presentation panel of the GUI
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+    // The window was resized or present_mode changed, the swapchain is recreated before the next frame
+    bool swapchain_dirty = false;
+
+    // Earliest input event not yet polled into a frame
+    bool input_pending = false;
+    std::chrono::steady_clock::time_point input_time;
+
+    LatencyStats latency{};
 } g_app;
 
+const char* present_mode_name(VkPresentModeKHR present_mode)
+{
+    switch (present_mode)
+    {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "fifo_relaxed";
+        default:
+            return "unknown";
+    }
+}
+
+void record_input()
+{
+    if (g_app.input_pending)
+        return;
+
+    g_app.input_pending = true;
+    g_app.input_time = std::chrono::steady_clock::now();
+}
+
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    record_input();
+
     switch (key)
     {
         case GLFW_KEY_ESCAPE:
@@ -114,7 +404,122 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     };
 }
 
-void gui()
+// ImGui chains to these, they are installed before init_gui()
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    record_input();
+}
+
+void cursor_pos_callback(GLFWwindow* window, double x, double y)
+{
+    record_input();
+}
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    g_app.swapchain_dirty = true;
+}
+
+void presentation_gui()
+{
+    if (!ImGui::CollapsingHeader("Presentation"))
+        return;
+
+    ImGui::Text("%ux%u, %zu images", g_vk.swapchain_extent.width, g_vk.swapchain_extent.height, g_vk.swapchain_images.size());
+
+    if (g_vk_app.dynamic_rendering)
+        ImGui::TextUnformatted("Dynamic rendering, no render passes or framebuffers");
+    else
+        ImGui::Text("%u render pass, %zu framebuffers", static_cast<uint32_t>(RENDERPASS_COUNT), g_vk_app.framebuffers.size());
+
+    if (ImGui::BeginCombo("Present Mode", present_mode_name(g_vk.present_mode)))
+    {
+        for (VkPresentModeKHR present_mode : g_vk_app.present_modes)
+        {
+            if (ImGui::Selectable(present_mode_name(present_mode), present_mode == g_vk.present_mode) && present_mode != g_vk.present_mode)
+            {
+                g_app.present_mode = present_mode;
+                g_app.swapchain_dirty = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    const LatencyStats& latency = g_app.latency;
+    if (latency.count == 0u)
+    {
+        ImGui::TextUnformatted("Input to present: move the mouse");
+        return;
+    }
+
+    float sum = 0.0f;
+    float max = 0.0f;
+    for (uint32_t i = 0; i < latency.count; ++i)
+    {
+        sum += latency.samples_ms[i];
+        max = std::max(max, latency.samples_ms[i]);
+    }
+
+    const float last = latency.samples_ms[(latency.next + LATENCY_SAMPLE_COUNT - 1u) % LATENCY_SAMPLE_COUNT];
+    ImGui::Text("Input to present: %.2f ms, avg %.2f ms, max %.2f ms", last, sum / latency.count, max);
+
+    // Oldest sample first once the ring buffer has wrapped
+    const uint32_t offset = (latency.count == LATENCY_SAMPLE_COUNT) ? latency.next : 0u;
+    ImGui::PlotLines("##latency", latency.samples_ms, static_cast<int>(latency.count), static_cast<int>(offset), nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 48.0f));
+}
+
+void culling_gui()
+{
+    if (!ImGui::CollapsingHeader("Culling"))
+        return;
+
+    const uint32_t object_count = static_cast<uint32_t>(g_vk_app.objects.size());
+
+    if (g_app.direct_draws)
+    {
+        ImGui::Text("%u objects, not culled (--direct-draws)", object_count);
+        ImGui::Text("Draws: %u", g_app.no_instancing ? object_count : static_cast<uint32_t>(g_vk_app.batches.size()));
+    }
+    else
+    {
+        ImGui::Text("Visible: %u", g_vk_app.visible_count);
+        ImGui::Text("Culled: %u", object_count - std::min(g_vk_app.visible_count, object_count));
+        ImGui::Text("Draws: %u", g_vk_app.visible_draw_count);
+    }
+
+    ImGui::DragFloat2("Camera", g_app.camera.position, 0.01f);
+    ImGui::SliderFloat("Zoom", &g_app.camera.zoom, 0.25f, 16.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+}
+
+void deletion_queue_gui()
+{
+    if (!ImGui::CollapsingHeader("Deletion Queue"))
+        return;
+
+    const DeletionQueue& queue = g_vk_app.deletion_queue;
+    ImGui::Text("Frame %llu, completed %llu", static_cast<unsigned long long>(queue.current_frame), static_cast<unsigned long long>(queue.completed_frame));
+    ImGui::Text("%zu retired, %u destroyed this frame", queue.resources.size(), queue.destroyed_count);
+}
+
+void descriptors_gui()
+{
+    if (!ImGui::CollapsingHeader("Descriptors"))
+        return;
+
+    for (uint32_t i = 0; i < g_app.frames_in_flight; ++i)
+    {
+        const DescriptorAllocator& allocator = g_vk_app.frames[i].descriptor_allocator;
+        ImGui::Text("Frame %u: %u sets in %u pools", i, allocator.live_set_count, descriptor_allocator_pool_count(allocator));
+    }
+
+    ImGui::Text("Set layouts: %zu", g_vk_app.descriptor_layout_cache.layouts.size());
+
+    const UniformAllocator& uniforms = g_vk_app.uniform_allocator;
+    ImGui::Text("Uniforms: %llu of %llu bytes per frame, peak %llu", static_cast<unsigned long long>(uniforms.head), static_cast<unsigned long long>(uniforms.frame_size),
+                static_cast<unsigned long long>(uniforms.peak));
+}
+
+void gui(VkCommandBuffer cmd_buff)
 {
     // Start the Dear ImGui frame
     ImGui_ImplVulkan_NewFrame();
@@ -123,102 +528,1096 @@ void gui()
 
     if (ImGui::Begin("Gui"))
     {
-
+        profiler_gui(g_vk_app.profiler);
+        presentation_gui();
+        allocator_gui(g_vk_app.allocator);
+        deletion_queue_gui();
+        render_graph_gui(g_vk_app.render_graph);
+        culling_gui();
+        descriptors_gui();
     }
     ImGui::End();
 
     ImGui::Render();
     ImDrawData* draw_data = ImGui::GetDrawData();
-    ImGui_ImplVulkan_RenderDrawData(draw_data, g_vk_app.command_buffer[COMMAND_BUFFER_RENDER]);
+    ImGui_ImplVulkan_RenderDrawData(draw_data, cmd_buff);
+}
+
+// The first format that can be a depth attachment, D16_UNORM always can
+VkFormat find_depth_format()
+{
+    const VkFormat candidates[3] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM};
+
+    for (VkFormat format : candidates)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(g_vk.physical_device, format, &properties);
+
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return format;
+    }
+
+    return VK_FORMAT_D16_UNORM;
 }
 
 void init()
 {
     const VulkanInitParams vk_init_params{
+        .headless = g_app.headless,
         .window = g_app.window,
         .window_width = g_app.window_width,
         .window_height = g_app.window_height,
-        .instance_extensions = {"VK_KHR_surface", "VK_KHR_xcb_surface"},
+        .instance_extensions = g_app.headless ? std::vector<const char*>{} : std::vector<const char*>{"VK_KHR_surface", "VK_KHR_xcb_surface"},
         .instance_layers = {"VK_LAYER_KHRONOS_validation"},
-        .device_extension_ids = {DEVICE_EXT_SWAPCHAIN, DEVICE_EXT_SYNC_2},
-        .queue_flags = {VK_QUEUE_GRAPHICS_BIT},
-        .swapchain_image_count = 2u,
+        .device_extension_ids = g_app.headless ? std::vector<uint32_t>{DEVICE_EXT_SYNC_2, DEVICE_EXT_TIMELINE_SEMAPHORE, DEVICE_EXT_MULTI_DRAW_INDIRECT}
+                                                : std::vector<uint32_t>{DEVICE_EXT_SWAPCHAIN, DEVICE_EXT_SYNC_2, DEVICE_EXT_TIMELINE_SEMAPHORE, DEVICE_EXT_MULTI_DRAW_INDIRECT},
+        .optional_device_extension_ids = g_app.no_dynamic_rendering ? std::vector<uint32_t>{} : std::vector<uint32_t>{DEVICE_EXT_DYNAMIC_RENDERING},
+        .queue_flags = {VK_QUEUE_GRAPHICS_BIT, VK_QUEUE_TRANSFER_BIT},
+        .device_override = g_app.device_override,
+        .swapchain_image_count = std::max(2u, g_app.frames_in_flight),
         .swapchain_format = VK_FORMAT_R8G8B8A8_SRGB,
-        .swapchain_present_mode = VK_PRESENT_MODE_FIFO_KHR};
+        .swapchain_present_mode = g_app.present_mode};
 
     g_vk = vulkan_init(vk_init_params);
+    g_vk_app.present_modes = get_present_modes(g_vk);
+
+    // Backends without IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING can only draw into a render pass
+    g_vk_app.dynamic_rendering = (g_vk.vkCmdBeginRenderingKHR != nullptr);
+#ifndef IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING
+    g_vk_app.dynamic_rendering = g_vk_app.dynamic_rendering && g_app.headless;
+#endif
+    LOG("Rendering: %s\n", g_vk_app.dynamic_rendering ? "dynamic" : "render pass");
+
+    g_vk_app.allocator = create_allocator(g_vk.device, g_vk.physical_device_properties, g_vk.physical_device_memory_properties);
+    g_vk_app.uploader = create_uploader(g_vk, g_vk_app.allocator, g_vk.queue_family_indices[QUEUE_TRANSFER], g_vk.queues[QUEUE_TRANSFER], g_vk.queue_family_indices[QUEUE_GRAPHICS], g_app.staging_size);
+    g_vk_app.deletion_queue = create_deletion_queue(g_vk.device, g_vk_app.allocator);
+    g_vk_app.uniform_allocator = create_uniform_allocator(g_vk.device, g_vk_app.allocator, g_vk.physical_device_properties.limits, g_app.frames_in_flight);
+
+    // Samples and depth format
+    {
+        const VkPhysicalDeviceLimits& limits = g_vk.physical_device_properties.limits;
+        const VkSampleCountFlags supported = limits.framebufferColorSampleCounts & (g_app.depth ? limits.framebufferDepthSampleCounts : ~0u);
+
+        g_vk_app.samples = g_app.msaa_samples;
+        while ((supported & g_vk_app.samples) == 0u)
+            g_vk_app.samples = static_cast<VkSampleCountFlagBits>(g_vk_app.samples >> 1);
+
+        if (g_vk_app.samples != g_app.msaa_samples)
+        {
+            LOG("%ux MSAA is not supported, using %ux\n", static_cast<uint32_t>(g_app.msaa_samples), static_cast<uint32_t>(g_vk_app.samples));
+        }
+
+        g_vk_app.depth_format = g_app.depth ? find_depth_format() : VK_FORMAT_UNDEFINED;
+    }
 
     // create renderpasses
+    if (!g_vk_app.dynamic_rendering)
     {
-        const VkAttachmentDescription attachments[1]{
-            {
-                // Color
+        // The scene is drawn into the multisampled color attachment, which is resolved into the swapchain image
+        // at the end of the subpass. Multisampled color and depth are cleared and never stored, so tile based
+        // GPUs keep them in tile memory and only the resolved pixels are ever written out.
+        const bool msaa = (g_vk_app.samples != VK_SAMPLE_COUNT_1_BIT);
+        const bool depth = (g_vk_app.depth_format != VK_FORMAT_UNDEFINED);
+
+        VkAttachmentDescription attachments[3];
+        uint32_t attachment_count = 0u;
+
+        // The render graph transitions the images around the render pass
+        attachments[attachment_count++] = VkAttachmentDescription{
+            // Swapchain color, resolve target with MSAA
+            .format = g_vk.swapchain_format,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = msaa ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        };
+
+        const VkAttachmentReference swapchain_reference{
+            .attachment = 0,
+            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+        VkAttachmentReference color_reference = swapchain_reference;
+        if (msaa)
+        {
+            color_reference.attachment = attachment_count;
+            attachments[attachment_count++] = VkAttachmentDescription{
+                // Multisampled color
                 .format = g_vk.swapchain_format,
-                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .samples = g_vk_app.samples,
                 .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
                 .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-            }};
+                .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            };
+        }
+
+        VkAttachmentReference depth_reference{
+            .attachment = VK_ATTACHMENT_UNUSED,
+            .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+        if (depth)
+        {
+            depth_reference.attachment = attachment_count;
+            attachments[attachment_count++] = VkAttachmentDescription{
+                // Depth
+                .format = g_vk_app.depth_format,
+                .samples = g_vk_app.samples,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            };
+        }
+
+        const VkSubpassDescription subpass{
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .inputAttachmentCount = 0,
+            .pInputAttachments = nullptr,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &color_reference,
+            .pResolveAttachments = msaa ? &swapchain_reference : nullptr,
+            .pDepthStencilAttachment = depth ? &depth_reference : nullptr,
+            .preserveAttachmentCount = 0,
+            .pPreserveAttachments = nullptr};
+
+        const VkRenderPassCreateInfo renderpass_create_info{
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .attachmentCount = attachment_count,
+            .pAttachments = attachments,
+            .subpassCount = 1,
+            .pSubpasses = &subpass,
+            .dependencyCount = 0,
+            .pDependencies = nullptr};
+
+        VK_CHECK(vkCreateRenderPass(g_vk.device, &renderpass_create_info, nullptr, &g_vk_app.renderpass[RENDERPASS_DEFAULT]));
+    }
+
+    // create descriptor set layouts
+    {
+        // Draw records, meshes, draw commands, instances
+        VkDescriptorSetLayoutBinding cull_bindings[4];
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            cull_bindings[i] = VkDescriptorSetLayoutBinding{
+                .binding = i,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr};
+        }
+
+        g_vk_app.descriptor_layout_cache = create_descriptor_layout_cache(g_vk.device);
+        g_vk_app.descriptor_set_layout[DESCRIPTOR_SET_LAYOUT_CULL] = descriptor_layout_cache_get(g_vk_app.descriptor_layout_cache, cull_bindings, 4);
+
+        // Camera
+        const VkDescriptorSetLayoutBinding frame_binding{
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .pImmutableSamplers = nullptr};
+
+        g_vk_app.descriptor_set_layout[DESCRIPTOR_SET_LAYOUT_FRAME] = descriptor_layout_cache_get(g_vk_app.descriptor_layout_cache, &frame_binding, 1);
+    }
+
+    // create pipeline layouts
+    {
+        const VkPushConstantRange draw_params_range{
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(DrawParams)};
+
+        const VkPipelineLayoutCreateInfo pipeline_layout_create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &g_vk_app.descriptor_set_layout[DESCRIPTOR_SET_LAYOUT_FRAME],
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &draw_params_range,
+        };
+
+        VK_CHECK(vkCreatePipelineLayout(g_vk.device, &pipeline_layout_create_info, nullptr, &g_vk_app.pipeline_layout[PIPELINE_DEFAULT]));
+
+        const VkPushConstantRange cull_params_range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(CullParams)};
+
+        const VkPipelineLayoutCreateInfo cull_layout_create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &g_vk_app.descriptor_set_layout[DESCRIPTOR_SET_LAYOUT_CULL],
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &cull_params_range,
+        };
+
+        VK_CHECK(vkCreatePipelineLayout(g_vk.device, &cull_layout_create_info, nullptr, &g_vk_app.pipeline_layout[PIPELINE_CULL]));
+    }
+
+    // create worker threads, shader archive and pipeline cache
+    {
+        thread_pool_start(g_vk_app.thread_pool, g_app.worker_threads);
+
+        // Generated at build time next to the binary, so the app runs from any working directory
+        g_vk_app.shader_archive = create_shader_archive(g_vk.device, (get_executable_dir() + "/shaders.pak").c_str());
+
+        g_vk_app.pipeline_cache = create_pipeline_cache(g_vk.device, g_vk.physical_device_properties, g_app.pipeline_cache_path, &g_vk_app.pipeline_cache_warm);
+    }
+
+    // create pipelines
+    {
+        const auto pipeline_creation_begin = std::chrono::steady_clock::now();
+
+        PipelineBuilder pipeline_builder = create_pipeline_builder(g_vk.device, g_vk_app.thread_pool, g_vk_app.shader_archive, g_vk_app.pipeline_cache);
+
+        // Per instance offset and scale, color
+        std::vector<VkVertexInputAttributeDescription> default_vertex_attributes = vertex_attribute_descriptions<SceneVertex>(0);
+        default_vertex_attributes.push_back({.location = 1, .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(DrawRecord, offset)});
+        default_vertex_attributes.push_back({.location = 2, .binding = 1, .format = VK_FORMAT_R8G8B8A8_UNORM, .offset = offsetof(DrawRecord, color)});
+
+        const GraphicsPipelineDesc default_desc{
+            .vertex_shader = "default.vert",
+            .fragment_shader = "default.frag",
+            .vertex_bindings = {vertex_binding_description<SceneVertex>(0),
+                                {.binding = 1,
+                                 .stride = sizeof(DrawRecord),
+                                 .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE}},
+            .vertex_attributes = default_vertex_attributes,
+            .samples = g_vk_app.samples,
+            .depth_test = (g_vk_app.depth_format != VK_FORMAT_UNDEFINED),
+            .layout = g_vk_app.pipeline_layout[PIPELINE_DEFAULT],
+            .renderpass = g_vk_app.renderpass[RENDERPASS_DEFAULT],
+            .color_format = g_vk.swapchain_format,
+            .depth_format = g_vk_app.depth_format,
+        };
+
+        const ComputePipelineDesc cull_desc{
+            .compute_shader = "cull.comp",
+            .layout = g_vk_app.pipeline_layout[PIPELINE_CULL],
+        };
+
+        std::shared_future<VkPipeline> pipelines[PIPELINE_COUNT];
+        pipelines[PIPELINE_DEFAULT] = pipeline_builder_enqueue(pipeline_builder, default_desc);
+        pipelines[PIPELINE_CULL] = pipeline_builder_enqueue(pipeline_builder, cull_desc);
+
+        for (uint32_t i = 0; i < PIPELINE_COUNT; ++i)
+            g_vk_app.pipeline[i] = pipelines[i].get();
+
+        pipeline_builder_finish(pipeline_builder);
+
+        g_vk_app.pipeline_creation_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pipeline_creation_begin).count();
+    }
+
+    // Command Pools / Buffers
+    {
+        g_vk_app.command_pool[COMMAND_POOL_DEFAULT] = create_command_pool(g_vk.device, g_vk.queue_family_indices[QUEUE_GRAPHICS]);
+        g_vk_app.command_buffer[COMMAND_BUFFER_UPLOAD] = create_command_buffer(g_vk.device, g_vk_app.command_pool[COMMAND_POOL_DEFAULT]);
+    }
+
+    // Frames in flight
+    {
+        for (uint32_t i = 0; i < g_app.frames_in_flight; ++i)
+        {
+            Frame& frame = g_vk_app.frames[i];
+
+            frame.command_pool = create_command_pool(g_vk.device, g_vk.queue_family_indices[QUEUE_GRAPHICS]);
+            frame.command_buffer = create_command_buffer(g_vk.device, frame.command_pool);
+            frame.gui_command_buffer = create_command_buffer(g_vk.device, frame.command_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+            for (uint32_t j = 0; j < SEMAPHORE_COUNT; ++j)
+                frame.semaphore[j] = create_semaphore(g_vk.device);
+
+            // Created signaled so the first wait on each slot falls through
+            frame.fence[FENCE_SUBMIT] = create_fence(g_vk.device, true);
+
+            frame.upload_wait_ticket = 0u;
+        }
+
+        g_vk_app.command_recorder = create_command_recorder(g_vk.device, g_vk_app.thread_pool, g_vk.queue_family_indices[QUEUE_GRAPHICS], g_app.frames_in_flight);
+    }
+
+    // Profiler
+    {
+        g_vk_app.profiler = create_profiler(g_vk, g_vk.queue_family_indices[QUEUE_GRAPHICS], g_app.frames_in_flight);
+    }
+
+    // Descriptor Pools / Sets
+    {
+        // ImGui only allocates the set of its font atlas (and one per ImGui_ImplVulkan_AddTexture, which is
+        // not used), which it frees again on shutdown
+        const VkDescriptorPoolSize imgui_pool_size{
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1};
+
+        const VkDescriptorPoolCreateInfo imgui_pool_create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = &imgui_pool_size,
+        };
+
+        VK_CHECK(vkCreateDescriptorPool(g_vk.device, &imgui_pool_create_info, nullptr, &g_vk_app.imgui_descriptor_pool));
+
+        // A frame has a cull set of 4 storage buffers and a frame set of a single dynamic uniform buffer
+        const std::vector<DescriptorPoolRatio> frame_pool_ratios{
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f}};
+
+        for (uint32_t i = 0; i < g_app.frames_in_flight; ++i)
+        {
+            Frame& frame = g_vk_app.frames[i];
+            frame.descriptor_allocator = create_descriptor_allocator(g_vk.device, 2u, frame_pool_ratios);
+
+            // The cull set is written by render() once the render graph exists
+            frame.frame_descriptor_set = descriptor_allocator_allocate(frame.descriptor_allocator, g_vk_app.descriptor_set_layout[DESCRIPTOR_SET_LAYOUT_FRAME]);
+            frame.cull_descriptor_set = g_app.direct_draws ? VK_NULL_HANDLE
+                                                           : descriptor_allocator_allocate(frame.descriptor_allocator, g_vk_app.descriptor_set_layout[DESCRIPTOR_SET_LAYOUT_CULL]);
+            frame.cull_descriptor_generation = 0u;
+
+            const VkDescriptorBufferInfo frame_buffer_info = uniform_allocator_descriptor_info(g_vk_app.uniform_allocator, i);
+
+            const VkWriteDescriptorSet frame_write{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = nullptr,
+                .dstSet = frame.frame_descriptor_set,
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .pImageInfo = nullptr,
+                .pBufferInfo = &frame_buffer_info,
+                .pTexelBufferView = nullptr};
+
+            vkUpdateDescriptorSets(g_vk.device, 1, &frame_write, 0, nullptr);
+        }
+    }
+
+    // create scene
+    {
+        // Used unless a .mesh file is given with --scene
+        static const MeshFileVertex builtin_vertices[7]{
+            // MESH_TRIANGLE
+            {-0.5f,  0.5f, 0.0f},
+            { 0.5f,  0.5f, 0.0f},
+            { 0.0f, -0.5f, 0.0f},
+            // MESH_QUAD
+            {-0.4f, -0.4f, 0.0f},
+            { 0.4f, -0.4f, 0.0f},
+            { 0.4f,  0.4f, 0.0f},
+            {-0.4f,  0.4f, 0.0f}};
+
+        static const uint16_t builtin_indices[9]{
+            // MESH_TRIANGLE
+            0, 1, 2,
+            // MESH_QUAD
+            0, 1, 2, 2, 3, 0};
+
+        static const MeshFileSubmesh builtin_submeshes[MESH_COUNT]{
+            {.vertex_offset = 0, .vertex_count = 3, .index_type = MESH_FILE_INDEX_TYPE_UINT16, .first_index = 0, .index_count = 3},
+            {.vertex_offset = 3, .vertex_count = 4, .index_type = MESH_FILE_INDEX_TYPE_UINT16, .first_index = 3, .index_count = 6}};
+
+        MeshFile mesh_file{};
+        std::vector<MeshFileQuantizedVertex> quantized_vertices;
+        std::vector<uint8_t> indices[MESH_FILE_INDEX_TYPE_COUNT]{
+            {reinterpret_cast<const uint8_t*>(builtin_indices), reinterpret_cast<const uint8_t*>(builtin_indices + 9)},
+            {}};
+        uint32_t index_counts[MESH_FILE_INDEX_TYPE_COUNT] = {9u, 0u};
+        const MeshFileSubmesh* submeshes = builtin_submeshes;
+        uint32_t submesh_count = MESH_COUNT;
+
+        MeshFileBounds builtin_bounds[MESH_COUNT];
+        for (uint32_t i = 0; i < MESH_COUNT; ++i)
+            builtin_bounds[i] = mesh_file_compute_bounds(&builtin_vertices[builtin_submeshes[i].vertex_offset], builtin_submeshes[i].vertex_count);
+        const MeshFileBounds* bounds = builtin_bounds;
+
+        if (g_app.scene_path != nullptr)
+        {
+            mesh_file = create_mesh_file(g_app.scene_path);
+
+            const auto decode_begin = std::chrono::steady_clock::now();
+
+            quantized_vertices.resize(mesh_file.header->vertex_count);
+            mesh_file_decode_vertices(mesh_file, quantized_vertices.data());
+
+            for (uint32_t i = 0; i < MESH_FILE_INDEX_TYPE_COUNT; ++i)
+            {
+                index_counts[i] = mesh_file.header->index_counts[i];
+                indices[i].resize(static_cast<size_t>(index_counts[i]) * MESH_FILE_INDEX_SIZE[i]);
+                mesh_file_decode_indices(mesh_file, i, indices[i].data());
+            }
+
+            const std::chrono::duration<double, std::milli> decode_time = std::chrono::steady_clock::now() - decode_begin;
+            LOG("Mesh File: decoded in %.2f ms (%s)\n", decode_time.count(), stream_codec_decoder_name());
+
+            submeshes = mesh_file.submeshes;
+            submesh_count = mesh_file.header->submesh_count;
+            bounds = mesh_file.bounds;
+        }
+        else
+        {
+            for (const MeshFileVertex& vertex : builtin_vertices)
+                quantized_vertices.push_back(mesh_file_quantize_vertex(vertex));
+        }
+
+        const uint32_t vertex_count = static_cast<uint32_t>(quantized_vertices.size());
+        std::vector<SceneVertex> vertices(vertex_count);
+        encode_vertices(quantized_vertices.data(), vertex_count, vertices.data());
+
+        // Every submesh is drawn on its own, all of them share one vertex and one index buffer
+        g_vk_app.meshes.resize(submesh_count);
+        for (uint32_t i = 0; i < submesh_count; ++i)
+        {
+            g_vk_app.meshes[i] = Mesh{
+                .center = {bounds[i].center[0], bounds[i].center[1]},
+                .radius = bounds[i].radius,
+                .vertex_offset = submeshes[i].vertex_offset,
+                .index_type = submeshes[i].index_type,
+                .first_index = submeshes[i].first_index,
+                .index_count = submeshes[i].index_count,
+                .draw_idx = 0u};
+        }
+
+        // 16 bit indices take half the memory and index fetch bandwidth, both regions share BUFFER_INDEX.
+        // The 32 bit region stays 4 byte aligned as vkCmdBindIndexBuffer requires.
+        VkDeviceSize index_buffer_size = 0u;
+        for (uint32_t i = 0; i < MESH_FILE_INDEX_TYPE_COUNT; ++i)
+        {
+            g_vk_app.index_counts[i] = index_counts[i];
+            g_vk_app.index_offsets[i] = (index_buffer_size + 3u) & ~VkDeviceSize{3u};
+            index_buffer_size = g_vk_app.index_offsets[i] + static_cast<VkDeviceSize>(index_counts[i]) * MESH_FILE_INDEX_SIZE[i];
+        }
+
+        // Square grid of clip space cells, a single object covers the whole viewport
+        const uint32_t grid_size = static_cast<uint32_t>(ceilf(sqrtf(static_cast<float>(g_app.object_count))));
+        const float cell_size = 2.0f / grid_size;
+
+        // A few shades of one color, so neighbouring instances can be told apart
+        const uint32_t palette[4] = {0xff9ead2bu, 0xffb8c94au, 0xff7f8c24u, 0xffd2e07au};
+
+        g_vk_app.objects.resize(g_app.object_count);
+        for (uint32_t i = 0; i < g_app.object_count; ++i)
+        {
+            g_vk_app.objects[i] = DrawRecord{
+                .offset = {-1.0f + cell_size * (i % grid_size + 0.5f), -1.0f + cell_size * (i / grid_size + 0.5f)},
+                .scale = 1.0f / grid_size,
+                .color = palette[(i + i / grid_size) % 4u],
+                .mesh_idx = i % submesh_count,
+                .pad = 0u};
+        }
+
+        // Objects of the same mesh become one batch, drawn with one instanced draw
+        std::stable_sort(g_vk_app.objects.begin(), g_vk_app.objects.end(), [](const DrawRecord& a, const DrawRecord& b) {
+            return a.mesh_idx < b.mesh_idx;
+        });
+
+        g_vk_app.batches.assign(submesh_count, Batch{.first_object = 0u, .object_count = 0u});
+        for (uint32_t i = 0; i < g_app.object_count; ++i)
+        {
+            Batch& batch = g_vk_app.batches[g_vk_app.objects[i].mesh_idx];
+            if (batch.object_count++ == 0u)
+                batch.first_object = i;
+        }
+
+        // The draws of each index type are contiguous, so each type is one multi-draw
+        std::vector<VkDrawIndexedIndirectCommand> batch_draws;
+        batch_draws.reserve(submesh_count);
+        for (uint32_t type = 0; type < MESH_FILE_INDEX_TYPE_COUNT; ++type)
+        {
+            g_vk_app.draw_offsets[type] = static_cast<uint32_t>(batch_draws.size());
+
+            for (uint32_t i = 0; i < submesh_count; ++i)
+            {
+                Mesh& mesh = g_vk_app.meshes[i];
+                if (mesh.index_type != type)
+                    continue;
+
+                mesh.draw_idx = static_cast<uint32_t>(batch_draws.size());
+                batch_draws.push_back(VkDrawIndexedIndirectCommand{
+                    .indexCount = mesh.index_count,
+                    .instanceCount = 0u,
+                    .firstIndex = mesh.first_index,
+                    .vertexOffset = mesh.vertex_offset,
+                    .firstInstance = g_vk_app.batches[i].first_object});
+            }
+
+            g_vk_app.draw_counts[type] = static_cast<uint32_t>(batch_draws.size()) - g_vk_app.draw_offsets[type];
+        }
+
+        g_vk_app.visible_count = 0u;
+        g_vk_app.visible_draw_count = 0u;
+
+        for (uint32_t i = 0; i < g_app.frames_in_flight; ++i)
+        {
+            Frame& frame = g_vk_app.frames[i];
+
+            frame.cull_readback_buffer = create_buffer(g_vk.device, sizeof(VkDrawIndexedIndirectCommand) * batch_draws.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+            frame.cull_readback_allocation = allocator_allocate_buffer(g_vk_app.allocator, frame.cull_readback_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            memcpy(frame.cull_readback_allocation.mapped, batch_draws.data(), sizeof(VkDrawIndexedIndirectCommand) * batch_draws.size());
+        }
+
+        const VkDeviceSize buffer_sizes[BUFFER_PERSISTENT_COUNT]{
+            sizeof(SceneVertex) * vertex_count,
+            index_buffer_size,
+            sizeof(DrawRecord) * g_vk_app.objects.size(),
+            sizeof(Mesh) * g_vk_app.meshes.size(),
+            sizeof(VkDrawIndexedIndirectCommand) * batch_draws.size()};
+
+        const VkBufferUsageFlags buffer_usages[BUFFER_PERSISTENT_COUNT]{
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+
+        for (uint32_t i = 0; i < BUFFER_PERSISTENT_COUNT; ++i)
+        {
+            g_vk_app.buffer[i] = create_buffer(g_vk.device, buffer_sizes[i], buffer_usages[i] | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+            g_vk_app.buffer_allocation[i] = allocator_allocate_buffer(g_vk_app.allocator, g_vk_app.buffer[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+
+        // All copies go out in one transfer submission, the scene is drawn once the graphics queue has acquired them
+        uploader_upload_buffer(g_vk_app.uploader, g_vk_app.buffer[BUFFER_VERTEX], 0, vertices.data(), buffer_sizes[BUFFER_VERTEX],
+                               VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR);
+        for (uint32_t i = 0; i < MESH_FILE_INDEX_TYPE_COUNT; ++i)
+        {
+            if (index_counts[i] > 0u)
+            {
+                uploader_upload_buffer(g_vk_app.uploader, g_vk_app.buffer[BUFFER_INDEX], g_vk_app.index_offsets[i], indices[i].data(), indices[i].size(),
+                                       VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT_KHR, VK_ACCESS_2_INDEX_READ_BIT_KHR);
+            }
+        }
+        uploader_upload_buffer(g_vk_app.uploader, g_vk_app.buffer[BUFFER_DRAW_RECORDS], 0, g_vk_app.objects.data(), buffer_sizes[BUFFER_DRAW_RECORDS],
+                               VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                               VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR);
+        uploader_upload_buffer(g_vk_app.uploader, g_vk_app.buffer[BUFFER_MESHES], 0, g_vk_app.meshes.data(), buffer_sizes[BUFFER_MESHES],
+                               VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR);
+        uploader_upload_buffer(g_vk_app.uploader, g_vk_app.buffer[BUFFER_BATCHES], 0, batch_draws.data(), buffer_sizes[BUFFER_BATCHES],
+                               VK_PIPELINE_STAGE_2_COPY_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR);
+
+        g_vk_app.scene_upload_ticket = uploader_submit(g_vk_app.uploader);
+
+        // Submeshes and bounds have been copied into g_vk_app.meshes, the sections are decoded
+        if (mesh_file.data != nullptr)
+            mesh_file_release(mesh_file);
+    }
+}
+
+// Records objects [first, first + count) of the scene
+void record_scene(VkCommandBuffer cmd_buff, uint32_t first, uint32_t count)
+{
+    const Frame& frame = g_vk_app.frames[g_vk_app.frame_idx];
+
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_GRAPHICS, g_vk_app.pipeline[PIPELINE_DEFAULT]);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_GRAPHICS, g_vk_app.pipeline_layout[PIPELINE_DEFAULT], 0, 1, &frame.frame_descriptor_set, 1,
+                            &frame.camera_offset);
+
+    const VkViewport viewport{
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = static_cast<float>(g_vk.swapchain_extent.width),
+        .height = static_cast<float>(g_vk.swapchain_extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f};
+    const VkRect2D scissor{.offset = {.x = 0, .y = 0}, .extent = g_vk.swapchain_extent};
+    vkCmdSetViewport(cmd_buff, 0, 1, &viewport);
+    vkCmdSetScissor(cmd_buff, 0, 1, &scissor);
+
+    // Binding 1 is the per instance DrawRecord, all objects for direct draws and the visible ones for indirect draws
+    const VkBuffer vertex_buffers[2] = {g_vk_app.buffer[BUFFER_VERTEX], g_vk_app.buffer[g_app.direct_draws ? BUFFER_DRAW_RECORDS : BUFFER_INSTANCES]};
+    const VkDeviceSize offsets[2] = {0, 0};
+    vkCmdBindVertexBuffers(cmd_buff, 0, 2, vertex_buffers, offsets);
+
+    // Instanced draws read everything from the instance attributes, --no-instancing pushes every draw's object below
+    const DrawParams instanced_params{.offset = {0.0f, 0.0f}, .scale = 0.0f, .color = 0u, .per_draw = 0u};
+    vkCmdPushConstants(cmd_buff, g_vk_app.pipeline_layout[PIPELINE_DEFAULT], VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawParams), &instanced_params);
+
+    if (g_app.direct_draws)
+    {
+        // The index buffer is only rebound when the index type changes between consecutive draws
+        uint32_t bound_index_type = MESH_FILE_INDEX_TYPE_COUNT;
+        const auto bind_index_buffer = [&](uint32_t index_type) {
+            if (index_type != bound_index_type)
+            {
+                bound_index_type = index_type;
+                vkCmdBindIndexBuffer(cmd_buff, g_vk_app.buffer[BUFFER_INDEX], g_vk_app.index_offsets[index_type], INDEX_TYPES[index_type]);
+            }
+        };
+
+        if (g_app.no_instancing)
+        {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                const DrawRecord& object = g_vk_app.objects[i];
+                const DrawParams draw_params{
+                    .offset = {object.offset[0], object.offset[1]},
+                    .scale = object.scale,
+                    .color = object.color,
+                    .per_draw = 1u};
+                vkCmdPushConstants(cmd_buff, g_vk_app.pipeline_layout[PIPELINE_DEFAULT], VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawParams), &draw_params);
+
+                // The instance attributes are unused, instance 0 keeps their fetch in cache
+                const Mesh& mesh = g_vk_app.meshes[object.mesh_idx];
+                bind_index_buffer(mesh.index_type);
+                vkCmdDrawIndexed(cmd_buff, mesh.index_count, 1, mesh.first_index, mesh.vertex_offset, 0);
+            }
+        }
+        else
+        {
+            // One instanced draw for the part of each batch inside the range
+            for (size_t i = 0; i < g_vk_app.batches.size(); ++i)
+            {
+                const Batch& batch = g_vk_app.batches[i];
+                const uint32_t begin = std::max(first, batch.first_object);
+                const uint32_t end = std::min(first + count, batch.first_object + batch.object_count);
+                if (begin >= end)
+                    continue;
+
+                const Mesh& mesh = g_vk_app.meshes[i];
+                bind_index_buffer(mesh.index_type);
+                vkCmdDrawIndexed(cmd_buff, mesh.index_count, end - begin, mesh.first_index, mesh.vertex_offset, begin);
+            }
+        }
+    }
+    else
+    {
+        // One instanced draw per mesh, the cull pass has written the instance counts. Draws of meshes
+        // without visible objects have no instances and cost next to nothing.
+        for (uint32_t i = 0; i < MESH_FILE_INDEX_TYPE_COUNT; ++i)
+        {
+            if (g_vk_app.draw_counts[i] == 0u)
+                continue;
+
+            vkCmdBindIndexBuffer(cmd_buff, g_vk_app.buffer[BUFFER_INDEX], g_vk_app.index_offsets[i], INDEX_TYPES[i]);
+            vkCmdDrawIndexedIndirect(cmd_buff, g_vk_app.buffer[BUFFER_DRAW_COMMANDS], g_vk_app.draw_offsets[i] * sizeof(VkDrawIndexedIndirectCommand),
+                                     g_vk_app.draw_counts[i], sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
+
+// The camera's view volume in world space: x and y within 1 / zoom of the camera position, z in [-0.5, 0.5]
+void camera_frustum_planes(const Camera& camera, float planes[6][4])
+{
+    const float half_extent = 1.0f / camera.zoom;
+
+    const float frustum_planes[6][4]{
+        {1.0f, 0.0f, 0.0f, half_extent - camera.position[0]},
+        {-1.0f, 0.0f, 0.0f, half_extent + camera.position[0]},
+        {0.0f, 1.0f, 0.0f, half_extent - camera.position[1]},
+        {0.0f, -1.0f, 0.0f, half_extent + camera.position[1]},
+        {0.0f, 0.0f, 1.0f, 0.5f},
+        {0.0f, 0.0f, -1.0f, 0.5f}};
+
+    memcpy(planes, frustum_planes, sizeof(frustum_planes));
+}
+
+// Resets every instance count of BUFFER_DRAW_COMMANDS to 0
+void record_cull_reset(VkCommandBuffer cmd_buff)
+{
+    if (!g_vk_app.scene_ready)
+        return;
+
+    const VkBufferCopy reset_region{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = sizeof(VkDrawIndexedIndirectCommand) * g_vk_app.batches.size()};
+
+    vkCmdCopyBuffer(cmd_buff, g_vk_app.buffer[BUFFER_BATCHES], g_vk_app.buffer[BUFFER_DRAW_COMMANDS], 1, &reset_region);
+}
+
+// Writes all objects inside the camera frustum to BUFFER_INSTANCES, grouped by mesh, and their number to the
+// instance counts of BUFFER_DRAW_COMMANDS
+void record_cull(VkCommandBuffer cmd_buff)
+{
+    if (!g_vk_app.scene_ready)
+        return;
+
+    const Frame& frame = g_vk_app.frames[g_vk_app.frame_idx];
+
+    ProfilerScope scope(g_vk_app.profiler, cmd_buff, "Cull");
+
+    const uint32_t object_count = static_cast<uint32_t>(g_vk_app.objects.size());
+
+    CullParams cull_params;
+    camera_frustum_planes(g_app.camera, cull_params.frustum_planes);
+    cull_params.object_count = object_count;
+
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, g_vk_app.pipeline[PIPELINE_CULL]);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, g_vk_app.pipeline_layout[PIPELINE_CULL], 0, 1, &frame.cull_descriptor_set, 0, nullptr);
+    vkCmdPushConstants(cmd_buff, g_vk_app.pipeline_layout[PIPELINE_CULL], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &cull_params);
+    vkCmdDispatch(cmd_buff, (object_count + CULL_GROUP_SIZE - 1u) / CULL_GROUP_SIZE, 1, 1);
+}
+
+// Copies BUFFER_DRAW_COMMANDS to the frame's readback buffer, which is read once the frame's fence has signaled
+void record_cull_readback(VkCommandBuffer cmd_buff)
+{
+    if (!g_vk_app.scene_ready)
+        return;
+
+    const VkBufferCopy readback_region{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = sizeof(VkDrawIndexedIndirectCommand) * g_vk_app.batches.size()};
+
+    vkCmdCopyBuffer(cmd_buff, g_vk_app.buffer[BUFFER_DRAW_COMMANDS], g_vk_app.frames[g_vk_app.frame_idx].cull_readback_buffer, 1, &readback_region);
+}
+
+// Begins the render pass, or a dynamic rendering with the same attachments. Without a subpass the MSAA color
+// is resolved into the swapchain image by its attachment's resolveMode.
+void begin_main_pass(VkCommandBuffer cmd_buff, bool secondary_contents)
+{
+    const bool msaa = (g_vk_app.samples != VK_SAMPLE_COUNT_1_BIT);
+    const bool depth = (g_vk_app.depth_format != VK_FORMAT_UNDEFINED);
+
+    const VkClearValue clear_color{.color = {0.22f, 0.22f, 0.22f, 1.0f}};
+    const VkClearValue clear_depth{.depthStencil = {.depth = 1.0f, .stencil = 0u}};
+    const VkRect2D render_area{
+        .offset = {.x = 0, .y = 0},
+        .extent = g_vk.swapchain_extent};
+
+    if (g_vk_app.dynamic_rendering)
+    {
+        const VkImageView swapchain_view = g_vk.swapchain_image_views[g_vk_app.current_swapchain_image_idx];
+
+        const VkRenderingAttachmentInfoKHR color_attachment{
+            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+            .pNext = nullptr,
+            .imageView = msaa ? render_graph_get_image_view(g_vk_app.render_graph, g_vk_app.graph_msaa_color) : swapchain_view,
+            .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .resolveMode = msaa ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE,
+            .resolveImageView = msaa ? swapchain_view : VK_NULL_HANDLE,
+            .resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+            .clearValue = clear_color};
+
+        const VkRenderingAttachmentInfoKHR depth_attachment{
+            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+            .pNext = nullptr,
+            .imageView = depth ? render_graph_get_image_view(g_vk_app.render_graph, g_vk_app.graph_depth) : VK_NULL_HANDLE,
+            .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .resolveMode = VK_RESOLVE_MODE_NONE,
+            .resolveImageView = VK_NULL_HANDLE,
+            .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .clearValue = clear_depth};
+
+        const VkRenderingInfoKHR rendering_info{
+            .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+            .pNext = nullptr,
+            .flags = secondary_contents ? static_cast<VkRenderingFlags>(VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR) : 0x0,
+            .renderArea = render_area,
+            .layerCount = 1,
+            .viewMask = 0,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &color_attachment,
+            .pDepthAttachment = depth ? &depth_attachment : nullptr,
+            .pStencilAttachment = nullptr};
+
+        g_vk.vkCmdBeginRenderingKHR(cmd_buff, &rendering_info);
+        return;
+    }
+
+    // In attachment order, see the render pass. The resolve target's clear value is ignored.
+    VkClearValue clear_values[3];
+    uint32_t clear_value_count = 0u;
+
+    clear_values[clear_value_count++] = clear_color;
+    if (msaa)
+        clear_values[clear_value_count++] = clear_color;
+    if (depth)
+        clear_values[clear_value_count++] = clear_depth;
+
+    const VkRenderPassBeginInfo renderpass_begin_info{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = g_vk_app.renderpass[RENDERPASS_DEFAULT],
+        .framebuffer = g_vk_app.framebuffers[g_vk_app.current_swapchain_image_idx],
+        .renderArea = render_area,
+        .clearValueCount = clear_value_count,
+        .pClearValues = clear_values,
+    };
+
+    vkCmdBeginRenderPass(cmd_buff, &renderpass_begin_info, secondary_contents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void end_main_pass(VkCommandBuffer cmd_buff)
+{
+    if (g_vk_app.dynamic_rendering)
+        g_vk.vkCmdEndRenderingKHR(cmd_buff);
+    else
+        vkCmdEndRenderPass(cmd_buff);
+}
+
+// With dynamic rendering the GUI is drawn by record_gui_pass instead
+void record_main_pass(VkCommandBuffer cmd_buff)
+{
+    const Frame& frame = g_vk_app.frames[g_vk_app.frame_idx];
+
+    const bool scene_ready = g_vk_app.scene_ready;
+    const uint32_t object_count = static_cast<uint32_t>(g_vk_app.objects.size());
+    const bool render_gui = g_app.render_gui && !g_vk_app.dynamic_rendering;
+
+    if (g_app.record_threads == 0u)
+    {
+        begin_main_pass(cmd_buff, false);
+
+        {
+            ProfilerScope scope(g_vk_app.profiler, cmd_buff, "Scene");
+
+            if (scene_ready)
+                record_scene(cmd_buff, 0u, object_count);
+        }
+
+        if (render_gui)
+        {
+            ProfilerScope scope(g_vk_app.profiler, cmd_buff, "Gui");
+            gui(cmd_buff);
+        }
+
+        end_main_pass(cmd_buff);
+    }
+    else
+    {
+        // Only vkCmdExecuteCommands is allowed in a subpass with secondary contents, so the timestamps of
+        // the scope go around the whole render pass
+        ProfilerScope scope(g_vk_app.profiler, cmd_buff, render_gui ? "Scene + Gui (secondary)" : "Scene (secondary)");
+
+        begin_main_pass(cmd_buff, true);
+
+        // Secondaries of a dynamic rendering inherit its attachment formats instead of a render pass
+        const VkCommandBufferInheritanceRenderingInfoKHR inheritance_rendering_info{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .viewMask = 0,
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &g_vk.swapchain_format,
+            .depthAttachmentFormat = g_vk_app.depth_format,
+            .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+            .rasterizationSamples = g_vk_app.samples};
+
+        const VkCommandBufferInheritanceInfo inheritance_info{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .pNext = g_vk_app.dynamic_rendering ? &inheritance_rendering_info : nullptr,
+            .renderPass = g_vk_app.renderpass[RENDERPASS_DEFAULT],
+            .subpass = 0,
+            .framebuffer = g_vk_app.dynamic_rendering ? VK_NULL_HANDLE : g_vk_app.framebuffers[g_vk_app.current_swapchain_image_idx],
+            .occlusionQueryEnable = VK_FALSE,
+            .queryFlags = 0x0,
+            .pipelineStatistics = 0x0};
+
+        command_recorder_begin_frame(g_vk_app.command_recorder, g_vk_app.frame_idx);
+
+        if (scene_ready)
+        {
+            // Contiguous ranges keep the draw order identical to inline recording. An indirect draw covers
+            // the whole scene with a single command, there is nothing to split.
+            const uint32_t task_count = g_app.direct_draws ? std::min(g_app.record_threads, object_count) : 1u;
+            const uint32_t objects_per_task = (object_count + task_count - 1u) / task_count;
+
+            command_recorder_record(g_vk_app.command_recorder, g_vk_app.frame_idx, cmd_buff, inheritance_info, task_count, [=](VkCommandBuffer secondary, uint32_t task_idx) {
+                const uint32_t first = std::min(task_idx * objects_per_task, object_count);
+                record_scene(secondary, first, std::min(objects_per_task, object_count - first));
+            });
+        }
+
+        if (render_gui)
+        {
+            const VkCommandBufferBeginInfo gui_begin_info{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+                .pInheritanceInfo = &inheritance_info};
+
+            VK_CHECK(vkBeginCommandBuffer(frame.gui_command_buffer, &gui_begin_info));
+            gui(frame.gui_command_buffer);
+            VK_CHECK(vkEndCommandBuffer(frame.gui_command_buffer));
+
+            vkCmdExecuteCommands(cmd_buff, 1, &frame.gui_command_buffer);
+        }
+
+        end_main_pass(cmd_buff);
+    }
+}
+
+// Dynamic rendering only. ImGui's pipeline has a single sample and no depth attachment, so the GUI is drawn in
+// a rendering of its own on top of the resolved swapchain image.
+void record_gui_pass(VkCommandBuffer cmd_buff)
+{
+    if (!g_app.render_gui)
+        return;
+
+    ProfilerScope scope(g_vk_app.profiler, cmd_buff, "Gui");
+
+    const VkRenderingAttachmentInfoKHR color_attachment{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .pNext = nullptr,
+        .imageView = g_vk.swapchain_image_views[g_vk_app.current_swapchain_image_idx],
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .resolveImageView = VK_NULL_HANDLE,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = {}};
+
+    const VkRenderingInfoKHR rendering_info{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .renderArea = {
+            .offset = {.x = 0, .y = 0},
+            .extent = g_vk.swapchain_extent},
+        .layerCount = 1,
+        .viewMask = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment,
+        .pDepthAttachment = nullptr,
+        .pStencilAttachment = nullptr};
+
+    g_vk.vkCmdBeginRenderingKHR(cmd_buff, &rendering_info);
+    gui(cmd_buff);
+    g_vk.vkCmdEndRenderingKHR(cmd_buff);
+}
+
+// The passes and their resources are the same every frame, so the graph is built and compiled once. Only the
+// swapchain image and the readback buffer are swapped for the frame's own before every execution.
+void build_render_graph()
+{
+    RenderGraph& graph = g_vk_app.render_graph;
+    graph = create_render_graph(g_vk, g_vk_app.allocator);
+
+    static const char* const buffer_names[BUFFER_PERSISTENT_COUNT] = {"Vertices", "Indices", "Draw Records", "Meshes", "Batches"};
+    for (uint32_t i = 0; i < BUFFER_PERSISTENT_COUNT; ++i)
+        g_vk_app.graph_buffer[i] = render_graph_import_buffer(graph, buffer_names[i], g_vk_app.buffer[i]);
+
+    g_vk_app.graph_buffer[BUFFER_DRAW_COMMANDS] = render_graph_create_buffer(graph, "Draw Commands", sizeof(VkDrawIndexedIndirectCommand) * g_vk_app.batches.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    g_vk_app.graph_buffer[BUFFER_INSTANCES] = render_graph_create_buffer(graph, "Instances", sizeof(DrawRecord) * g_vk_app.objects.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+    g_vk_app.graph_cull_readback = render_graph_import_buffer(graph, "Cull Readback", g_vk_app.frames[0].cull_readback_buffer);
+    render_graph_set_final_state(graph, g_vk_app.graph_cull_readback, RenderGraphState{
+        .stage = VK_PIPELINE_STAGE_2_HOST_BIT_KHR, .access = VK_ACCESS_2_HOST_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_UNDEFINED});
+
+    // The acquire semaphore is waited on in COLOR_ATTACHMENT_OUTPUT and the previous contents are cleared anyway.
+    // PRESENT_SRC_KHR needs VK_KHR_swapchain, headless images are left ready for readback instead.
+    g_vk_app.graph_color = render_graph_import_image(graph, "Color", g_vk.swapchain_images[0], VK_IMAGE_ASPECT_COLOR_BIT);
+    render_graph_set_initial_state(graph, g_vk_app.graph_color, RenderGraphState{
+        .stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, .access = VK_ACCESS_2_NONE_KHR, .layout = VK_IMAGE_LAYOUT_UNDEFINED});
+    render_graph_set_final_state(graph, g_vk_app.graph_color, RenderGraphState{
+        .stage = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT_KHR, .access = VK_ACCESS_2_NONE_KHR,
+        .layout = g_vk.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR});
+
+    // Only used within the render pass, see RenderGraphHeap
+    const bool msaa = (g_vk_app.samples != VK_SAMPLE_COUNT_1_BIT);
+    const bool depth = (g_vk_app.depth_format != VK_FORMAT_UNDEFINED);
+
+    if (msaa)
+    {
+        g_vk_app.graph_msaa_color = render_graph_create_image(graph, "MSAA Color", RenderGraphImageDesc{
+            .format = g_vk.swapchain_format,
+            .extent = g_vk.swapchain_extent,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            .samples = g_vk_app.samples,
+            .aspect = VK_IMAGE_ASPECT_COLOR_BIT});
+    }
 
-        const VkAttachmentReference color_reference{
-            .attachment = 0,
-            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    if (depth)
+    {
+        g_vk_app.graph_depth = render_graph_create_image(graph, "Depth", RenderGraphImageDesc{
+            .format = g_vk_app.depth_format,
+            .extent = g_vk.swapchain_extent,
+            .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            .samples = g_vk_app.samples,
+            .aspect = VK_IMAGE_ASPECT_DEPTH_BIT});
+    }
 
-        const VkSubpassDescription subpass{
-            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-            .inputAttachmentCount = 0,
-            .pInputAttachments = nullptr,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &color_reference,
-            .pResolveAttachments = nullptr,
-            .pDepthStencilAttachment = nullptr,
-            .preserveAttachmentCount = 0,
-            .pPreserveAttachments = nullptr};
+    const RenderGraphResource* buffers = g_vk_app.graph_buffer;
 
-        const VkSubpassDependency dependencies[2]{
-            {// First dependency at the start of the renderpass
-             // Does the transition from final to initial layout
-             .srcSubpass = VK_SUBPASS_EXTERNAL,                             // Producer of the dependency
-             .dstSubpass = 0,                                               // Consumer is our single subpass that will wait for the execution dependency
-             .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // Match our pWaitDstStageMask when we vkQueueSubmit
-             .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // is a loadOp stage for color attachments
-             .srcAccessMask = 0,                                            // semaphore wait already does memory dependency for us
-             .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,         // is a loadOp CLEAR access mask for color attachments
-             .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT},
-            {// Second dependency at the end the renderpass
-             // Does the transition from the initial to the final layout
-             // Technically this is the same as the implicit subpass dependency, but we are gonna state it explicitly here
-             .srcSubpass = 0,                                               // Producer of the dependency is our single subpass
-             .dstSubpass = VK_SUBPASS_EXTERNAL,                             // Consumer are all commands outside of the renderpass
-             .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // is a storeOp stage for color attachments
-             .dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,          // Do not block any subsequent work
-             .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,         // is a storeOp `STORE` access mask for color attachments
-             .dstAccessMask = 0,
-             .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT}};
+    const uint32_t reset_pass = render_graph_add_pass(graph, "Cull Reset", record_cull_reset);
+    render_graph_read(graph, reset_pass, buffers[BUFFER_BATCHES], VK_PIPELINE_STAGE_2_COPY_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR);
+    render_graph_write(graph, reset_pass, buffers[BUFFER_DRAW_COMMANDS], VK_PIPELINE_STAGE_2_COPY_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
 
-        const VkRenderPassCreateInfo renderpass_create_info{
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0x0,
-            .attachmentCount = 1,
-            .pAttachments = attachments,
-            .subpassCount = 1,
-            .pSubpasses = &subpass,
-            .dependencyCount = 2,
-            .pDependencies = dependencies};
+    const uint32_t cull_pass = render_graph_add_pass(graph, "Cull", record_cull);
+    render_graph_read(graph, cull_pass, buffers[BUFFER_DRAW_RECORDS], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR);
+    render_graph_read(graph, cull_pass, buffers[BUFFER_MESHES], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR);
+    render_graph_write(graph, cull_pass, buffers[BUFFER_DRAW_COMMANDS], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                       VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR);
+    render_graph_write(graph, cull_pass, buffers[BUFFER_INSTANCES], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR);
 
-        VK_CHECK(vkCreateRenderPass(g_vk.device, &renderpass_create_info, nullptr, &g_vk_app.renderpass[RENDERPASS_DEFAULT]));
+    // Direct draws read neither the draw commands nor the instances, so both cull passes are culled then
+    if (!g_app.direct_draws)
+    {
+        const uint32_t readback_pass = render_graph_add_pass(graph, "Cull Readback", record_cull_readback);
+        render_graph_read(graph, readback_pass, buffers[BUFFER_DRAW_COMMANDS], VK_PIPELINE_STAGE_2_COPY_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR);
+        render_graph_write(graph, readback_pass, g_vk_app.graph_cull_readback, VK_PIPELINE_STAGE_2_COPY_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+    }
+
+    const uint32_t main_pass = render_graph_add_pass(graph, "Main", record_main_pass);
+    render_graph_read(graph, main_pass, buffers[BUFFER_VERTEX], VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR);
+    render_graph_read(graph, main_pass, buffers[BUFFER_INDEX], VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT_KHR, VK_ACCESS_2_INDEX_READ_BIT_KHR);
+    if (g_app.direct_draws)
+    {
+        render_graph_read(graph, main_pass, buffers[BUFFER_DRAW_RECORDS], VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR);
+    }
+    else
+    {
+        render_graph_read(graph, main_pass, buffers[BUFFER_DRAW_COMMANDS], VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR);
+        render_graph_read(graph, main_pass, buffers[BUFFER_INSTANCES], VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR);
+    }
+    // Resolves are color attachment writes as well
+    render_graph_write(graph, main_pass, g_vk_app.graph_color, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    if (msaa)
+    {
+        render_graph_write(graph, main_pass, g_vk_app.graph_msaa_color, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+    if (depth)
+    {
+        render_graph_write(graph, main_pass, g_vk_app.graph_depth, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+                           VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+
+    // Loads what the main pass wrote, the graph puts a barrier between the two renderings
+    if (g_vk_app.dynamic_rendering && !g_app.headless)
+    {
+        const uint32_t gui_pass = render_graph_add_pass(graph, "Gui", record_gui_pass);
+        render_graph_write(graph, gui_pass, g_vk_app.graph_color, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                           VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     }
 
-    // create framebuffers
+    render_graph_compile(graph);
+
+    // VK_NULL_HANDLE with --direct-draws, where only culled passes use them
+    g_vk_app.buffer[BUFFER_DRAW_COMMANDS] = render_graph_get_buffer(graph, buffers[BUFFER_DRAW_COMMANDS]);
+    g_vk_app.buffer[BUFFER_INSTANCES] = render_graph_get_buffer(graph, buffers[BUFFER_INSTANCES]);
+
+    // In attachment order, see the render pass
+    if (!g_vk_app.dynamic_rendering)
     {
-        VkFramebufferCreateInfo framebuffer_create_info{
+        VkImageView attachments[3];
+        uint32_t attachment_count = 1u;
+        if (msaa)
+            attachments[attachment_count++] = render_graph_get_image_view(graph, g_vk_app.graph_msaa_color);
+        if (depth)
+            attachments[attachment_count++] = render_graph_get_image_view(graph, g_vk_app.graph_depth);
+
+        const VkFramebufferCreateInfo framebuffer_create_info{
             .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
             .renderPass = g_vk_app.renderpass[RENDERPASS_DEFAULT],
-            .attachmentCount = 1,
+            .attachmentCount = attachment_count,
+            .pAttachments = attachments,
             .width = g_vk.swapchain_extent.width,
             .height = g_vk.swapchain_extent.height,
             .layers = 1};
@@ -226,336 +1625,285 @@ void init()
         g_vk_app.framebuffers.resize(g_vk.swapchain_image_views.size());
         for (size_t i = 0; i < g_vk_app.framebuffers.size(); ++i)
         {
-            VkImageView attachments[1] = {
-                g_vk.swapchain_image_views[i]};
-
-            framebuffer_create_info.pAttachments = attachments;
-
+            attachments[0] = g_vk.swapchain_image_views[i];
             VK_CHECK(vkCreateFramebuffer(g_vk.device, &framebuffer_create_info, nullptr, &g_vk_app.framebuffers[i]));
         }
     }
+}
 
-    // create pipeline layouts
-    {
-        const VkPipelineLayoutCreateInfo pipeline_layout_create_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .setLayoutCount = 0,
-            .pSetLayouts = nullptr,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr,
-        };
+// Everything that depends on the swapchain images or extent is rebuilt: the render graph with its transients
+// and, without dynamic rendering, the framebuffers. The device, render pass, pipelines (viewport and scissor
+// are dynamic) and the scene are kept. Frames in flight may still use the old resources, so they are retired
+// into the deletion queue instead of waiting for the device.
+void recreate_swapchain()
+{
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(g_app.window, &width, &height);
 
-        VK_CHECK(vkCreatePipelineLayout(g_vk.device, &pipeline_layout_create_info, nullptr, &g_vk_app.pipeline_layout[PIPELINE_DEFAULT]));
+    // A minimized window has no extent, nothing can be presented until it is restored
+    while (width == 0 || height == 0)
+    {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(g_app.window, &width, &height);
     }
 
-    // create pipelines
-    {
-        const std::array<VkPipelineShaderStageCreateInfo, 2> shader_stage_create_info{{{
-                                                                                           .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                                                                                           .stage = VK_SHADER_STAGE_VERTEX_BIT,
-                                                                                           .module = create_shader_module(g_vk.device, "../shaders/default-vert.spv"),
-                                                                                           .pName = "main",
-                                                                                       },
-                                                                                       {
-                                                                                           .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                                                                                           .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                                                                                           .module = create_shader_module(g_vk.device, "../shaders/default-frag.spv"),
-                                                                                           .pName = "main",
-                                                                                       }}};
-
-        const std::array<VkVertexInputBindingDescription, 1> vertex_input_binding_description{{{.binding = 0,
-                                                                                                .stride = sizeof(float) * 3,
-                                                                                                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX}}};
-
-        const std::array<VkVertexInputAttributeDescription, 1> vertex_input_attribute_description{{
-            {.location = 0,
-             .binding = 0,
-             .format = VK_FORMAT_R32G32B32_SFLOAT,
-             .offset = 0},
-        }};
-
-        const VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_binding_description.size()),
-            .pVertexBindingDescriptions = vertex_input_binding_description.data(),
-            .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_attribute_description.size()),
-            .pVertexAttributeDescriptions = vertex_input_attribute_description.data()};
-
-        const VkViewport viewport{
-            .x = 0,
-            .y = 0,
-            .width = static_cast<float>(g_vk.swapchain_extent.width),
-            .height = static_cast<float>(g_vk.swapchain_extent.height),
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-        };
+    DeletionQueue& queue = g_vk_app.deletion_queue;
 
-        const VkRect2D scissor_rect{
-            .offset = {.x = 0, .y = 0},
-            .extent = g_vk.swapchain_extent};
-
-        const VkPipelineViewportStateCreateInfo viewport_state_create_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-            .viewportCount = 1,
-            .pViewports = &viewport,
-            .scissorCount = 1,
-            .pScissors = &scissor_rect,
-        };
+    // Before the images and views they reference
+    for (VkFramebuffer framebuffer : g_vk_app.framebuffers)
+        deletion_queue_retire_framebuffer(queue, framebuffer);
+    g_vk_app.framebuffers.clear();
 
-        const VkPipelineColorBlendAttachmentState blend_attachment_state{
-            .blendEnable = VK_FALSE,
-            .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .colorBlendOp = VK_BLEND_OP_ADD,
-            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .alphaBlendOp = VK_BLEND_OP_ADD,
-            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-        };
+    render_graph_retire(g_vk_app.render_graph, queue);
+    ++g_vk_app.graph_generation;
 
-        const VkPipelineColorBlendStateCreateInfo color_blend_state_create_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-            .logicOpEnable = VK_FALSE,
-            .logicOp = VK_LOGIC_OP_COPY,
-            .attachmentCount = 1,
-            .pAttachments = &blend_attachment_state,
-            .blendConstants = {0, 0, 0, 0}};
-
-        const VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            .primitiveRestartEnable = VK_FALSE,
-        };
+    // The new swapchain is created from the old one, which stays valid until it is destroyed, so nothing has to
+    // be waited on
+    const OldSwapchain old_swapchain = vulkan_recreate_swapchain(g_vk, VkExtent2D{.width = static_cast<uint32_t>(width), .height = static_cast<uint32_t>(height)},
+                                                                 g_app.present_mode);
+    g_vk_app.current_swapchain_image_idx = 0u;
 
-        const VkPipelineRasterizationStateCreateInfo rasterization_state_create_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-            .depthClampEnable = VK_FALSE,
-            .rasterizerDiscardEnable = VK_FALSE,
-            .polygonMode = VK_POLYGON_MODE_FILL,
-            .cullMode = VK_CULL_MODE_NONE,
-            .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
-            .depthBiasEnable = VK_FALSE,
-            .depthBiasConstantFactor = 0.0f,
-            .depthBiasClamp = 0.0f,
-            .depthBiasSlopeFactor = 0.0f,
-            .lineWidth = 1.0f,
-        };
+    for (VkImageView image_view : old_swapchain.image_views)
+        deletion_queue_retire_image_view(queue, image_view);
+    for (VkImage image : old_swapchain.images)
+        deletion_queue_retire_image(queue, image, Allocation{});
+    for (VkDeviceMemory memory : old_swapchain.image_memory)
+        deletion_queue_retire_memory(queue, memory);
+    if (old_swapchain.swapchain != VK_NULL_HANDLE)
+        deletion_queue_retire_swapchain(queue, old_swapchain.swapchain);
 
-        const VkPipelineMultisampleStateCreateInfo multisample_state_create_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-            .sampleShadingEnable = VK_FALSE,
-            .minSampleShading = 0.0f,
-            .pSampleMask = nullptr,
-            .alphaToCoverageEnable = VK_FALSE,
-            .alphaToOneEnable = VK_FALSE,
-        };
+    build_render_graph();
 
-        const VkGraphicsPipelineCreateInfo pipeline_create_info{
-            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            .stageCount = static_cast<uint32_t>(shader_stage_create_info.size()),
-            .pStages = shader_stage_create_info.data(),
-            .pVertexInputState = &vertex_input_state_create_info,
-            .pInputAssemblyState = &input_assembly_state_create_info,
-            .pViewportState = &viewport_state_create_info,
-            .pRasterizationState = &rasterization_state_create_info,
-            .pMultisampleState = &multisample_state_create_info,
-            .pColorBlendState = &color_blend_state_create_info,
-            .layout = g_vk_app.pipeline_layout[PIPELINE_DEFAULT],
-            .renderPass = g_vk_app.renderpass[RENDERPASS_DEFAULT],
-            .subpass = 0,
-            .basePipelineHandle = VK_NULL_HANDLE,
-            .basePipelineIndex = 0,
-        };
+    g_app.present_mode = g_vk.present_mode;
+    g_app.swapchain_dirty = false;
 
-        VK_CHECK(vkCreateGraphicsPipelines(g_vk.device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &g_vk_app.pipeline[PIPELINE_DEFAULT]));
+    LOG("Swapchain recreated: %ux%u, %s\n", g_vk.swapchain_extent.width, g_vk.swapchain_extent.height, present_mode_name(g_vk.present_mode));
+}
 
-        vkDestroyShaderModule(g_vk.device, shader_stage_create_info[0].module, nullptr);
-        vkDestroyShaderModule(g_vk.device, shader_stage_create_info[1].module, nullptr);
-    }
+void render()
+{
+    if (g_app.swapchain_dirty)
+        recreate_swapchain();
 
-    // Command Pools / Buffers
-    {
-        g_vk_app.command_pool[COMMAND_POOL_DEFAULT] = create_command_pool(g_vk.device, g_vk.queue_family_indices[QUEUE_GRAPHICS]);
-        g_vk_app.command_buffer[COMMAND_BUFFER_RENDER] = create_command_buffer(g_vk.device, g_vk_app.command_pool[COMMAND_POOL_DEFAULT]);
-    }
+    Frame& frame = g_vk_app.frames[g_vk_app.frame_idx];
 
-    // Fences / Semaphores
-    {
-        g_vk_app.fence[FENCE_IMAGE_ACQUIRE] = create_fence(g_vk.device, false);
-    }
+    // Only blocks if the GPU is still busy with the submission that last used this slot
+    VK_CHECK(vkWaitForFences(g_vk.device, 1, &frame.fence[FENCE_SUBMIT], VK_TRUE, UINT64_MAX));
 
-    // Descriptor Pools / Sets
-    {
-        // No idea how many descriptors imgui needs
-        std::array<VkDescriptorPoolSize, 11> pool_sizes {{
-            { VK_DESCRIPTOR_TYPE_SAMPLER, 1000 },
-            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
-            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000 },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 },
-            { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000 }
-        }};
-
-        const VkDescriptorPoolCreateInfo pool_create_info {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0x0,
-            .maxSets = 2u,
-            .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
-            .pPoolSizes = pool_sizes.data(),
-        };
+    uniform_allocator_begin_frame(g_vk_app.uniform_allocator, g_vk_app.frame_idx);
+
+    // Slots are waited on in frame order, so every frame up to the one this slot last recorded has completed
+    const uint64_t completed_frame = frame.frame_number;
+    frame.frame_number = ++g_vk_app.frame_number;
+    deletion_queue_begin_frame(g_vk_app.deletion_queue, frame.frame_number, completed_frame);
 
-        VK_CHECK(vkCreateDescriptorPool(g_vk.device, &pool_create_info, nullptr, &g_vk_app.descriptor_pool[DESCRIPTOR_POOL_IMGUI]));
+    // Written by the last cull pass of this slot, which has finished now
+    const VkDrawIndexedIndirectCommand* draws = static_cast<const VkDrawIndexedIndirectCommand*>(frame.cull_readback_allocation.mapped);
+    g_vk_app.visible_count = 0u;
+    g_vk_app.visible_draw_count = 0u;
+    for (size_t i = 0; i < g_vk_app.batches.size(); ++i)
+    {
+        g_vk_app.visible_count += draws[i].instanceCount;
+        g_vk_app.visible_draw_count += (draws[i].instanceCount > 0u) ? 1u : 0u;
     }
 
-    // create scene
+    // Recreations retire what earlier frames still use instead of waiting for them
+    VkResult acquire_result = acquire_next_image(g_vk, frame.semaphore[SEMAPHORE_IMAGE_ACQUIRED], &g_vk_app.current_swapchain_image_idx);
+    while (acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
     {
-        std::array<float, 9> vertices {
-           -0.5f,  0.5f, 0.0f,
-            0.5f,  0.5f, 0.0f,
-            0.0f, -0.5f, 0.0f
-        };
+        recreate_swapchain();
+        acquire_result = acquire_next_image(g_vk, frame.semaphore[SEMAPHORE_IMAGE_ACQUIRED], &g_vk_app.current_swapchain_image_idx);
+    }
 
-        std::array<uint32_t, 3> indices {
-            0, 1, 2
-        };
+    // A suboptimal image can still be presented, the swapchain is recreated afterwards
+    if (acquire_result == VK_SUBOPTIMAL_KHR)
+        g_app.swapchain_dirty = true;
+    else
+        VK_CHECK(acquire_result);
+    VK_CHECK(vkResetFences(g_vk.device, 1, &frame.fence[FENCE_SUBMIT]));
 
-        const VkDeviceSize vertex_buffer_size = sizeof(float) * vertices.size();
-        const VkDeviceSize index_buffer_size = sizeof(uint32_t) * indices.size();
-        const VkDeviceSize staging_buffer_size = std::max(vertex_buffer_size, index_buffer_size);
+    // After the acquire, which may have rebuilt the render graph. The fence wait above covers the last use of
+    // the transients the set pointed at before.
+    if (frame.cull_descriptor_set != VK_NULL_HANDLE && frame.cull_descriptor_generation != g_vk_app.graph_generation)
+    {
+        const VkDescriptorBufferInfo buffer_infos[4]{
+            {.buffer = g_vk_app.buffer[BUFFER_DRAW_RECORDS], .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = g_vk_app.buffer[BUFFER_MESHES], .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = g_vk_app.buffer[BUFFER_DRAW_COMMANDS], .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = g_vk_app.buffer[BUFFER_INSTANCES], .offset = 0, .range = VK_WHOLE_SIZE}};
+
+        VkWriteDescriptorSet descriptor_writes[4];
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            descriptor_writes[i] = VkWriteDescriptorSet{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = nullptr,
+                .dstSet = frame.cull_descriptor_set,
+                .dstBinding = i,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = nullptr,
+                .pBufferInfo = &buffer_infos[i],
+                .pTexelBufferView = nullptr};
+        }
 
-        g_vk_app.buffer[BUFFER_VERTEX_TRIANGLE] = create_buffer(g_vk.device, vertex_buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-        g_vk_app.buffer_memory[BUFFER_VERTEX_TRIANGLE] = allocate_buffer_memory(g_vk.device, g_vk_app.buffer[BUFFER_VERTEX_TRIANGLE], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_vk.physical_device_memory_properties);
+        vkUpdateDescriptorSets(g_vk.device, 4, descriptor_writes, 0, nullptr);
+        frame.cull_descriptor_generation = g_vk_app.graph_generation;
+    }
 
-        g_vk_app.buffer[BUFFER_INDEX_TRIANGLE] = create_buffer(g_vk.device, index_buffer_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-        g_vk_app.buffer_memory[BUFFER_INDEX_TRIANGLE] = allocate_buffer_memory(g_vk.device, g_vk_app.buffer[BUFFER_INDEX_TRIANGLE], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_vk.physical_device_memory_properties);
+    static const VkCommandBufferBeginInfo command_buffer_begin_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
 
-        g_vk_app.buffer[BUFFER_STAGING] = create_buffer(g_vk.device, staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-        g_vk_app.buffer_memory[BUFFER_STAGING] = allocate_buffer_memory(g_vk.device, g_vk_app.buffer[BUFFER_STAGING], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, g_vk.physical_device_memory_properties);
+    vkResetCommandPool(g_vk.device, frame.command_pool, 0x0);
 
-        VK_CHECK(vkBindBufferMemory(g_vk.device, g_vk_app.buffer[BUFFER_VERTEX_TRIANGLE], g_vk_app.buffer_memory[BUFFER_VERTEX_TRIANGLE], 0));
-        VK_CHECK(vkBindBufferMemory(g_vk.device, g_vk_app.buffer[BUFFER_INDEX_TRIANGLE], g_vk_app.buffer_memory[BUFFER_INDEX_TRIANGLE], 0));
-        VK_CHECK(vkBindBufferMemory(g_vk.device, g_vk_app.buffer[BUFFER_STAGING], g_vk_app.buffer_memory[BUFFER_STAGING], 0));
+    VkCommandBuffer cmd_buff = frame.command_buffer;
 
-        upload_data(g_vk.device, g_vk_app.command_pool[COMMAND_POOL_DEFAULT], g_vk.queues[QUEUE_GRAPHICS], g_vk_app.command_buffer[COMMAND_BUFFER_RENDER], 
-                    g_vk_app.buffer[BUFFER_STAGING], g_vk_app.buffer[BUFFER_VERTEX_TRIANGLE],
-                    g_vk_app.buffer_memory[BUFFER_STAGING], g_vk_app.buffer_memory[BUFFER_VERTEX_TRIANGLE], vertex_buffer_size, vertices.data() );
+    VK_CHECK(vkBeginCommandBuffer(cmd_buff, &command_buffer_begin_info));
 
-        upload_data(g_vk.device, g_vk_app.command_pool[COMMAND_POOL_DEFAULT], g_vk.queues[QUEUE_GRAPHICS], g_vk_app.command_buffer[COMMAND_BUFFER_RENDER], 
-                    g_vk_app.buffer[BUFFER_STAGING], g_vk_app.buffer[BUFFER_INDEX_TRIANGLE],
-                    g_vk_app.buffer_memory[BUFFER_STAGING], g_vk_app.buffer_memory[BUFFER_INDEX_TRIANGLE], index_buffer_size, indices.data() );
+    // The fence above has signaled, so this slot's previous timestamps can be read back without waiting
+    profiler_begin_frame(g_vk_app.profiler, g_vk.device, cmd_buff, g_vk_app.frame_idx);
 
-        g_vk_app.index_count[BUFFER_VERTEX_TRIANGLE] = indices.size();
-    }
-}
+    // Takes ownership of finished uploads, never waits for unfinished ones
+    frame.upload_wait_ticket = uploader_record_acquire(g_vk_app.uploader, cmd_buff);
 
-void render()
-{
-    VK_CHECK(vkAcquireNextImageKHR(g_vk.device, g_vk.swapchain, UINT64_MAX, VK_NULL_HANDLE, g_vk_app.fence[FENCE_IMAGE_ACQUIRE], &g_vk_app.current_swapchain_image_idx));
-    VK_CHECK(vkWaitForFences(g_vk.device, 1, &g_vk_app.fence[FENCE_IMAGE_ACQUIRE], VK_TRUE, UINT64_MAX));
-    VK_CHECK(vkResetFences(g_vk.device, 1, &g_vk_app.fence[FENCE_IMAGE_ACQUIRE]));
+    g_vk_app.scene_ready = uploader_is_acquired(g_vk_app.uploader, g_vk_app.scene_upload_ticket);
 
-    static const VkCommandBufferBeginInfo command_buffer_begin_info{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    // Allocated up front, the workers recording the scene only read the offset
+    const UniformSlice camera_slice = uniform_allocator_allocate(g_vk_app.uniform_allocator, sizeof(Camera));
+    memcpy(camera_slice.data, &g_app.camera, sizeof(Camera));
+    frame.camera_offset = camera_slice.offset;
 
-    static const VkClearValue clear_value{
-        .color = {0.22f, 0.22f, 0.22f, 1.0f}};
+    render_graph_set_image(g_vk_app.render_graph, g_vk_app.graph_color, g_vk.swapchain_images[g_vk_app.current_swapchain_image_idx]);
+    render_graph_set_buffer(g_vk_app.render_graph, g_vk_app.graph_cull_readback, frame.cull_readback_buffer);
+    render_graph_execute(g_vk_app.render_graph, cmd_buff);
 
-    VkRenderPassBeginInfo renderpass_begin_info{
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = g_vk_app.renderpass[RENDERPASS_DEFAULT],
-        .framebuffer = g_vk_app.framebuffers[g_vk_app.current_swapchain_image_idx],
-        .renderArea = {
-            .offset = {.x = 0, .y = 0},
-            .extent = g_vk.swapchain_extent},
-        .clearValueCount = 1,
-        .pClearValues = &clear_value,
-    };
+    uniform_allocator_end_frame(g_vk_app.uniform_allocator);
 
-    vkResetCommandPool(g_vk.device, g_vk_app.command_pool[COMMAND_POOL_DEFAULT], 0x0);
+    profiler_end_frame(g_vk_app.profiler, cmd_buff);
 
-    VkCommandBuffer cmd_buff = g_vk_app.command_buffer[COMMAND_BUFFER_RENDER];
+    VK_CHECK(vkEndCommandBuffer(cmd_buff));
+}
 
-    VK_CHECK(vkBeginCommandBuffer(cmd_buff, &command_buffer_begin_info));
+void submit()
+{
+    Frame& frame = g_vk_app.frames[g_vk_app.frame_idx];
 
-    vkCmdBeginRenderPass(cmd_buff, &renderpass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    // Headless frames have no presentation engine to synchronize with, the frame fence is enough
+    const uint32_t semaphore_count = g_vk.headless ? 0u : 1u;
 
-    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_GRAPHICS, g_vk_app.pipeline[PIPELINE_DEFAULT]);
+    // Color writes must wait for the presentation engine to release the image. The upload timeline value
+    // has already signaled, the wait only orders the acquire barriers after the transfer queue's release.
+    VkSemaphore wait_semaphores[2];
+    VkPipelineStageFlags wait_stage_masks[2];
+    uint64_t wait_values[2];
+    uint32_t wait_count = 0u;
 
-    VkDeviceSize offsets = 0;
-    vkCmdBindVertexBuffers(cmd_buff, 0, 1, &g_vk_app.buffer[BUFFER_VERTEX_TRIANGLE], &offsets);
-    vkCmdBindIndexBuffer(cmd_buff, g_vk_app.buffer[BUFFER_INDEX_TRIANGLE], 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmd_buff, g_vk_app.index_count[BUFFER_VERTEX_TRIANGLE], 1, 0, 0, 0);
+    if (semaphore_count > 0u)
+    {
+        wait_semaphores[wait_count] = frame.semaphore[SEMAPHORE_IMAGE_ACQUIRED];
+        wait_stage_masks[wait_count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        wait_values[wait_count++] = 0u; // Ignored for binary semaphores
+    }
 
-    if (g_app.render_gui)
+    if (frame.upload_wait_ticket > 0u)
     {
-        gui();
+        wait_semaphores[wait_count] = g_vk_app.uploader.timeline;
+        wait_stage_masks[wait_count] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        wait_values[wait_count++] = frame.upload_wait_ticket;
     }
 
-    vkCmdEndRenderPass(cmd_buff);
+    const uint64_t signal_value = 0u;
 
-    VK_CHECK(vkEndCommandBuffer(cmd_buff));
-}
+    const VkTimelineSemaphoreSubmitInfo timeline_info{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = wait_count,
+        .pWaitSemaphoreValues = wait_values,
+        .signalSemaphoreValueCount = semaphore_count,
+        .pSignalSemaphoreValues = &signal_value};
 
-void submit()
-{
     const VkSubmitInfo submit_info{
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
+        .pNext = &timeline_info,
+        .waitSemaphoreCount = wait_count,
+        .pWaitSemaphores = wait_semaphores,
+        .pWaitDstStageMask = wait_stage_masks,
         .commandBufferCount = 1,
-        .pCommandBuffers = &g_vk_app.command_buffer[COMMAND_BUFFER_RENDER],
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
+        .pCommandBuffers = &frame.command_buffer,
+        .signalSemaphoreCount = semaphore_count,
+        .pSignalSemaphores = &frame.semaphore[SEMAPHORE_RENDER_FINISHED],
     };
 
-    VK_CHECK(vkQueueSubmit(g_vk.queues[QUEUE_GRAPHICS], 1, &submit_info, VK_NULL_HANDLE));
+    VK_CHECK(vkQueueSubmit(g_vk.queues[QUEUE_GRAPHICS], 1, &submit_info, frame.fence[FENCE_SUBMIT]));
+}
 
-    VK_CHECK(vkDeviceWaitIdle(g_vk.device));
+void present()
+{
+    Frame& frame = g_vk_app.frames[g_vk_app.frame_idx];
 
     //*** Present (wait for graphics work to complete)
-    const VkPresentInfoKHR present_info{
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .swapchainCount = 1,
-        .pSwapchains = &g_vk.swapchain,
-        .pImageIndices = &g_vk_app.current_swapchain_image_idx,
-        .pResults = nullptr,
-    };
+    const VkResult present_result = present_image(g_vk, g_vk.queues[QUEUE_GRAPHICS], frame.semaphore[SEMAPHORE_RENDER_FINISHED], g_vk_app.current_swapchain_image_idx);
+    if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR)
+        g_app.swapchain_dirty = true;
+    else
+        VK_CHECK(present_result);
 
-    VK_CHECK(vkQueuePresentKHR(g_vk.queues[QUEUE_GRAPHICS], &present_info));
+    if (!g_app.headless)
+        glfwSwapBuffers(g_app.window);
 
-    VK_CHECK(vkDeviceWaitIdle(g_vk.device));
+    g_vk_app.frame_idx = (g_vk_app.frame_idx + 1) % g_app.frames_in_flight;
 }
 
 void release()
 {
-    for (size_t i = 0; i < DESCRIPTOR_POOL_COUNT; ++i)
-        vkDestroyDescriptorPool(g_vk.device, g_vk_app.descriptor_pool[DESCRIPTOR_POOL_IMGUI], nullptr);
+    profiler_release(g_vk_app.profiler, g_vk.device);
+
+    vkDestroyDescriptorPool(g_vk.device, g_vk_app.imgui_descriptor_pool, nullptr);
+    for (size_t i = 0; i < g_app.frames_in_flight; ++i)
+        descriptor_allocator_release(g_vk_app.frames[i].descriptor_allocator);
+
+    descriptor_layout_cache_release(g_vk_app.descriptor_layout_cache);
+
+    uploader_release(g_vk_app.uploader);
+    deletion_queue_release(g_vk_app.deletion_queue);
+    uniform_allocator_release(g_vk_app.uniform_allocator);
 
-    for (size_t i = 0; i < BUFFER_COUNT; ++i)
+    // Destroys BUFFER_DRAW_COMMANDS and BUFFER_INSTANCES
+    render_graph_release(g_vk_app.render_graph);
+
+    for (size_t i = 0; i < BUFFER_PERSISTENT_COUNT; ++i)
     {
-        vkFreeMemory(g_vk.device, g_vk_app.buffer_memory[i], nullptr);
         vkDestroyBuffer(g_vk.device, g_vk_app.buffer[i], nullptr);
+        allocator_free(g_vk_app.allocator, g_vk_app.buffer_allocation[i]);
+    }
+
+    for (size_t i = 0; i < g_app.frames_in_flight; ++i)
+    {
+        vkDestroyBuffer(g_vk.device, g_vk_app.frames[i].cull_readback_buffer, nullptr);
+        allocator_free(g_vk_app.allocator, g_vk_app.frames[i].cull_readback_allocation);
     }
 
+    allocator_release(g_vk_app.allocator);
+
+    command_recorder_release(g_vk_app.command_recorder);
+
     for (size_t i = 0; i < COMMAND_POOL_COUNT; ++i)
         vkDestroyCommandPool(g_vk.device, g_vk_app.command_pool[i], nullptr);
 
-    for (size_t i = 0; i < SEMAPHORE_COUNT; ++i)
-        vkDestroySemaphore(g_vk.device, g_vk_app.semaphore[i], nullptr);
+    for (size_t i = 0; i < g_app.frames_in_flight; ++i)
+    {
+        Frame& frame = g_vk_app.frames[i];
+
+        vkDestroyCommandPool(g_vk.device, frame.command_pool, nullptr);
 
-    for (size_t i = 0; i < FENCE_COUNT; ++i)
-        vkDestroyFence(g_vk.device, g_vk_app.fence[i], nullptr);
+        for (size_t j = 0; j < SEMAPHORE_COUNT; ++j)
+            vkDestroySemaphore(g_vk.device, frame.semaphore[j], nullptr);
+
+        for (size_t j = 0; j < FENCE_COUNT; ++j)
+            vkDestroyFence(g_vk.device, frame.fence[j], nullptr);
+    }
 
     for (size_t i = 0; i < PIPELINE_COUNT; ++i)
     {
@@ -569,28 +1917,17 @@ void release()
     for (size_t i = 0; i < RENDERPASS_COUNT; ++i)
         vkDestroyRenderPass(g_vk.device, g_vk_app.renderpass[i], nullptr);
 
+    save_pipeline_cache(g_vk.device, g_vk_app.pipeline_cache, g_app.pipeline_cache_path);
+    vkDestroyPipelineCache(g_vk.device, g_vk_app.pipeline_cache, nullptr);
+    shader_archive_release(g_vk_app.shader_archive, g_vk.device);
+
+    thread_pool_stop(g_vk_app.thread_pool);
+
     vulkan_release(g_vk);
 }
 
-int main()
+void init_gui()
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    g_app.window = glfwCreateWindow(g_app.window_width, g_app.window_height, "Vk-Template", nullptr, nullptr);
-
-    if (g_app.window == nullptr)
-    {
-        glfwTerminate();
-        EXIT("=> Failure <=\n");
-    }
-    glfwMakeContextCurrent(g_app.window);
-    glfwSetKeyCallback(g_app.window, key_callback);
-
-    LOG("-- Begin -- Init\n");
-    init();
-    LOG("-- End -- Init\n");
-
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -609,20 +1946,28 @@ int main()
     init_info.Device = g_vk.device;
     init_info.QueueFamily = g_vk.queue_family_indices[QUEUE_GRAPHICS];
     init_info.Queue = g_vk.queues[QUEUE_GRAPHICS];
-    init_info.PipelineCache = VK_NULL_HANDLE;
-    init_info.DescriptorPool = g_vk_app.descriptor_pool[DESCRIPTOR_POOL_IMGUI];
+    init_info.PipelineCache = g_vk_app.pipeline_cache;
+    init_info.DescriptorPool = g_vk_app.imgui_descriptor_pool;
     init_info.Subpass = 0;
     init_info.MinImageCount = 2;
     init_info.ImageCount = static_cast<uint32_t>(g_vk.swapchain_images.size()),
-    init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    init_info.MSAASamples = g_vk_app.dynamic_rendering ? VK_SAMPLE_COUNT_1_BIT : g_vk_app.samples; // See record_gui_pass
     init_info.Allocator = nullptr;
     init_info.CheckVkResultFn = nullptr;
+#ifdef IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING
+    init_info.UseDynamicRendering = g_vk_app.dynamic_rendering;
+    init_info.ColorAttachmentFormat = g_vk.swapchain_format;
+#endif
+
+    // ImGui creates its pipeline in here
+    const auto pipeline_creation_begin = std::chrono::steady_clock::now();
     ImGui_ImplVulkan_Init(&init_info, g_vk_app.renderpass[RENDERPASS_DEFAULT]);
+    g_vk_app.pipeline_creation_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pipeline_creation_begin).count();
 
     // Upload Fonts
     {
         // Use any command queue
-        VkCommandBuffer command_buffer = g_vk_app.command_buffer[COMMAND_BUFFER_RENDER];
+        VkCommandBuffer command_buffer = g_vk_app.command_buffer[COMMAND_BUFFER_UPLOAD];
 
         const VkCommandBufferBeginInfo command_buffer_begin_info {
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -649,36 +1994,302 @@ int main()
 
         vkResetCommandPool(g_vk.device, g_vk_app.command_pool[COMMAND_POOL_DEFAULT], 0x0);
     }
+}
+
+void release_gui()
+{
+    // ImGui_ImplVulkanH_DestroyWindow(g_vk.instance, g_vk.device, &g_MainWindowData, g_Allocator);
+    ImGui_ImplVulkan_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+}
+
+// All pools of the descriptor allocators, ImGui's included
+uint32_t descriptor_pool_count()
+{
+    uint32_t count = 1u;
+    for (uint32_t i = 0; i < g_app.frames_in_flight; ++i)
+        count += descriptor_allocator_pool_count(g_vk_app.frames[i].descriptor_allocator);
+
+    return count;
+}
+
+void write_bench_report(const Bench& bench)
+{
+    FILE* file = fopen(g_app.bench_output, "w");
+    if (file == nullptr)
+        EXIT("Failed to open " << g_app.bench_output);
+
+    const std::vector<std::pair<std::string, std::string>> context{
+        {"device", bench_json_string(g_vk.physical_device_properties.deviceName)},
+        {"headless", g_app.headless ? "true" : "false"},
+        {"frames_in_flight", std::to_string(g_app.frames_in_flight)},
+        {"width", std::to_string(g_vk.swapchain_extent.width)},
+        {"height", std::to_string(g_vk.swapchain_extent.height)},
+        {"pipeline_cache", g_vk_app.pipeline_cache_warm ? "\"warm\"" : "\"cold\""},
+        {"pipeline_creation_ms", std::to_string(g_vk_app.pipeline_creation_ms)},
+        {"objects", std::to_string(g_app.object_count)},
+        {"record_threads", std::to_string(g_app.record_threads)},
+        {"draws", g_app.direct_draws ? "\"direct\"" : "\"indirect\""},
+        {"instancing", g_app.no_instancing ? "false" : "true"},
+        {"present_mode", bench_json_string(present_mode_name(g_vk.present_mode))},
+        {"msaa_samples", std::to_string(g_vk_app.samples)},
+        {"depth", (g_vk_app.depth_format != VK_FORMAT_UNDEFINED) ? "true" : "false"},
+        {"rendering", g_vk_app.dynamic_rendering ? "\"dynamic\"" : "\"render_pass\""},
+        {"descriptor_pools", std::to_string(descriptor_pool_count())}};
+
+    bench_write_json(bench, file, context);
+
+    fclose(file);
+    LOG("Bench results written to %s\n", g_app.bench_output);
+}
+
+bool running(uint64_t frame_count)
+{
+    if (g_app.max_frames != 0u && frame_count >= g_app.max_frames)
+        return false;
+
+    return g_app.headless || !glfwWindowShouldClose(g_app.window);
+}
+
+// Exits unless value is a decimal number between min and max, atoi would wrap negative values around
+uint32_t parse_uint(const char* flag, const char* value, uint32_t min, uint32_t max)
+{
+    char* end = nullptr;
+    const long long parsed = strtoll(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < min || parsed > max)
+        EXIT(flag << " must be between " << min << " and " << max);
+
+    return static_cast<uint32_t>(parsed);
+}
+
+void parse_args(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+        {
+            g_app.frames_in_flight = static_cast<uint32_t>(atoi(argv[++i]));
+            if (g_app.frames_in_flight < 1u || g_app.frames_in_flight > MAX_FRAMES_IN_FLIGHT)
+                EXIT("--frames-in-flight must be between 1 and " << MAX_FRAMES_IN_FLIGHT);
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            g_app.headless = true;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            g_app.max_frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            g_app.bench = true;
+        }
+        else if (strcmp(argv[i], "--bench-warmup") == 0 && i + 1 < argc)
+        {
+            g_app.warmup_frames = parse_uint("--bench-warmup", argv[++i], 0u, 1000000u);
+        }
+        else if (strcmp(argv[i], "--bench-frames") == 0 && i + 1 < argc)
+        {
+            g_app.bench_frames = parse_uint("--bench-frames", argv[++i], 1u, 1000000u);
+        }
+        else if (strcmp(argv[i], "--bench-output") == 0 && i + 1 < argc)
+        {
+            g_app.bench_output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            g_app.worker_threads = parse_uint("--threads", argv[++i], 0u, 256u);
+        }
+        else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
+        {
+            g_app.pipeline_cache_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--staging-size") == 0 && i + 1 < argc)
+        {
+            g_app.staging_size = strtoull(argv[++i], nullptr, 10) * 1024u;
+            if (g_app.staging_size < 2u * UPLOADER_STAGING_ALIGNMENT)
+                EXIT("--staging-size is too small");
+        }
+        else if (strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc)
+        {
+            g_app.record_threads = parse_uint("--record-threads", argv[++i], 0u, 256u);
+        }
+        else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+        {
+            g_app.object_count = static_cast<uint32_t>(atoi(argv[++i]));
+            if (g_app.object_count < 1u)
+                EXIT("--objects must be at least 1");
+        }
+        else if (strcmp(argv[i], "--direct-draws") == 0)
+        {
+            g_app.direct_draws = true;
+        }
+        else if (strcmp(argv[i], "--no-instancing") == 0)
+        {
+            g_app.no_instancing = true;
+        }
+        else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc)
+        {
+            const int samples = atoi(argv[++i]);
+            if (samples < 1 || samples > 64 || (samples & (samples - 1)) != 0)
+                EXIT("--msaa must be 1, 2, 4, 8, 16, 32 or 64");
+            g_app.msaa_samples = static_cast<VkSampleCountFlagBits>(samples);
+        }
+        else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+        {
+            g_app.device_override = argv[++i];
+        }
+        else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            const VkPresentModeKHR present_modes[4] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+
+            bool found = false;
+            for (VkPresentModeKHR present_mode : present_modes)
+            {
+                if (strcmp(name, present_mode_name(present_mode)) == 0)
+                {
+                    g_app.present_mode = present_mode;
+                    found = true;
+                }
+            }
+
+            if (!found)
+                EXIT("--present-mode must be fifo, fifo_relaxed, mailbox or immediate");
+        }
+        else if (strcmp(argv[i], "--depth") == 0)
+        {
+            g_app.depth = true;
+        }
+        else if (strcmp(argv[i], "--no-dynamic-rendering") == 0)
+        {
+            g_app.no_dynamic_rendering = true;
+        }
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+        {
+            g_app.scene_path = argv[++i];
+        }
+        else
+        {
+            EXIT("Unknown argument " << argv[i]);
+        }
+    }
+
+    if (g_app.bench)
+        g_app.max_frames = static_cast<uint64_t>(g_app.warmup_frames) + g_app.bench_frames;
+
+    if (g_app.headless)
+    {
+        // Nothing to close in headless mode, so always stop after a fixed number of frames
+        if (g_app.max_frames == 0u)
+            g_app.max_frames = 1000u;
+
+        g_app.render_gui = false;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    parse_args(argc, argv);
+
+    if (!g_app.headless)
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+        g_app.window = glfwCreateWindow(g_app.window_width, g_app.window_height, "Vk-Template", nullptr, nullptr);
+
+        if (g_app.window == nullptr)
+        {
+            glfwTerminate();
+            EXIT("=> Failure <=\n");
+        }
+        glfwMakeContextCurrent(g_app.window);
+        glfwSetKeyCallback(g_app.window, key_callback);
+        glfwSetMouseButtonCallback(g_app.window, mouse_button_callback);
+        glfwSetCursorPosCallback(g_app.window, cursor_pos_callback);
+        glfwSetFramebufferSizeCallback(g_app.window, framebuffer_size_callback);
+    }
+
+    LOG("-- Begin -- Init\n");
+    init();
+#ifndef NDEBUG
+    render_graph_self_test(g_vk, g_vk_app.allocator);
+#endif
+    build_render_graph();
+    LOG("-- End -- Init\n");
+
+    if (!g_app.headless)
+        init_gui();
 
+    LOG("Pipeline Creation: %.2f ms (%s pipeline cache)\n", g_vk_app.pipeline_creation_ms, g_vk_app.pipeline_cache_warm ? "warm" : "cold");
 
     LOG("-- Begin -- Run\n");
 
-    while (!glfwWindowShouldClose(g_app.window))
+    Bench bench = create_bench(g_app.bench, g_app.warmup_frames, g_app.bench_frames);
+
+    uint64_t frame_count = 0u;
+    const auto run_begin = std::chrono::steady_clock::now();
+
+    while (running(frame_count))
     {
-        glfwPollEvents();
+        bench_begin_frame(bench);
+
+        if (!g_app.headless)
+            glfwPollEvents();
+        bench_end_phase(bench, BENCH_PHASE_POLL);
+
+        // Everything polled so far is reflected by this frame
+        const bool has_input = g_app.input_pending;
+        const auto input_time = g_app.input_time;
+        g_app.input_pending = false;
 
         render();
+        bench_end_phase(bench, BENCH_PHASE_RENDER);
 
         submit();
+        bench_end_phase(bench, BENCH_PHASE_SUBMIT);
 
-        glfwSwapBuffers(g_app.window);
+        present();
+        bench_end_phase(bench, BENCH_PHASE_PRESENT);
+
+        if (has_input)
+        {
+            LatencyStats& latency = g_app.latency;
+            latency.samples_ms[latency.next] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - input_time).count();
+            latency.next = (latency.next + 1u) % LATENCY_SAMPLE_COUNT;
+            latency.count = std::min(latency.count + 1u, LATENCY_SAMPLE_COUNT);
+        }
+
+        bench_end_frame(bench);
+
+        ++frame_count;
     }
 
     vkDeviceWaitIdle(g_vk.device);
 
+    const double run_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - run_begin).count();
+    LOG("Frames: %lu | Frames in flight: %u | Avg frame time: %.3f ms | %.1f FPS\n",
+        frame_count, g_app.frames_in_flight, run_ms / std::max(frame_count, (uint64_t)1u), frame_count * 1000.0 / run_ms);
+
     LOG("-- End -- Run\n");
 
-    // ImGui_ImplVulkanH_DestroyWindow(g_vk.instance, g_vk.device, &g_MainWindowData, g_Allocator);
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (g_app.bench)
+        write_bench_report(bench);
+
+    if (!g_app.headless)
+        release_gui();
 
     release();
 
-    glfwDestroyWindow(g_app.window);
-    glfwTerminate();
+    if (!g_app.headless)
+    {
+        glfwDestroyWindow(g_app.window);
+        glfwTerminate();
+    }
 
     LOG("-- Release Successful --\n");
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,2 +0,0 @@
-${VULKAN_SDK}/bin/glslc default.vert -o default-vert.spv
-${VULKAN_SDK}/bin/glslc default.frag -o default-frag.spv
\ No newline at end of file
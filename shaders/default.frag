@@ -1,8 +1,10 @@
 #version 450
 
+layout(location = 0) in vec4 v_color;
+
 layout(location = 0) out vec4 out_color;
 
 void main()
 {
-    out_color = vec4(0.17f, 0.68f, 0.62f, 1.0f);
-}
\ No newline at end of file
+    out_color = v_color;
+}
@@ -1,8 +1,41 @@
 #version 450
 
-layout(location=0) in vec3 a_pos;
+// snorm position / MESH_FILE_POSITION_SCALE, see VertexLayout.hpp
+layout(location = 0) in vec3 a_pos;
+
+// Per instance, DrawRecord in main.cpp
+layout(location = 1) in vec3 a_offset_scale;
+layout(location = 2) in vec4 a_color;
+
+layout(location = 0) out vec4 v_color;
+
+// Matches MESH_FILE_POSITION_SCALE in MeshFile.hpp
+const float POSITION_SCALE = 0.5f;
+
+// Matches Camera in main.cpp, a slice of the frame's uniform allocator region picked by the dynamic offset
+layout(set = 0, binding = 0) uniform Camera
+{
+    vec2 position;
+    float zoom;
+} camera;
+
+// Matches DrawParams in main.cpp. Draws of a single object set per_draw and push the object instead of
+// reading it from the instance attributes.
+layout(push_constant) uniform Draw
+{
+    vec3 offset_scale;
+    uint color;
+    uint per_draw;
+} draw;
 
 void main()
 {
-    gl_Position = vec4(a_pos, 1.0f);
-}
\ No newline at end of file
+    const vec3 offset_scale = (draw.per_draw != 0u) ? draw.offset_scale : a_offset_scale;
+
+    const vec3 position = a_pos * POSITION_SCALE;
+    const vec2 world_pos = position.xy * offset_scale.z + offset_scale.xy;
+
+    // Meshes are centered on z = 0, see tools/mesh_import
+    gl_Position = vec4((world_pos - camera.position) * camera.zoom, position.z + 0.5f, 1.0f);
+    v_color = (draw.per_draw != 0u) ? unpackUnorm4x8(draw.color) : a_color;
+}
@@ -0,0 +1,328 @@
+// Converts a glTF scene into the .mesh format loaded by MeshFile.cpp
+//
+// usage: mesh_import <input.gltf|input.glb> <output.mesh>
+//
+// Every glTF mesh becomes a mesh and each of its triangle primitives a submesh. Only positions are kept,
+// node transforms are ignored. The scene is scaled and centered to fit into [-0.5, 0.5]^3, so any model
+// shows up at a sensible size in the app's default view.
+//
+// Each submesh is reordered for the post-transform cache, overdraw and vertex fetch, and stored with 16 bit
+// indices when its vertices allow it. The ACMR before and after and the index memory saved are printed.
+// Positions are quantized to snorm16 and all sections are compressed with StreamCodec.hpp.
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_EXTERNAL_IMAGE
+#include <tiny_gltf.h>
+
+#include "../MeshFile.hpp"
+#include "../StreamCodec.hpp"
+#include "mesh_optimizer.hpp"
+
+// Pointer to element i of an accessor, honoring the buffer view's stride
+static const uint8_t* accessor_element(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t i)
+{
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    const size_t stride = accessor.ByteStride(view);
+
+    return model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset + i * stride;
+}
+
+// Returns the compressed stream
+static std::vector<uint8_t> encode_stream(const uint32_t* values, size_t count)
+{
+    std::vector<uint8_t> stream(stream_codec_max_encoded_size(static_cast<uint32_t>(count)));
+    stream.resize(stream_codec_encode(values, static_cast<uint32_t>(count), stream.data()));
+    return stream;
+}
+
+static bool read_positions(const tinygltf::Model& model, const tinygltf::Primitive& primitive, std::vector<MeshFileVertex>& vertices)
+{
+    const auto position = primitive.attributes.find("POSITION");
+    if (position == primitive.attributes.end())
+        return false;
+
+    const tinygltf::Accessor& accessor = model.accessors[position->second];
+    if (accessor.type != TINYGLTF_TYPE_VEC3 || accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || accessor.bufferView < 0)
+        return false;
+
+    for (size_t i = 0; i < accessor.count; ++i)
+    {
+        MeshFileVertex vertex;
+        memcpy(vertex.position, accessor_element(model, accessor, i), sizeof(vertex.position));
+        vertices.push_back(vertex);
+    }
+
+    return true;
+}
+
+// Non-indexed primitives get a trivial index list
+static bool read_indices(const tinygltf::Model& model, const tinygltf::Primitive& primitive, uint32_t vertex_count, std::vector<uint32_t>& indices)
+{
+    const size_t first_index = indices.size();
+
+    if (primitive.indices < 0)
+    {
+        for (uint32_t i = 0; i < vertex_count; ++i)
+            indices.push_back(i);
+        return true;
+    }
+
+    const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
+    if (accessor.bufferView < 0)
+        return false;
+
+    for (size_t i = 0; i < accessor.count; ++i)
+    {
+        const uint8_t* element = accessor_element(model, accessor, i);
+
+        switch (accessor.componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            indices.push_back(*element);
+            break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        {
+            uint16_t index;
+            memcpy(&index, element, sizeof(index));
+            indices.push_back(index);
+            break;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        {
+            uint32_t index;
+            memcpy(&index, element, sizeof(index));
+            indices.push_back(index);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    // An index past the primitive's vertices would end up in another submesh or outside the vertex buffer
+    return std::all_of(indices.begin() + first_index, indices.end(), [&](uint32_t index) { return index < vertex_count; });
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <input.gltf|input.glb> <output.mesh>\n", argv[0]);
+        return 1;
+    }
+
+    const std::string input = argv[1];
+    const bool binary = input.size() > 4 && input.compare(input.size() - 4, 4, ".glb") == 0;
+
+    tinygltf::TinyGLTF loader;
+    tinygltf::Model model;
+    std::string error;
+    std::string warning;
+
+    const bool loaded = binary ? loader.LoadBinaryFromFile(&model, &error, &warning, input)
+                               : loader.LoadASCIIFromFile(&model, &error, &warning, input);
+
+    if (!warning.empty())
+        fprintf(stderr, "%s: %s\n", input.c_str(), warning.c_str());
+
+    if (!loaded)
+    {
+        fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+        return 1;
+    }
+
+    std::vector<MeshFileMesh> meshes;
+    std::vector<MeshFileSubmesh> submeshes;
+    std::vector<MeshFileVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    for (const tinygltf::Mesh& gltf_mesh : model.meshes)
+    {
+        MeshFileMesh mesh{};
+        strncpy(mesh.name, gltf_mesh.name.c_str(), MESH_FILE_MAX_NAME - 1u);
+        mesh.first_submesh = static_cast<uint32_t>(submeshes.size());
+
+        for (const tinygltf::Primitive& primitive : gltf_mesh.primitives)
+        {
+            if (primitive.mode != TINYGLTF_MODE_TRIANGLES)
+            {
+                fprintf(stderr, "%s: skipping non-triangle primitive of mesh '%s'\n", input.c_str(), gltf_mesh.name.c_str());
+                continue;
+            }
+
+            const uint32_t vertex_offset = static_cast<uint32_t>(vertices.size());
+            const uint32_t first_index = static_cast<uint32_t>(indices.size());
+
+            if (!read_positions(model, primitive, vertices) ||
+                !read_indices(model, primitive, static_cast<uint32_t>(vertices.size()) - vertex_offset, indices))
+            {
+                fprintf(stderr, "%s: unsupported or invalid primitive in mesh '%s'\n", input.c_str(), gltf_mesh.name.c_str());
+                return 1;
+            }
+
+            submeshes.push_back(MeshFileSubmesh{
+                .vertex_offset = static_cast<int32_t>(vertex_offset),
+                .vertex_count = static_cast<uint32_t>(vertices.size()) - vertex_offset,
+                .first_index = first_index,
+                .index_count = static_cast<uint32_t>(indices.size()) - first_index});
+        }
+
+        mesh.submesh_count = static_cast<uint32_t>(submeshes.size()) - mesh.first_submesh;
+        if (mesh.submesh_count > 0u)
+            meshes.push_back(mesh);
+    }
+
+    if (submeshes.empty())
+    {
+        fprintf(stderr, "%s: no triangle meshes\n", input.c_str());
+        return 1;
+    }
+
+    // Fit the whole scene into [-0.5, 0.5]^3
+    const MeshFileBounds scene_bounds = mesh_file_compute_bounds(vertices.data(), static_cast<uint32_t>(vertices.size()));
+    const float extent = std::max({scene_bounds.max[0] - scene_bounds.min[0], scene_bounds.max[1] - scene_bounds.min[1], scene_bounds.max[2] - scene_bounds.min[2]});
+    const float scale = (extent > 0.0f) ? 1.0f / extent : 1.0f;
+
+    // Positions are snapped to the snorm16 grid right away, the optimizers and the bounds see what the GPU sees
+    for (MeshFileVertex& vertex : vertices)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+            vertex.position[c] = mesh_file_dequantize(mesh_file_quantize((vertex.position[c] - (scene_bounds.min[c] + scene_bounds.max[c]) * 0.5f) * scale));
+    }
+
+    // Optimize each submesh on its own, vertex fetch optimization drops unreferenced vertices so the vertex
+    // section is rebuilt
+    std::vector<MeshFileVertex> optimized_vertices;
+    std::vector<uint16_t> indices_16;
+    std::vector<uint32_t> indices_32;
+    std::vector<MeshFileBounds> bounds;
+    bounds.reserve(submeshes.size());
+
+    double misses_before = 0.0;
+    double misses_after = 0.0;
+
+    for (MeshFileSubmesh& submesh : submeshes)
+    {
+        MeshFileVertex* submesh_vertices = &vertices[submesh.vertex_offset];
+        uint32_t* submesh_indices = &indices[submesh.first_index];
+
+        misses_before += mesh_compute_acmr(submesh_indices, submesh.index_count, submesh.vertex_count) * (submesh.index_count / 3u);
+
+        mesh_optimize_vertex_cache(submesh_indices, submesh.index_count, submesh.vertex_count);
+        mesh_optimize_overdraw(submesh_indices, submesh.index_count, submesh_vertices, submesh.vertex_count);
+        submesh.vertex_count = mesh_optimize_vertex_fetch(submesh_vertices, submesh.vertex_count, submesh_indices, submesh.index_count);
+
+        misses_after += mesh_compute_acmr(submesh_indices, submesh.index_count, submesh.vertex_count) * (submesh.index_count / 3u);
+
+        bounds.push_back(mesh_file_compute_bounds(submesh_vertices, submesh.vertex_count));
+
+        submesh.vertex_offset = static_cast<int32_t>(optimized_vertices.size());
+        optimized_vertices.insert(optimized_vertices.end(), submesh_vertices, submesh_vertices + submesh.vertex_count);
+
+        if (submesh.vertex_count <= UINT16_MAX + 1u)
+        {
+            submesh.index_type = MESH_FILE_INDEX_TYPE_UINT16;
+            submesh.first_index = static_cast<uint32_t>(indices_16.size());
+            indices_16.insert(indices_16.end(), submesh_indices, submesh_indices + submesh.index_count);
+        }
+        else
+        {
+            submesh.index_type = MESH_FILE_INDEX_TYPE_UINT32;
+            submesh.first_index = static_cast<uint32_t>(indices_32.size());
+            indices_32.insert(indices_32.end(), submesh_indices, submesh_indices + submesh.index_count);
+        }
+    }
+
+    vertices = std::move(optimized_vertices);
+
+    // Each position component is one stream, sign extended so small differences stay small across 0
+    std::vector<uint8_t> vertex_section;
+    {
+        std::vector<uint32_t> components(vertices.size());
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            for (size_t i = 0; i < vertices.size(); ++i)
+                components[i] = static_cast<uint32_t>(static_cast<int32_t>(mesh_file_quantize(vertices[i].position[c])));
+
+            const std::vector<uint8_t> stream = encode_stream(components.data(), components.size());
+            vertex_section.insert(vertex_section.end(), stream.begin(), stream.end());
+        }
+    }
+
+    const std::vector<uint32_t> widened_indices_16(indices_16.begin(), indices_16.end());
+    const std::vector<uint8_t> index_sections[MESH_FILE_INDEX_TYPE_COUNT]{
+        encode_stream(widened_indices_16.data(), widened_indices_16.size()),
+        encode_stream(indices_32.data(), indices_32.size())};
+
+    const uint64_t tables_end = sizeof(MeshFileHeader) + meshes.size() * sizeof(MeshFileMesh) +
+                                submeshes.size() * (sizeof(MeshFileSubmesh) + sizeof(MeshFileBounds));
+
+    MeshFileHeader header{
+        .magic = MESH_FILE_MAGIC,
+        .version = MESH_FILE_VERSION,
+        .mesh_count = static_cast<uint32_t>(meshes.size()),
+        .submesh_count = static_cast<uint32_t>(submeshes.size()),
+        .vertex_count = static_cast<uint32_t>(vertices.size()),
+        .index_counts = {static_cast<uint32_t>(indices_16.size()), static_cast<uint32_t>(indices_32.size())},
+        .vertex_offset = mesh_file_align(tables_end),
+        .vertex_size = vertex_section.size(),
+        .index_offsets = {},
+        .index_sizes = {index_sections[MESH_FILE_INDEX_TYPE_UINT16].size(), index_sections[MESH_FILE_INDEX_TYPE_UINT32].size()}};
+
+    header.index_offsets[MESH_FILE_INDEX_TYPE_UINT16] = mesh_file_align(header.vertex_offset + header.vertex_size);
+    header.index_offsets[MESH_FILE_INDEX_TYPE_UINT32] = mesh_file_align(header.index_offsets[MESH_FILE_INDEX_TYPE_UINT16] + header.index_sizes[MESH_FILE_INDEX_TYPE_UINT16]);
+
+    FILE* f = fopen(argv[2], "wb");
+    if (f == nullptr)
+    {
+        fprintf(stderr, "Failed to open %s\n", argv[2]);
+        return 1;
+    }
+
+    const auto pad_to = [f](uint64_t offset) {
+        static const uint8_t zeros[MESH_FILE_SECTION_ALIGNMENT] = {};
+        fwrite(zeros, 1, offset - static_cast<uint64_t>(ftell(f)), f);
+    };
+
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(meshes.data(), sizeof(MeshFileMesh), meshes.size(), f);
+    fwrite(submeshes.data(), sizeof(MeshFileSubmesh), submeshes.size(), f);
+    fwrite(bounds.data(), sizeof(MeshFileBounds), bounds.size(), f);
+
+    pad_to(header.vertex_offset);
+    fwrite(vertex_section.data(), 1, vertex_section.size(), f);
+
+    for (uint32_t i = 0; i < MESH_FILE_INDEX_TYPE_COUNT; ++i)
+    {
+        pad_to(header.index_offsets[i]);
+        fwrite(index_sections[i].data(), 1, index_sections[i].size(), f);
+    }
+
+    const bool written = ferror(f) == 0;
+    fclose(f);
+
+    if (!written)
+    {
+        fprintf(stderr, "Failed to write %s\n", argv[2]);
+        return 1;
+    }
+
+    const size_t triangle_count = indices.size() / 3u;
+    printf("%s: %zu meshes, %zu submeshes, %zu vertices, %zu indices (%zu 16 bit)\n", argv[2], meshes.size(), submeshes.size(), vertices.size(),
+           indices.size(), indices_16.size());
+    printf("ACMR: %.3f -> %.3f (FIFO cache of %u)\n", triangle_count ? misses_before / triangle_count : 0.0,
+           triangle_count ? misses_after / triangle_count : 0.0, MESH_OPTIMIZER_FIFO_CACHE_SIZE);
+    printf("Index memory: %zu -> %zu bytes (%zu saved)\n", indices.size() * sizeof(uint32_t),
+           indices_16.size() * sizeof(uint16_t) + indices_32.size() * sizeof(uint32_t), indices_16.size() * sizeof(uint16_t));
+    printf("Compressed: vertices %zu -> %zu bytes, indices %zu -> %zu bytes\n", vertices.size() * sizeof(MeshFileVertex), vertex_section.size(),
+           indices_16.size() * sizeof(uint16_t) + indices_32.size() * sizeof(uint32_t), index_sections[0].size() + index_sections[1].size());
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "mesh_optimizer.hpp"
+
+namespace
+{
+    // Forsyth's scoring parameters, the cache is modeled as LRU of this size
+    constexpr uint32_t FORSYTH_CACHE_SIZE = 32u;
+    constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+    float forsyth_vertex_score(int32_t cache_position, uint32_t remaining_triangles)
+    {
+        if (remaining_triangles == 0u)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cache_position >= 0)
+        {
+            // The last triangle's vertices get a fixed score so its neighbours are not favored too strongly
+            if (cache_position < 3)
+                score = FORSYTH_LAST_TRIANGLE_SCORE;
+            else
+                score = powf(1.0f - static_cast<float>(cache_position - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+        }
+
+        // Vertices with few triangles left are finished first, so they leave the working set
+        return score + FORSYTH_VALENCE_BOOST_SCALE * powf(static_cast<float>(remaining_triangles), -FORSYTH_VALENCE_BOOST_POWER);
+    }
+
+    // Triangles of each vertex as a compact adjacency list
+    struct Adjacency
+    {
+        std::vector<uint32_t> offsets;      // vertex_count + 1
+        std::vector<uint32_t> triangles;
+    };
+
+    Adjacency build_adjacency(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+    {
+        Adjacency adjacency{
+            .offsets = std::vector<uint32_t>(vertex_count + 1u, 0u),
+            .triangles = std::vector<uint32_t>(index_count)};
+
+        for (uint32_t i = 0; i < index_count; ++i)
+            ++adjacency.offsets[indices[i] + 1u];
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+            adjacency.offsets[v + 1u] += adjacency.offsets[v];
+
+        std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (uint32_t i = 0; i < index_count; ++i)
+            adjacency.triangles[fill[indices[i]]++] = i / 3u;
+
+        return adjacency;
+    }
+}
+
+float mesh_compute_acmr(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+{
+    if (index_count < 3u)
+        return 0.0f;
+
+    // Timestamps instead of an explicit FIFO: a vertex is in the cache if it was inserted less than
+    // MESH_OPTIMIZER_FIFO_CACHE_SIZE misses ago
+    std::vector<uint32_t> inserted_at(vertex_count, 0u);
+    uint32_t misses = 0u;
+
+    for (uint32_t i = 0; i < index_count; ++i)
+    {
+        const uint32_t v = indices[i];
+        if (inserted_at[v] == 0u || misses + 1u - inserted_at[v] > MESH_OPTIMIZER_FIFO_CACHE_SIZE)
+            inserted_at[v] = ++misses;
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(index_count / 3u);
+}
+
+void mesh_optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+{
+    const uint32_t triangle_count = index_count / 3u;
+    if (triangle_count == 0u)
+        return;
+
+    const Adjacency adjacency = build_adjacency(indices, index_count, vertex_count);
+
+    std::vector<uint32_t> remaining(vertex_count);
+    std::vector<float> vertex_score(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        remaining[v] = adjacency.offsets[v + 1u] - adjacency.offsets[v];
+        vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+    }
+
+    std::vector<float> triangle_score(triangle_count);
+    for (uint32_t t = 0; t < triangle_count; ++t)
+        triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+
+    // LRU cache, 3 extra entries hold the vertices pushed out by the last triangle while it is updated
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> next_cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3u);
+    next_cache.reserve(FORSYTH_CACHE_SIZE + 3u);
+
+    uint32_t best_triangle = static_cast<uint32_t>(std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin());
+    uint32_t scan_position = 0u;
+
+    for (uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+    {
+        // Nothing in the cache has triangles left, continue with the next unemitted triangle in input order
+        if (best_triangle == UINT32_MAX)
+        {
+            while (emitted[scan_position])
+                ++scan_position;
+            best_triangle = scan_position;
+        }
+
+        const uint32_t* triangle = &indices[best_triangle * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best_triangle] = true;
+
+        next_cache.clear();
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            const uint32_t v = triangle[i];
+            --remaining[v];
+
+            // Degenerate triangles reference a vertex more than once
+            if (std::find(next_cache.begin(), next_cache.end(), v) == next_cache.end())
+                next_cache.push_back(v);
+        }
+
+        for (uint32_t v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                next_cache.push_back(v);
+        }
+
+        // Vertices beyond the cache size have been evicted, their scores drop back to the valence term
+        for (uint32_t i = FORSYTH_CACHE_SIZE; i < next_cache.size(); ++i)
+            vertex_score[next_cache[i]] = forsyth_vertex_score(-1, remaining[next_cache[i]]);
+
+        next_cache.resize(std::min<size_t>(next_cache.size(), FORSYTH_CACHE_SIZE));
+        std::swap(cache, next_cache);
+
+        for (uint32_t i = 0; i < cache.size(); ++i)
+            vertex_score[cache[i]] = forsyth_vertex_score(static_cast<int32_t>(i), remaining[cache[i]]);
+
+        // Only triangles touching the cache changed their score, the best of them is emitted next
+        best_triangle = UINT32_MAX;
+        float best_score = -1.0f;
+
+        for (uint32_t v : cache)
+        {
+            for (uint32_t a = adjacency.offsets[v]; a < adjacency.offsets[v + 1u]; ++a)
+            {
+                const uint32_t t = adjacency.triangles[a];
+                if (emitted[t])
+                    continue;
+
+                triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+                if (triangle_score[t] > best_score)
+                {
+                    best_score = triangle_score[t];
+                    best_triangle = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+}
+
+void mesh_optimize_overdraw(uint32_t* indices, uint32_t index_count, const MeshFileVertex* vertices, uint32_t vertex_count)
+{
+    const uint32_t triangle_count = index_count / 3u;
+    if (triangle_count == 0u)
+        return;
+
+    // Cluster boundaries are the triangles whose three vertices all miss the cache, starting there again
+    // costs nothing extra
+    std::vector<uint32_t> cluster_begin;
+    {
+        std::vector<uint32_t> inserted_at(vertex_count, 0u);
+        uint32_t misses = 0u;
+
+        for (uint32_t t = 0; t < triangle_count; ++t)
+        {
+            uint32_t triangle_misses = 0u;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                const uint32_t v = indices[t * 3 + i];
+                if (inserted_at[v] == 0u || misses + 1u - inserted_at[v] > MESH_OPTIMIZER_FIFO_CACHE_SIZE)
+                {
+                    inserted_at[v] = ++misses;
+                    ++triangle_misses;
+                }
+            }
+
+            if (t == 0u || triangle_misses == 3u)
+                cluster_begin.push_back(t);
+        }
+    }
+
+    const uint32_t cluster_count = static_cast<uint32_t>(cluster_begin.size());
+    cluster_begin.push_back(triangle_count);
+
+    // Area weighted centroid and normal per cluster, and the centroid of the whole mesh
+    std::vector<float> cluster_centroid(cluster_count * 3u, 0.0f);
+    std::vector<float> cluster_normal(cluster_count * 3u, 0.0f);
+    std::vector<float> cluster_area(cluster_count, 0.0f);
+    float mesh_centroid[3] = {0.0f, 0.0f, 0.0f};
+    float mesh_area = 0.0f;
+
+    for (uint32_t c = 0; c < cluster_count; ++c)
+    {
+        for (uint32_t t = cluster_begin[c]; t < cluster_begin[c + 1u]; ++t)
+        {
+            const float* p0 = vertices[indices[t * 3]].position;
+            const float* p1 = vertices[indices[t * 3 + 1]].position;
+            const float* p2 = vertices[indices[t * 3 + 2]].position;
+
+            const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            const float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            const float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * 0.5f;
+
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                const float center = (p0[i] + p1[i] + p2[i]) / 3.0f;
+                cluster_centroid[c * 3 + i] += center * area;
+                cluster_normal[c * 3 + i] += n[i];
+                mesh_centroid[i] += center * area;
+            }
+
+            cluster_area[c] += area;
+            mesh_area += area;
+        }
+    }
+
+    for (uint32_t i = 0; i < 3; ++i)
+        mesh_centroid[i] /= std::max(mesh_area, FLT_MIN);
+
+    // Clusters facing away from the center are more likely to occlude the rest of the mesh
+    std::vector<float> sort_key(cluster_count);
+    for (uint32_t c = 0; c < cluster_count; ++c)
+    {
+        float* centroid = &cluster_centroid[c * 3];
+        const float* normal = &cluster_normal[c * 3];
+        const float normal_length = std::max(sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]), FLT_MIN);
+
+        float key = 0.0f;
+        for (uint32_t i = 0; i < 3; ++i)
+            key += (centroid[i] / std::max(cluster_area[c], FLT_MIN) - mesh_centroid[i]) * normal[i] / normal_length;
+
+        sort_key[c] = key;
+    }
+
+    std::vector<uint32_t> cluster_order(cluster_count);
+    for (uint32_t c = 0; c < cluster_count; ++c)
+        cluster_order[c] = c;
+
+    std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](uint32_t a, uint32_t b) { return sort_key[a] > sort_key[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+    for (uint32_t c : cluster_order)
+        output.insert(output.end(), indices + cluster_begin[c] * 3, indices + cluster_begin[c + 1u] * 3);
+
+    memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+}
+
+uint32_t mesh_optimize_vertex_fetch(MeshFileVertex* vertices, uint32_t vertex_count, uint32_t* indices, uint32_t index_count)
+{
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    std::vector<MeshFileVertex> output;
+    output.reserve(vertex_count);
+
+    for (uint32_t i = 0; i < index_count; ++i)
+    {
+        uint32_t& new_index = remap[indices[i]];
+        if (new_index == UINT32_MAX)
+        {
+            new_index = static_cast<uint32_t>(output.size());
+            output.push_back(vertices[indices[i]]);
+        }
+
+        indices[i] = new_index;
+    }
+
+    memcpy(vertices, output.data(), output.size() * sizeof(MeshFileVertex));
+    return static_cast<uint32_t>(output.size());
+}
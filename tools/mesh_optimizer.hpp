@@ -0,0 +1,31 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "../MeshFile.hpp"
+
+// Triangle list reordering for the offline mesh importer. All functions work on one submesh, indices are
+// relative to its first vertex.
+
+// Size of the FIFO post-transform cache simulated by mesh_compute_acmr
+constexpr uint32_t MESH_OPTIMIZER_FIFO_CACHE_SIZE = 16u;
+
+// Average cache miss ratio: transformed vertices per triangle, 0.5 is the best case for a regular grid and 3
+// the worst
+float mesh_compute_acmr(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count);
+
+// Reorders triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void mesh_optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count);
+
+// Reorders the clusters of a cache optimized triangle list so outward facing ones come first, which reduces
+// overdraw from any view direction (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw"). Clusters are split where the simulated cache starts over, so the cache hit rate is kept.
+void mesh_optimize_overdraw(uint32_t* indices, uint32_t index_count, const MeshFileVertex* vertices, uint32_t vertex_count);
+
+// Reorders vertices into the order the indices first reference them and remaps the indices. Unreferenced
+// vertices are dropped, returns the new vertex count.
+uint32_t mesh_optimize_vertex_fetch(MeshFileVertex* vertices, uint32_t vertex_count, uint32_t* indices, uint32_t index_count);
+
+#endif // MESH_OPTIMIZER_HPP
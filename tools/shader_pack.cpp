@@ -0,0 +1,194 @@
+// Packs compiled SPIR-V modules into the shader archive loaded by ShaderArchive.cpp
+//
+// usage: shader_pack <output> <module.spv>...
+//
+// The entry name is the module's file name without directories and without the ".spv" suffix, so
+// shaders/default.vert compiled to default.vert.spv is looked up as "default.vert".
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../ShaderArchive.hpp"
+
+static bool read_file(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr)
+        return false;
+
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    if (size < 0)
+    {
+        fclose(f);
+        return false;
+    }
+
+    data.resize(static_cast<size_t>(size));
+    rewind(f);
+
+    const bool read = fread(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    return read;
+}
+
+// Takes stage and name from the first OpEntryPoint of the module
+static bool parse_entry_point(const std::vector<uint8_t>& spirv, ShaderArchiveEntry& entry)
+{
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(spirv.data());
+    const size_t word_count = spirv.size() / 4u;
+
+    if (word_count < 5u || words[0] != 0x07230203u)
+        return false;
+
+    for (size_t i = 5; i < word_count;)
+    {
+        const uint32_t opcode = words[i] & 0xffffu;
+        const uint32_t length = words[i] >> 16u;
+
+        if (length == 0u || i + length > word_count)
+            return false;
+
+        if (opcode == 15u && length >= 4u) // OpEntryPoint ExecutionModel EntryPoint Name
+        {
+            static const uint32_t stages[] = {
+                VK_SHADER_STAGE_VERTEX_BIT,
+                VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+                VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+                VK_SHADER_STAGE_GEOMETRY_BIT,
+                VK_SHADER_STAGE_FRAGMENT_BIT,
+                VK_SHADER_STAGE_COMPUTE_BIT};
+
+            const uint32_t execution_model = words[i + 1];
+            if (execution_model >= sizeof(stages) / sizeof(stages[0]))
+                return false;
+
+            entry.stage = stages[execution_model];
+
+            const char* name = reinterpret_cast<const char*>(&words[i + 3]);
+            const size_t name_length = strnlen(name, (length - 3u) * 4u);
+            if (name_length >= SHADER_ARCHIVE_MAX_ENTRY_POINT)
+                return false;
+
+            memcpy(entry.entry_point, name, name_length);
+            return true;
+        }
+
+        i += length;
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <output> <module.spv>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<ShaderArchiveEntry> entries;
+    std::vector<ShaderArchiveBlob> blobs;
+    std::vector<std::vector<uint8_t>> blob_data;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::vector<uint8_t> spirv;
+        if (!read_file(argv[i], spirv) || spirv.empty() || spirv.size() % 4u != 0u)
+        {
+            fprintf(stderr, "shader_pack: failed to read SPIR-V module %s\n", argv[i]);
+            return 1;
+        }
+
+        std::string name = argv[i];
+        name = name.substr(name.find_last_of('/') + 1);
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".spv") == 0)
+            name.resize(name.size() - 4);
+
+        ShaderArchiveEntry entry{};
+
+        if (name.size() >= SHADER_ARCHIVE_MAX_NAME)
+        {
+            fprintf(stderr, "shader_pack: name %s is too long\n", name.c_str());
+            return 1;
+        }
+        memcpy(entry.name, name.data(), name.size());
+
+        if (!parse_entry_point(spirv, entry))
+        {
+            fprintf(stderr, "shader_pack: no usable OpEntryPoint in %s\n", argv[i]);
+            return 1;
+        }
+
+        const uint64_t hash = shader_archive_hash(spirv.data(), spirv.size());
+
+        // Identical modules (e.g. permutations that compile to the same code) share a blob
+        uint32_t blob_idx = 0u;
+        while (blob_idx < blobs.size() && !(blobs[blob_idx].hash == hash && blob_data[blob_idx] == spirv))
+            ++blob_idx;
+
+        if (blob_idx == blobs.size())
+        {
+            blobs.push_back(ShaderArchiveBlob{.hash = hash, .offset = 0u, .size = static_cast<uint32_t>(spirv.size())});
+            blob_data.push_back(std::move(spirv));
+        }
+
+        entry.blob_idx = blob_idx;
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const ShaderArchiveEntry& a, const ShaderArchiveEntry& b) {
+        return strncmp(a.name, b.name, SHADER_ARCHIVE_MAX_NAME) < 0;
+    });
+
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        if (strncmp(entries[i - 1].name, entries[i].name, SHADER_ARCHIVE_MAX_NAME) == 0)
+        {
+            fprintf(stderr, "shader_pack: duplicate shader name %s\n", entries[i].name);
+            return 1;
+        }
+    }
+
+    const ShaderArchiveHeader header{
+        .magic = SHADER_ARCHIVE_MAGIC,
+        .version = SHADER_ARCHIVE_VERSION,
+        .entry_count = static_cast<uint32_t>(entries.size()),
+        .blob_count = static_cast<uint32_t>(blobs.size())};
+
+    auto align = [](size_t offset) { return (offset + SHADER_ARCHIVE_BLOB_ALIGNMENT - 1) / SHADER_ARCHIVE_BLOB_ALIGNMENT * SHADER_ARCHIVE_BLOB_ALIGNMENT; };
+
+    size_t offset = align(sizeof(header) + entries.size() * sizeof(ShaderArchiveEntry) + blobs.size() * sizeof(ShaderArchiveBlob));
+    for (ShaderArchiveBlob& blob : blobs)
+    {
+        blob.offset = static_cast<uint32_t>(offset);
+        offset = align(offset + blob.size);
+    }
+
+    std::vector<uint8_t> archive(offset, 0u);
+    uint8_t* dst = archive.data();
+
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    memcpy(dst, entries.data(), entries.size() * sizeof(ShaderArchiveEntry));
+    dst += entries.size() * sizeof(ShaderArchiveEntry);
+    memcpy(dst, blobs.data(), blobs.size() * sizeof(ShaderArchiveBlob));
+
+    for (size_t i = 0; i < blobs.size(); ++i)
+        memcpy(archive.data() + blobs[i].offset, blob_data[i].data(), blob_data[i].size());
+
+    FILE* f = fopen(argv[1], "wb");
+    if (f == nullptr || fwrite(archive.data(), 1, archive.size(), f) != archive.size())
+    {
+        fprintf(stderr, "shader_pack: failed to write %s\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    printf("shader_pack: %zu shaders, %zu unique modules, %zu bytes\n", entries.size(), blobs.size(), archive.size());
+    return 0;
+}